@@ -0,0 +1,135 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#ifndef SVC_ARENA_H
+#define SVC_ARENA_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_BLOCK_MIN 4096
+#define ARENA_BLOCK_MAX (1024 * 1024)
+
+/**
+ * Allocations are aligned like this union, suitably for any type.
+ */
+typedef union {
+    long double d;
+    long long l;
+    void *p;
+} arena_align;
+
+/**
+ * A block of an arena, blocks are chained from the newest one.
+ */
+typedef struct arena_block {
+    struct arena_block *next;
+    size_t cap;
+    size_t used;
+    arena_align data[];
+} arena_block;
+
+/**
+ * A bump allocator: allocations are carved out of a few large blocks and are
+ * all released at once by arena_free(), zero initialize it before use. It
+ * isn't thread safe.
+ */
+typedef struct {
+    arena_block *head;
+} arena;
+
+/**
+ * Allocate l zeroed bytes from a, aligned for any type. The memory lives until
+ * arena_free(a).
+ *
+ * Returns NULL on error and set errno.
+ */
+static inline void *
+arena_alloc(arena *a, size_t l)
+{
+    size_t align = sizeof(arena_align);
+    l            = (l + align - 1) / align * align;
+
+    arena_block *b = a->head;
+    if (b == NULL || b->cap - b->used < l) {
+        // blocks double in size so big listings only take a few of them
+        size_t cap = b == NULL ? ARENA_BLOCK_MIN : b->cap * 2;
+        if (cap > ARENA_BLOCK_MAX) {
+            cap = ARENA_BLOCK_MAX;
+        }
+        if (cap < l) {
+            cap = l;
+        }
+
+        // calloc hands out zeroed memory, nothing is ever reused
+        b = calloc(1, sizeof(*b) + cap);
+        if (b == NULL) {
+            return NULL;
+        }
+        b->next = a->head;
+        b->cap  = cap;
+        a->head = b;
+    }
+
+    void *p = (char *)b->data + b->used;
+    b->used += l;
+    return p;
+}
+
+/**
+ * Copy the string s into a.
+ *
+ * Returns NULL on error and set errno.
+ */
+static inline char *
+arena_strdup(arena *a, char const *s)
+{
+    size_t l = strlen(s) + 1;
+    char *p  = arena_alloc(a, l);
+    if (p != NULL) {
+        memcpy(p, s, l);
+    }
+
+    return p;
+}
+
+/**
+ * Hand every allocation of src over to dst, they then live until
+ * arena_free(dst). src is reset.
+ */
+static inline void
+arena_move(arena *dst, arena *src)
+{
+    if (src->head == NULL) {
+        return;
+    } else if (dst->head == NULL) {
+        dst->head = src->head;
+        src->head = NULL;
+        return;
+    }
+
+    // behind the head of dst, which keeps serving the next allocations
+    arena_block *tail = src->head;
+    while (tail->next != NULL) {
+        tail = tail->next;
+    }
+    tail->next      = dst->head->next;
+    dst->head->next = src->head;
+    src->head       = NULL;
+}
+
+/**
+ * Release every allocation of a at once and reset it.
+ */
+static inline void
+arena_free(arena *a)
+{
+    while (a->head != NULL) {
+        arena_block *next = a->head->next;
+        free(a->head);
+        a->head = next;
+    }
+}
+
+#endif
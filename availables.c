@@ -6,19 +6,18 @@
 #include "err.h"
 #include "io.h"
 
-arr_of(char *) availables_get(cfg *config)
+arr_of(char *) availables_get(cfg *config, arena *a)
 {
-    return io_list_dirs(config->available);
+    return io_list_dirs(config->available, a);
 }
 
 int
 availables_exist(cfg *config, char const *name)
 {
-    char path[512] = {0};
-    if (io_snprintf(path, 512, "%s/%s", config->available, name) == -1) {
-        wrap_last_error("io_snprintf failed");
+    int fd = cfg_available_fd(config);
+    if (fd == -1) {
         return -1;
     }
 
-    return io_exists(path);
+    return io_existsat(fd, name);
 }
@@ -5,16 +5,18 @@
 #ifndef SVC_AVAILABLES_H
 #define SVC_AVAILABLES_H
 
+#include "arena.h"
 #include "arr.h"
 #include "config.h"
 
 /**
- * Return the list of available services, the list and its elements must be
- * freed upon usage with `arr_free_free(list, free)`.
+ * Return the list of available services, the names are allocated in a. The
+ * list must be freed upon usage with `arr_free(list)` and the names with
+ * `arena_free(a)`.
  *
  * Returns NULL on error and set last_error.
  */
-arr_of(char *) availables_get(cfg *config);
+arr_of(char *) availables_get(cfg *config, arena *a);
 
 /**
  * Returns 1 if the given exists in the available services, otherwise 0.
@@ -0,0 +1,58 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+
+/**
+ * Allocation counter linked into the counting build of svc with
+ * -Wl,--wrap for every function below. Only the calls made by svc itself are
+ * seen, not the ones libc makes internally. The count is written at exit to
+ * the fd named by $SVC_BENCH_ALLOCS_FD, see bench-run.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static long allocs;
+
+void *__real_malloc(size_t l);
+void *__real_calloc(size_t n, size_t l);
+void *__real_realloc(void *p, size_t l);
+char *__real_strdup(char const *s);
+
+void *
+__wrap_malloc(size_t l)
+{
+    __atomic_add_fetch(&allocs, 1, __ATOMIC_RELAXED);
+    return __real_malloc(l);
+}
+
+void *
+__wrap_calloc(size_t n, size_t l)
+{
+    __atomic_add_fetch(&allocs, 1, __ATOMIC_RELAXED);
+    return __real_calloc(n, l);
+}
+
+void *
+__wrap_realloc(void *p, size_t l)
+{
+    __atomic_add_fetch(&allocs, 1, __ATOMIC_RELAXED);
+    return __real_realloc(p, l);
+}
+
+char *
+__wrap_strdup(char const *s)
+{
+    __atomic_add_fetch(&allocs, 1, __ATOMIC_RELAXED);
+    return __real_strdup(s);
+}
+
+__attribute__((destructor)) static void
+report(void)
+{
+    char const *fd = getenv("SVC_BENCH_ALLOCS_FD");
+    if (fd != NULL) {
+        dprintf(atoi(fd), "%ld\n", __atomic_load_n(&allocs, __ATOMIC_RELAXED));
+    }
+}
@@ -0,0 +1,110 @@
+#!/bin/sh
+# SPDX-License-Identifier: AGPL-3.0-only
+# Copyright (C) 2025 Wladimir Bec
+#
+# Benchmark svc on generated trees, run through `make bench`. One tab
+# separated row is printed per case and size, after a header row:
+#
+#   case services wall_ms wall_us_per_svc syscalls syscalls_per_svc allocs
+#   allocs_per_svc
+#
+# wall_ms is the median of BENCH_REPS runs. Trees are generated once under
+# BENCH_DIR and reused by later runs. Control commands run against
+# bench-runsv, control-wait measures the round trip of a restart through it.
+# The tai64n cases convert a generated log of BENCH_LINES lines instead, their
+# services column counts lines, tai64n-naive is the per line parser of
+# bench-tai.
+#
+# Environment:
+#   BLDD         build dir holding svc, svc-allocs and the bench- tools
+#   BENCH_SIZES  service counts, "10 1000 10000 100000" by default
+#   BENCH_REPS   timed runs per case, 5 by default
+#   BENCH_DIR    where the trees live, ${TMPDIR:-/tmp}/svc-bench by default
+#   BENCH_LINES  lines of the tai64n log, 1000000 by default
+
+set -eu
+
+BLDD=${BLDD:-./bld}
+BENCH_SIZES=${BENCH_SIZES:-10 1000 10000 100000}
+BENCH_REPS=${BENCH_REPS:-5}
+BENCH_DIR=${BENCH_DIR:-${TMPDIR:-/tmp}/svc-bench}
+BENCH_LINES=${BENCH_LINES:-1000000}
+
+svc=$BLDD/svc
+
+mkdir -p "$BENCH_DIR"
+
+# a stale daemon must not answer in place of the scan being measured
+SVCSOCK=$BENCH_DIR/none.sock
+export SVCSOCK
+
+# case services cmd...
+measure() {
+    name=$1
+    n=$2
+    shift 2
+    set -- $("$BLDD/bench-run" -r "$BENCH_REPS" -a "$BLDD/svc-allocs" \
+        -- "$svc" "$@")
+    awk -v c="$name" -v n="$n" -v ms="$1" -v sc="$2" -v al="$3" 'BEGIN {
+        printf "%s\t%d\t%.3f\t%.3f\t%d\t%.2f\t%d\t%.2f\n",
+            c, n, ms, ms * 1000 / n, sc, sc / n, al, al / n
+    }'
+}
+
+runsv=
+trap '[ -z "$runsv" ] || kill "$runsv"' EXIT
+
+# start bench-runsv on $SVDIR and wait until it reads the control fifos
+start_runsv() {
+    "$BLDD/bench-runsv" "$SVDIR" > "$BENCH_DIR/runsv.out" &
+    runsv=$!
+    until grep -q ready "$BENCH_DIR/runsv.out"; do
+        kill -0 "$runsv"
+        sleep 0.1
+    done
+}
+
+stop_runsv() {
+    kill "$runsv"
+    wait "$runsv" || true
+    runsv=
+}
+
+printf 'case\tservices\twall_ms\twall_us_per_svc\tsyscalls\tsyscalls_per_svc'
+printf '\tallocs\tallocs_per_svc\n'
+
+for n in $BENCH_SIZES; do
+    root=$BENCH_DIR/$n
+    if [ ! -e "$root/.done" ]; then
+        rm -rf "$root"
+        "$BLDD/bench-gen" "$root" "$n"
+        touch "$root/.done"
+    fi
+
+    SVDIR=$root/sv
+    AVDIR=$root/av
+    export SVDIR AVDIR
+
+    measure view "$n" view
+    measure view-json "$n" --format=json view
+    measure list-availables "$n" list-availables
+
+    start_runsv
+    measure control "$n" sig-hup svc-000000
+    measure control-all "$n" sig-hup 'svc-*'
+    measure control-wait "$n" --wait 10 restart svc-000000
+    stop_runsv
+done
+
+log=$BENCH_DIR/tai64n-$BENCH_LINES.log
+if [ ! -e "$log" ]; then
+    "$BLDD/bench-tai" -g "$BENCH_LINES" > "$log.tmp"
+    mv "$log.tmp" "$log"
+fi
+
+measure tai64n "$BENCH_LINES" tai64n "$log"
+set -- $("$BLDD/bench-run" -r "$BENCH_REPS" -- "$BLDD/bench-tai" "$log")
+awk -v n="$BENCH_LINES" -v ms="$1" -v sc="$2" 'BEGIN {
+    printf "tai64n-naive\t%d\t%.3f\t%.3f\t%d\t%.2f\t-1\t-1.00\n",
+        n, ms, ms * 1000 / n, sc, sc / n
+}'
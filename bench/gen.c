@@ -0,0 +1,202 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+
+/**
+ * Generate a fake runit tree of n services under root: root/av holds the
+ * service dirs and root/sv links every one of them, like /etc/sv and
+ * /var/service. Services are named svc-000000 onwards and are laid out the
+ * same way on every run.
+ *
+ * Usage: bench-gen [-l percent] [-d percent] [-t percent] root n
+ *
+ *   -l  services with a log/ companion, 30 by default
+ *   -d  services with a down file, stopped, 20 by default
+ *   -t  services with text supervise files only, 10 by default
+ *
+ * supervise/control is a regular file rather than the fifo of runsv, control
+ * commands then complete without any supervisor.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TAI_OFFSET 4611686018427387914ULL
+
+static void
+die(char const *what, char const *path)
+{
+    fprintf(stderr, "bench-gen: %s %s: %s\n", what, path, strerror(errno));
+    exit(1);
+}
+
+static void
+make_dir(char const *path)
+{
+    if (mkdir(path, 0755) == -1 && errno != EEXIST) {
+        die("mkdir", path);
+    }
+}
+
+static void
+put(char const *dir, char const *name, void const *data, size_t len, int mode)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, mode);
+    if (fd == -1) {
+        die("open", path);
+    }
+    if (write(fd, data, len) != (ssize_t)len) {
+        die("write", path);
+    }
+    close(fd);
+}
+
+/**
+ * Returns 1 for about percent of the services, salt picks independent ones
+ * for every property.
+ */
+static int
+pick(unsigned long i, unsigned salt, int percent)
+{
+    uint32_t h = (uint32_t)(i * 2654435761UL) ^ (salt * 0x9e3779b9U);
+    h ^= h >> 15;
+    h *= 0x2c1b3c6dU;
+    h ^= h >> 12;
+    return (int)(h % 100) < percent;
+}
+
+/**
+ * Write the supervise files of the service dir, as runsv leaves them.
+ */
+static void
+supervise(char const *dir, int down, int text, pid_t pid, time_t since)
+{
+    char sup[PATH_MAX];
+    snprintf(sup, sizeof(sup), "%s/supervise", dir);
+    make_dir(sup);
+
+    put(sup, "control", "", 0, 0600);
+    put(sup, "lock", "", 0, 0600);
+
+    char buf[32];
+    int l = down ? 0 : snprintf(buf, sizeof(buf), "%d\n", (int)pid);
+    put(sup, "pid", buf, l, 0644);
+    put(sup, "stat", down ? "down\n" : "run\n", down ? 5 : 4, 0644);
+
+    if (text) {
+        return;
+    }
+
+    // tai64n label in big endian, then pid in host order, paused, want,
+    // term and state
+    unsigned char status[20] = {0};
+    uint64_t sec             = TAI_OFFSET + (uint64_t)since;
+    for (int i = 0; i < 8; ++i) {
+        status[i] = sec >> (56 - 8 * i);
+    }
+    status[11] = 0x2a;
+    memcpy(status + 12, &(int32_t){down ? 0 : pid}, 4);
+    status[17] = down ? 'd' : 'u';
+    status[19] = down ? 0 : 1;
+    put(sup, "status", status, sizeof(status), 0644);
+}
+
+int
+main(int argc, char **argv)
+{
+    int log  = 30;
+    int down = 20;
+    int text = 10;
+
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "l:d:t:")) != -1) {
+        switch (opt) {
+        case 'l':
+            log = atoi(optarg);
+            break;
+        case 'd':
+            down = atoi(optarg);
+            break;
+        case 't':
+            text = atoi(optarg);
+            break;
+        default:
+            goto usage;
+        }
+    }
+    if (argc - optind != 2) {
+        goto usage;
+    }
+
+    char const *root = argv[optind];
+    unsigned long n  = strtoul(argv[optind + 1], NULL, 10);
+    make_dir(root);
+
+    char abs[PATH_MAX];
+    if (realpath(root, abs) == NULL) {
+        die("realpath", root);
+    }
+
+    char av[PATH_MAX];
+    char sv[PATH_MAX];
+    snprintf(av, sizeof(av), "%s/av", abs);
+    snprintf(sv, sizeof(sv), "%s/sv", abs);
+    make_dir(av);
+    make_dir(sv);
+
+    time_t now              = time(NULL);
+    static char const run[] = "#!/bin/sh\nexec sleep infinity\n";
+    for (unsigned long i = 0; i < n; ++i) {
+        char name[32];
+        char dir[PATH_MAX];
+        char link[PATH_MAX];
+        snprintf(name, sizeof(name), "svc-%06lu", i);
+        snprintf(dir, sizeof(dir), "%s/%s", av, name);
+        snprintf(link, sizeof(link), "%s/%s", sv, name);
+
+        // the first service always runs, benchmarks control it
+        int is_down = i > 0 && pick(i, 1, down);
+        int is_text = pick(i, 2, text);
+        pid_t pid   = 1000 + (pid_t)(i % 4000000);
+        time_t t    = now - 60 - (time_t)(i * 37 % 864000);
+
+        make_dir(dir);
+        put(dir, "run", run, sizeof(run) - 1, 0755);
+        if (is_down) {
+            put(dir, "down", "", 0, 0644);
+        }
+        supervise(dir, is_down, is_text, pid, t);
+
+        if (pick(i, 3, log)) {
+            char ldir[PATH_MAX];
+            snprintf(ldir, sizeof(ldir), "%s/log", dir);
+            make_dir(ldir);
+            put(ldir, "run", run, sizeof(run) - 1, 0755);
+            supervise(ldir, 0, is_text, pid + 1, t);
+        }
+
+        if (symlink(dir, link) == -1 && errno != EEXIST) {
+            die("symlink", link);
+        }
+    }
+
+    return 0;
+
+usage:
+    fprintf(stderr,
+            "usage: bench-gen [-l percent] [-d percent] [-t percent] root "
+            "n\n");
+    return 1;
+}
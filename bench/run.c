@@ -0,0 +1,219 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+
+/**
+ * Measure a command and print "wall_ms syscalls allocs" on one line: the
+ * median wall time of reps runs, the syscalls of one traced run, threads
+ * included, and the allocations reported by the counting build of svc when
+ * one is given. Output of the command is discarded.
+ *
+ * Usage: bench-run [-r reps] [-a counting-svc] -- cmd [args...]
+ *
+ * Operations submitted through io_uring aren't syscalls and aren't counted,
+ * allocations are -1 without -a.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define REPS_MAX 1000
+
+static void
+die(char const *what)
+{
+    fprintf(stderr, "bench-run: %s: %s\n", what, strerror(errno));
+    exit(1);
+}
+
+/**
+ * Start argv with its output on /dev/null, the child runs pre() right
+ * before exec.
+ */
+static pid_t
+spawn(char **argv, void (*pre)(void))
+{
+    pid_t pid = fork();
+    if (pid == -1) {
+        die("fork");
+    } else if (pid == 0) {
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+        if (pre != NULL) {
+            pre();
+        }
+        execvp(argv[0], argv);
+        _exit(127);
+    }
+
+    return pid;
+}
+
+static double
+elapsed_ms(struct timespec const *a, struct timespec const *b)
+{
+    return (b->tv_sec - a->tv_sec) * 1e3 + (b->tv_nsec - a->tv_nsec) / 1e6;
+}
+
+static int
+cmp_double(void const *a, void const *b)
+{
+    double x = *(double const *)a;
+    double y = *(double const *)b;
+    return (x > y) - (x < y);
+}
+
+static double
+wall(char **argv, int reps)
+{
+    static double times[REPS_MAX];
+
+    // the first run warms the caches up and isn't counted
+    for (int i = -1; i < reps; ++i) {
+        struct timespec a;
+        struct timespec b;
+        clock_gettime(CLOCK_MONOTONIC, &a);
+        waitpid(spawn(argv, NULL), NULL, 0);
+        clock_gettime(CLOCK_MONOTONIC, &b);
+        if (i >= 0) {
+            times[i] = elapsed_ms(&a, &b);
+        }
+    }
+
+    qsort(times, reps, sizeof(*times), cmp_double);
+    return times[reps / 2];
+}
+
+static void
+traceme(void)
+{
+    ptrace(PTRACE_TRACEME, 0, NULL, NULL);
+    raise(SIGSTOP);
+}
+
+static long
+syscalls(char **argv)
+{
+    pid_t pid = spawn(argv, traceme);
+    int st    = 0;
+    if (waitpid(pid, &st, 0) == -1) {
+        die("waitpid");
+    }
+    ptrace(PTRACE_SETOPTIONS,
+           pid,
+           NULL,
+           PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACECLONE | PTRACE_O_EXITKILL);
+    ptrace(PTRACE_SYSCALL, pid, NULL, NULL);
+
+    long n = 0;
+    while (1) {
+        pid_t t = waitpid(-1, &st, __WALL);
+        if (t == -1) {
+            if (errno == ECHILD) {
+                break;
+            }
+            die("waitpid");
+        } else if (WIFEXITED(st) || WIFSIGNALED(st)) {
+            continue;
+        }
+
+        int sig = WSTOPSIG(st);
+        if (sig == (SIGTRAP | 0x80)) {
+            struct __ptrace_syscall_info info;
+            if (ptrace(PTRACE_GET_SYSCALL_INFO, t, sizeof(info), &info) > 0 &&
+                info.op == PTRACE_SYSCALL_INFO_ENTRY) {
+                ++n;
+            }
+            sig = 0;
+        } else if (sig == SIGTRAP || sig == SIGSTOP) {
+            // clone events and new threads starting up
+            sig = 0;
+        }
+        ptrace(PTRACE_SYSCALL, t, NULL, (void *)(long)sig);
+    }
+
+    return n;
+}
+
+static int allocs_fd = -1;
+
+static void
+share_allocs_fd(void)
+{
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%d", allocs_fd);
+    setenv("SVC_BENCH_ALLOCS_FD", buf, 1);
+}
+
+static long
+allocs(char *bin, char **argv)
+{
+    int p[2];
+    if (pipe(p) == -1) {
+        die("pipe");
+    }
+
+    allocs_fd   = p[1];
+    char *first = argv[0];
+    argv[0]     = bin;
+    pid_t pid   = spawn(argv, share_allocs_fd);
+    argv[0]     = first;
+    close(p[1]);
+
+    char buf[32] = {0};
+    ssize_t l    = 0;
+    ssize_t r    = 0;
+    while (l < (ssize_t)sizeof(buf) - 1 &&
+           (r = read(p[0], buf + l, sizeof(buf) - 1 - l)) > 0) {
+        l += r;
+    }
+    close(p[0]);
+    waitpid(pid, NULL, 0);
+
+    return l > 0 ? strtol(buf, NULL, 10) : -1;
+}
+
+int
+main(int argc, char **argv)
+{
+    int reps  = 5;
+    char *bin = NULL;
+
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "+r:a:")) != -1) {
+        switch (opt) {
+        case 'r':
+            reps = atoi(optarg);
+            break;
+        case 'a':
+            bin = optarg;
+            break;
+        default:
+            goto usage;
+        }
+    }
+    if (optind >= argc || reps < 1 || reps > REPS_MAX) {
+        goto usage;
+    }
+
+    char **cmd = argv + optind;
+    double ms  = wall(cmd, reps);
+    long sc    = syscalls(cmd);
+    long al    = bin != NULL ? allocs(bin, cmd) : -1;
+    printf("%.3f %ld %ld\n", ms, sc, al);
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: bench-run [-r reps] [-a counting-svc] -- cmd\n");
+    return 1;
+}
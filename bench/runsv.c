@@ -0,0 +1,482 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+
+/**
+ * Stand-in for runsvdir and runsv: supervise every service of svdir, log/
+ * companions included, without running anything. supervise/control becomes a
+ * fifo read like runsv does, and every state change is written to
+ * supervise/status, stat and pid the way runsv writes them, renamed into
+ * place. Processes are faked by increasing pids. Starting and stopping take
+ * the given delays, 0 by default.
+ *
+ * Usage: bench-runsv [-s start-ms] [-S stop-ms] svdir
+ *
+ * "ready" is printed once every control fifo is read. SIGTERM and SIGINT
+ * stop it, the fifos are left behind and control commands then fail like
+ * they would with runsv gone. One process holds an open fifo per service, so
+ * the services are spread over as many processes as the fd limit requires.
+ */
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TAI_OFFSET 4611686018427387914ULL
+
+typedef enum {
+    STATE_DOWN   = 0,
+    STATE_RUN    = 1,
+    STATE_FINISH = 2,
+} state;
+
+typedef struct {
+    char *dir;
+    int control;
+    state state;
+    char want;
+    int paused;
+    int term;
+    pid_t pid;
+    struct timespec since;
+
+    /**
+     * A start or a stop in progress reaches next at deadline, -1 when none.
+     */
+    int next;
+    struct timespec deadline;
+} service;
+
+static service *services;
+static size_t services_len;
+static long start_ms;
+static long stop_ms;
+static pid_t next_pid = 1000;
+static volatile sig_atomic_t stop;
+
+static void
+die(char const *what, char const *path)
+{
+    fprintf(stderr, "bench-runsv: %s %s: %s\n", what, path, strerror(errno));
+    exit(1);
+}
+
+static void
+on_signal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+static void
+add_service(char const *dir)
+{
+    static size_t cap;
+    if (services_len == cap) {
+        cap      = cap == 0 ? 64 : cap * 2;
+        services = realloc(services, cap * sizeof(*services));
+        if (services == NULL) {
+            die("realloc", "services");
+        }
+    }
+
+    services[services_len++] = (service){
+        .dir     = strdup(dir),
+        .control = -1,
+        .next    = -1,
+    };
+}
+
+static int
+is_dir(char const *path)
+{
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+static void
+discover(char const *svdir)
+{
+    DIR *d = opendir(svdir);
+    if (d == NULL) {
+        die("opendir", svdir);
+    }
+
+    struct dirent *e = NULL;
+    while ((e = readdir(d)) != NULL) {
+        char dir[PATH_MAX];
+        char log[PATH_MAX];
+        snprintf(dir, sizeof(dir), "%s/%s", svdir, e->d_name);
+        snprintf(log, sizeof(log), "%s/log", dir);
+        if (e->d_name[0] == '.' || !is_dir(dir)) {
+            continue;
+        }
+
+        add_service(dir);
+        if (is_dir(log)) {
+            add_service(log);
+        }
+    }
+
+    closedir(d);
+}
+
+/**
+ * Write data to dir/supervise/name through name.new, like runsv.
+ */
+static void
+put(char const *dir, char const *name, void const *data, size_t len)
+{
+    char tmp[PATH_MAX];
+    char path[PATH_MAX];
+    snprintf(tmp, sizeof(tmp), "%s/supervise/%s.new", dir, name);
+    snprintf(path, sizeof(path), "%s/supervise/%s", dir, name);
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        die("open", tmp);
+    }
+    if (write(fd, data, len) != (ssize_t)len) {
+        die("write", tmp);
+    }
+    close(fd);
+
+    if (rename(tmp, path) == -1) {
+        die("rename", path);
+    }
+}
+
+static void
+write_status(service const *s)
+{
+    unsigned char status[20] = {0};
+    uint64_t sec             = TAI_OFFSET + (uint64_t)s->since.tv_sec;
+    uint32_t nsec            = (uint32_t)s->since.tv_nsec;
+    for (int i = 0; i < 8; ++i) {
+        status[i] = sec >> (56 - 8 * i);
+    }
+    for (int i = 0; i < 4; ++i) {
+        status[8 + i]  = nsec >> (24 - 8 * i);
+        status[12 + i] = (uint32_t)s->pid >> (8 * i);
+    }
+    status[16] = s->paused;
+    status[17] = s->want;
+    status[18] = s->term;
+    status[19] = s->state;
+    put(s->dir, "status", status, sizeof(status));
+
+    static char const *const states[] = {"down", "run", "finish"};
+    char stat[64];
+    int l = snprintf(stat, sizeof(stat), "%s", states[s->state]);
+    if (s->paused) {
+        l += snprintf(stat + l, sizeof(stat) - l, ", paused");
+    }
+    if (s->term) {
+        l += snprintf(stat + l, sizeof(stat) - l, ", got TERM");
+    }
+    if (s->state == STATE_RUN && s->want == 'd') {
+        l += snprintf(stat + l, sizeof(stat) - l, ", want down");
+    } else if (s->state == STATE_DOWN && s->want == 'u') {
+        l += snprintf(stat + l, sizeof(stat) - l, ", want up");
+    }
+    stat[l++] = '\n';
+    put(s->dir, "stat", stat, l);
+
+    char pid[16];
+    l = s->state == STATE_RUN ? snprintf(pid, sizeof(pid), "%d\n", s->pid)
+                              : 0;
+    put(s->dir, "pid", pid, l);
+}
+
+static void
+set_state(service *s, state st)
+{
+    s->state  = st;
+    s->pid    = st == STATE_RUN ? next_pid++ : 0;
+    s->paused = 0;
+    s->term   = 0;
+    s->next   = -1;
+    clock_gettime(CLOCK_REALTIME, &s->since);
+    write_status(s);
+}
+
+/**
+ * Move s to st after ms, right away when ms is 0.
+ */
+static void
+schedule(service *s, state st, long ms)
+{
+    if (ms == 0) {
+        set_state(s, st);
+        return;
+    }
+
+    // runsv tells about the signal it sent right away
+    s->next = st;
+    write_status(s);
+    clock_gettime(CLOCK_MONOTONIC, &s->deadline);
+    s->deadline.tv_sec += ms / 1000;
+    s->deadline.tv_nsec += ms % 1000 * 1000000;
+    if (s->deadline.tv_nsec >= 1000000000) {
+        s->deadline.tv_sec += 1;
+        s->deadline.tv_nsec -= 1000000000;
+    }
+}
+
+static void
+control(service *s, char c)
+{
+    int running = s->state == STATE_RUN && s->next == -1;
+    int down    = s->state == STATE_DOWN && s->next == -1;
+
+    switch (c) {
+    case 'u':
+        s->want = 'u';
+        if (down) {
+            schedule(s, STATE_RUN, start_ms);
+        }
+        break;
+    case 'o':
+        s->want = 'd';
+        if (down) {
+            schedule(s, STATE_RUN, start_ms);
+        }
+        break;
+    case 'd':
+        s->want = 'd';
+        if (running) {
+            s->term = 1;
+            schedule(s, STATE_DOWN, stop_ms);
+        }
+        break;
+    case 't':
+    case 'k':
+        // the process dies, to be restarted when wanted up
+        if (running) {
+            s->term = c == 't';
+            schedule(s, STATE_DOWN, stop_ms);
+        }
+        break;
+    case 'p':
+    case 'c':
+        if (running) {
+            s->paused = c == 'p';
+            write_status(s);
+        }
+        break;
+    default:
+        // the other signals leave the fake process as is
+        break;
+    }
+}
+
+/**
+ * Apply the starts and stops due by now, returns the milliseconds until the
+ * next one or -1 when none is left.
+ */
+static int
+due(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    long wait = -1;
+    for (size_t i = 0; i < services_len; ++i) {
+        service *s = &services[i];
+        if (s->next == -1) {
+            continue;
+        }
+
+        long ms = (s->deadline.tv_sec - now.tv_sec) * 1000 +
+                  (s->deadline.tv_nsec - now.tv_nsec) / 1000000;
+        if (ms <= 0) {
+            set_state(s, s->next);
+            if (s->state == STATE_DOWN && s->want == 'u') {
+                schedule(s, STATE_RUN, start_ms);
+            }
+        }
+        if (s->next != -1 && (wait == -1 || ms < wait)) {
+            wait = ms < 0 ? 0 : ms;
+        }
+    }
+
+    return (int)wait;
+}
+
+/**
+ * Supervise services[from..to), reporting readiness on ready.
+ */
+static void
+supervise(size_t from, size_t to, int ready)
+{
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    if (ep == -1) {
+        die("epoll_create1", "");
+    }
+
+    for (size_t i = from; i < to; ++i) {
+        service *s = &services[i];
+
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/supervise", s->dir);
+        if (mkdir(path, 0700) == -1 && errno != EEXIST) {
+            die("mkdir", path);
+        }
+
+        // replace what's there, a plain file left by bench-gen included
+        snprintf(path, sizeof(path), "%s/supervise/control", s->dir);
+        unlink(path);
+        if (mkfifo(path, 0600) == -1) {
+            die("mkfifo", path);
+        }
+
+        // read and write, the fifo then never reads as closed
+        s->control = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (s->control == -1) {
+            die("open", path);
+        }
+
+        struct epoll_event ev = {.events = EPOLLIN, .data.u64 = i};
+        if (epoll_ctl(ep, EPOLL_CTL_ADD, s->control, &ev) == -1) {
+            die("epoll_ctl", path);
+        }
+
+        snprintf(path, sizeof(path), "%s/down", s->dir);
+        int is_down = access(path, F_OK) == 0;
+        s->want     = is_down ? 'd' : 'u';
+        set_state(s, is_down ? STATE_DOWN : STATE_RUN);
+    }
+
+    // only this process' services from now on
+    services += from;
+    services_len = to - from;
+    if (write(ready, "", 1) != 1) {
+        die("write", "ready");
+    }
+    close(ready);
+
+    struct epoll_event evs[64];
+    while (!stop) {
+        int n = epoll_wait(ep, evs, 64, due());
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            die("epoll_wait", "");
+        }
+
+        for (int i = 0; i < n; ++i) {
+            service *s = &services[evs[i].data.u64 - from];
+
+            char buf[64];
+            ssize_t l = 0;
+            while ((l = read(s->control, buf, sizeof(buf))) > 0) {
+                for (ssize_t j = 0; j < l; ++j) {
+                    control(s, buf[j]);
+                }
+            }
+        }
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "s:S:")) != -1) {
+        switch (opt) {
+        case 's':
+            start_ms = atol(optarg);
+            break;
+        case 'S':
+            stop_ms = atol(optarg);
+            break;
+        default:
+            goto usage;
+        }
+    }
+    if (argc - optind != 1) {
+        goto usage;
+    }
+
+    discover(argv[optind]);
+
+    struct rlimit rl;
+    getrlimit(RLIMIT_NOFILE, &rl);
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+    size_t per = rl.rlim_cur > 128 ? rl.rlim_cur - 64 : 64;
+
+    struct sigaction sa = {.sa_handler = on_signal};
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+
+    int p[2];
+    if (pipe(p) == -1) {
+        die("pipe", "");
+    }
+
+    size_t workers = 0;
+    pid_t *pids    = calloc(services_len / per + 1, sizeof(*pids));
+    if (pids == NULL) {
+        die("calloc", "pids");
+    }
+    for (size_t from = 0; from < services_len; from += per) {
+        size_t to = from + per < services_len ? from + per : services_len;
+        pid_t pid = fork();
+        if (pid == -1) {
+            die("fork", "");
+        } else if (pid == 0) {
+            close(p[0]);
+            // pids stay apart between the workers
+            next_pid += (pid_t)from * 64;
+            supervise(from, to, p[1]);
+            _exit(0);
+        }
+        pids[workers++] = pid;
+    }
+    close(p[1]);
+
+    char c = 0;
+    for (size_t i = 0; i < workers; ++i) {
+        if (read(p[0], &c, 1) != 1) {
+            fprintf(stderr, "bench-runsv: a worker failed\n");
+            stop = 1;
+            break;
+        }
+    }
+    close(p[0]);
+
+    if (!stop) {
+        printf("ready\n");
+        fflush(stdout);
+    }
+
+    // SIGTERM and SIGINT interrupt the wait
+    while (!stop && wait(NULL) > 0) {
+    }
+    for (size_t i = 0; i < workers; ++i) {
+        kill(pids[i], SIGTERM);
+    }
+    while (wait(NULL) > 0) {
+    }
+
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: bench-runsv [-s start-ms] [-S stop-ms] svdir\n");
+    return 1;
+}
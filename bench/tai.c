@@ -0,0 +1,127 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+
+/**
+ * The baseline `svc tai64n` is measured against: convert the tai64n labels
+ * starting the lines of file, stdin by default, to local time the naive way,
+ * a line at a time through stdio, one hex digit after the other and a
+ * localtime_r() per line. With -g, write instead a svlogd log of n lines
+ * stamped 4 ms apart to stdout.
+ *
+ * Usage: bench-tai [-g n] [file]
+ */
+#include <errno.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TAI_OFFSET 4611686018427387914ULL
+
+static void
+die(char const *what, char const *path)
+{
+    fprintf(stderr, "bench-tai: %s %s: %s\n", what, path, strerror(errno));
+    exit(1);
+}
+
+static void
+generate(unsigned long n)
+{
+    static char const *const words[] = {
+        "request", "served", "timeout", "worker", "connection", "reset",
+        "queue",   "status", "latency", "started", "stopped",   "user",
+    };
+    uint64_t ns = 1760000000ULL * 1000000000ULL;
+    for (unsigned long i = 0; i < n; ++i, ns += 4000000) {
+        printf("@%016llx%08llx svc[%lu]:",
+               (unsigned long long)(TAI_OFFSET + ns / 1000000000),
+               (unsigned long long)(ns % 1000000000),
+               i % 100000);
+        for (unsigned long w = 0; w < 8; ++w) {
+            printf(" %s", words[(i * 7 + w * 5) % 12]);
+        }
+        printf(" id=%lu\n", i * 2654435761UL % 1000000000);
+    }
+}
+
+/**
+ * Returns the value of the hex digit c, -1 if it isn't one.
+ */
+static int
+hex(int c)
+{
+    return c >= '0' && c <= '9'   ? c - '0'
+           : c >= 'a' && c <= 'f' ? c - 'a' + 10
+           : c >= 'A' && c <= 'F' ? c - 'A' + 10
+                                  : -1;
+}
+
+static void
+convert(FILE *in)
+{
+    char line[4096];
+    while (fgets(line, sizeof(line), in) != NULL) {
+        uint64_t sec  = 0;
+        uint64_t nsec = 0;
+        int i         = 1;
+        for (; line[0] == '@' && i <= 24 && hex(line[i]) != -1; ++i) {
+            if (i <= 16) {
+                sec = sec << 4 | hex(line[i]);
+            } else {
+                nsec = nsec << 4 | hex(line[i]);
+            }
+        }
+        if (i != 25) {
+            fputs(line, stdout);
+            continue;
+        }
+
+        time_t t     = (time_t)(sec - TAI_OFFSET);
+        struct tm tm = {0};
+        char when[32];
+        localtime_r(&t, &tm);
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+        printf("%s.%09llu%s", when, (unsigned long long)nsec, line + 25);
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    long gen = -1;
+
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "g:")) != -1) {
+        switch (opt) {
+        case 'g':
+            gen = atol(optarg);
+            break;
+        default:
+            goto usage;
+        }
+    }
+    if (argc - optind > 1) {
+        goto usage;
+    }
+
+    if (gen >= 0) {
+        generate(gen);
+        return 0;
+    }
+
+    FILE *in = stdin;
+    if (optind < argc && (in = fopen(argv[optind], "r")) == NULL) {
+        die("fopen", argv[optind]);
+    }
+    convert(in);
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: bench-tai [-g n] [file]\n");
+    return 1;
+}
@@ -0,0 +1,108 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#ifndef SVC_BUF_H
+#define SVC_BUF_H
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * A growable byte buffer, zero initialize it before use.
+ */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} buf;
+
+/**
+ * Make room for l more bytes in b.
+ *
+ * Returns -1 on error and set errno.
+ */
+static inline int
+buf_reserve(buf *b, size_t l)
+{
+    if (b->len + l <= b->cap) {
+        return 0;
+    }
+
+    size_t cap = b->cap == 0 ? 256 : b->cap;
+    while (cap < b->len + l) {
+        cap <<= 1;
+    }
+
+    char *data = realloc(b->data, cap);
+    if (data == NULL) {
+        return -1;
+    }
+
+    b->data = data;
+    b->cap  = cap;
+    return 0;
+}
+
+/**
+ * Append l bytes of data to b.
+ *
+ * Returns -1 on error and set errno.
+ */
+static inline int
+buf_append(buf *b, void const *data, size_t l)
+{
+    if (buf_reserve(b, l) < 0) {
+        return -1;
+    }
+
+    memcpy(b->data + b->len, data, l);
+    b->len += l;
+    return 0;
+}
+
+/**
+ * Append the printf formatted arguments to b, without the NUL byte.
+ *
+ * Returns -1 on error and set errno.
+ */
+static inline int
+buf_printf(buf *b, char const *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(b->data + b->len, b->cap - b->len, fmt, ap);
+    va_end(ap);
+
+    if (n < 0) {
+        return -1;
+    }
+
+    // the NUL byte needs room too
+    if ((size_t)n >= b->cap - b->len) {
+        if (buf_reserve(b, n + 1) < 0) {
+            return -1;
+        }
+
+        va_start(ap, fmt);
+        vsnprintf(b->data + b->len, b->cap - b->len, fmt, ap);
+        va_end(ap);
+    }
+
+    b->len += n;
+    return 0;
+}
+
+/**
+ * Free the given buffer and reset it.
+ */
+static inline void
+buf_free(buf *b)
+{
+    free(b->data);
+    *b = (buf){0};
+}
+
+#endif
@@ -3,13 +3,55 @@
  * Copyright (C) 2025 Wladimir Bec
  */
 #include "config.h"
+#include "err.h"
+#include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define AVDIR_DEFAULT "/etc/sv"
 #define SVDIR_DEFAULT "/var/service"
 
-cfg
-cfg_get(void)
+/**
+ * Split the colon separated dirs of svdir into the roots of config, empty ones
+ * are skipped. The copy split lives as long as the process.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+split_roots(cfg *config, char const *svdir)
+{
+    if (strchr(svdir, ':') == NULL) {
+        config->roots[config->roots_len++] = svdir;
+        return 0;
+    }
+
+    char *copy = strdup(svdir);
+    if (copy == NULL) {
+        set_last_error("strdup failed: %s", strerror(errno));
+        return -1;
+    }
+
+    char *root = NULL;
+    while ((root = strsep(&copy, ":")) != NULL) {
+        if (*root == '\0') {
+            continue;
+        } else if (config->roots_len == CFG_ROOTS_MAX) {
+            set_last_error("SVDIR holds more than %d dirs", CFG_ROOTS_MAX);
+            return -1;
+        }
+        config->roots[config->roots_len++] = root;
+    }
+
+    if (config->roots_len == 0) {
+        config->roots[config->roots_len++] = SVDIR_DEFAULT;
+    }
+
+    return 0;
+}
+
+int
+cfg_get(cfg *config)
 {
     char *svdir = getenv("SVDIR");
     if (svdir == NULL) {
@@ -21,8 +63,66 @@ cfg_get(void)
         available = AVDIR_DEFAULT;
     }
 
-    return (cfg){
-        .svdir     = svdir,
-        .available = available,
+    *config = (cfg){
+        .svdir        = svdir,
+        .available    = available,
+        .jobs         = 0,
+        .socket       = getenv("SVCSOCK"),
+        .history      = getenv("SVCHIST"),
+        .latency      = getenv("SVCLAT"),
+        .format       = CFG_FORMAT_TABLE,
+        .filter       = {.status = -1, .down = -1, .log = -1},
+        .columns      = {CFG_COL_PID,
+                         CFG_COL_NAME,
+                         CFG_COL_STATUS,
+                         CFG_COL_DOWN,
+                         CFG_COL_TIME},
+        .columns_len  = CFG_COL_ROOT, // the ones before ROOT
+        .sort         = -1,
+        .lines        = 10,
+        .batch        = 1,
+        .svdir_fd     = -1,
+        .available_fd = -1,
     };
+
+    if (split_roots(config, svdir) == -1) {
+        return -1;
+    }
+
+    config->svdir = config->roots[0];
+    if (config->roots_len > 1) {
+        memmove(config->columns + 1,
+                config->columns,
+                sizeof(*config->columns) * config->columns_len);
+        config->columns[0] = CFG_COL_ROOT;
+        ++config->columns_len;
+    }
+
+    return 0;
+}
+
+static int
+open_dir(int *fd, char const *path)
+{
+    if (*fd == -1) {
+        *fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (*fd == -1) {
+            set_last_error(
+                "failed to open dir '%s': %s", path, strerror(errno));
+        }
+    }
+
+    return *fd;
+}
+
+int
+cfg_svdir_fd(cfg *config)
+{
+    return open_dir(&config->svdir_fd, config->svdir);
+}
+
+int
+cfg_available_fd(cfg *config)
+{
+    return open_dir(&config->available_fd, config->available);
 }
@@ -5,21 +5,194 @@
 #ifndef SVC_CFG_H
 #define SVC_CFG_H
 
+#include <time.h>
+
+/**
+ * Output formats of the services, the padded table or one record per
+ * service.
+ */
+typedef enum {
+    CFG_FORMAT_TABLE,
+    CFG_FORMAT_JSON,
+    CFG_FORMAT_TSV,
+    CFG_FORMAT_NUL,
+} cfg_format;
+
+/**
+ * Columns of the services table, in their default order, ROOT goes first and
+ * only when there are several roots. RESTARTS is only shown when asked for.
+ */
+typedef enum {
+    CFG_COL_PID,
+    CFG_COL_NAME,
+    CFG_COL_STATUS,
+    CFG_COL_DOWN,
+    CFG_COL_TIME,
+    CFG_COL_ROOT,
+    CFG_COL_RESTARTS,
+    CFG_COLS_LEN,
+} cfg_col;
+
+/**
+ * Which services view shows. A service and its log are filtered on their own,
+ * except for log which keeps or drops both.
+ */
 typedef struct {
     /**
-     * Dir containing running services.
+     * Shell-style pattern of the names, NULL for any.
+     */
+    char const *pattern;
+
+    /**
+     * An svc_status, or -1 for any.
+     */
+    int status;
+
+    /**
+     * 1 for the down services, 0 for the others or -1 for any.
+     */
+    int down;
+
+    /**
+     * 1 for the services having a log, 0 for the others or -1 for any.
+     */
+    int log;
+} cfg_filter;
+
+#define CFG_ROOTS_MAX 64
+
+typedef struct {
+    /**
+     * Dir containing running services, the first of roots.
      */
     char const *svdir;
 
+    /**
+     * Every dir containing running services, SVDIR holds them separated by
+     * colons. View scans them all, the other commands only use svdir.
+     */
+    char const *roots[CFG_ROOTS_MAX];
+    int roots_len;
+
     /**
      * Dir containing all available services.
      */
     char const *available;
+
+    /**
+     * Number of workers scanning the services, 1 means sequential and 0 lets
+     * svc use io_uring when available.
+     */
+    long jobs;
+
+    /**
+     * Seconds control commands wait for their services to reach their new
+     * status, 0 to not wait.
+     */
+    double wait;
+
+    /**
+     * 1 to record the latency of the control commands, waited for only with
+     * wait, otherwise resolved by a later svc.
+     */
+    int timing;
+
+    /**
+     * Services rolling-restart restarts at once, then seconds they must keep
+     * running before the next ones are.
+     */
+    long batch;
+    double settle;
+
+    /**
+     * Unix socket of the svcd daemon, NULL for .svcd.sock inside svdir.
+     */
+    char const *socket;
+
+    /**
+     * History of the transitions, NULL for .svc.history inside svdir.
+     */
+    char const *history;
+
+    /**
+     * Latencies recorded by timing, NULL for .svc.latency inside svdir.
+     */
+    char const *latency;
+
+    /**
+     * Starts within an hour past which a watched service is downed, 0 to
+     * never down.
+     */
+    long auto_down;
+
+    /**
+     * Last lines of each log printed by log, then whether to follow the logs
+     * as they grow.
+     */
+    long lines;
+    int follow;
+
+    /**
+     * Times the logs are read between, a since of 0 reads them from their
+     * start and an until of 0 up to their end.
+     */
+    struct timespec since;
+    struct timespec until;
+
+    /**
+     * How view prints the services.
+     */
+    cfg_format format;
+
+    /**
+     * Services view shows, they're filtered while scanning so that the others
+     * are never read.
+     */
+    cfg_filter filter;
+
+    /**
+     * Columns of the table in the order they're shown, only what they need is
+     * read.
+     */
+    cfg_col columns[CFG_COLS_LEN];
+    int columns_len;
+
+    /**
+     * Column view sorts the services by, -1 to keep the order of their names,
+     * descending when sort_desc is 1.
+     */
+    int sort;
+    int sort_desc;
+
+    /**
+     * Opened on first use by cfg_svdir_fd() and cfg_available_fd(), -1 until
+     * then.
+     */
+    int svdir_fd;
+    int available_fd;
 } cfg;
 
 /**
- * Return the current config.
+ * Read the current config into config.
+ *
+ * Returns -1 on error and set last_error.
+ */
+int cfg_get(cfg *config);
+
+/**
+ * Returns a fd of the running services dir, opened on first use and then
+ * reused for the lifetime of config.
+ *
+ * Returns -1 on error and set last_error.
+ */
+int cfg_svdir_fd(cfg *config);
+
+/**
+ * Returns a fd of the available services dir, opened on first use and then
+ * reused for the lifetime of config.
+ *
+ * Returns -1 on error and set last_error.
  */
-cfg cfg_get(void);
+int cfg_available_fd(cfg *config);
 
 #endif
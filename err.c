@@ -8,7 +8,9 @@
 #include <string.h>
 
 #define err_len 512
-static char err[err_len];
+
+// each thread keeps its own error so pool workers can't clobber each other
+static __thread char err[err_len];
 
 char const *
 get_last_error(void)
@@ -0,0 +1,339 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#include "history.h"
+#include "err.h"
+#include "io.h"
+#include "slotfile.h"
+#include "tai.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <time.h>
+
+#define HIST_MAGIC "svchist1"
+
+// services and transitions kept, both powers of 2
+#define HIST_SLOTS 65536
+#define HIST_RING  65536
+
+typedef struct {
+    /**
+     * param is the size of the ring.
+     */
+    slotfile_header base;
+
+    /**
+     * Transitions ever recorded, the next one goes to head % ring.
+     */
+    uint64_t head;
+} hist_header;
+
+/**
+ * The last status known of a service and its starts of the last hour.
+ */
+typedef struct {
+    /**
+     * Hash of the service, 0 for a free slot.
+     */
+    uint64_t key;
+    unsigned char since[TAI_PACK_LEN];
+    int32_t pid;
+    uint8_t status;
+    uint8_t pad[3];
+
+    /**
+     * Newest bucket of starts, the unix time of a start divided by
+     * HIST_BUCKET_SECS, its count is starts[bucket % HIST_BUCKETS].
+     */
+    uint32_t bucket;
+    uint16_t starts[HIST_BUCKETS];
+} hist_slot;
+
+typedef struct {
+    uint64_t key;
+    unsigned char when[TAI_PACK_LEN];
+    int32_t pid;
+    uint8_t from;
+    uint8_t to;
+    uint8_t pad[2];
+} hist_entry;
+
+static slotfile_layout const layout = {
+    .magic     = HIST_MAGIC,
+    .what      = "history",
+    .slots     = HIST_SLOTS,
+    .slot_size = sizeof(hist_slot),
+    .param     = HIST_RING,
+    .tail      = sizeof(hist_entry) * HIST_RING,
+};
+
+struct hist {
+    slotfile file;
+    char const *svdir;
+
+    hist_header *header;
+    hist_entry *ring;
+};
+
+hist *
+hist_open(cfg const *config, int writable)
+{
+    char path[4096]  = {0};
+    char const *file = config->history;
+    if (file == NULL) {
+        if (io_snprintf(path,
+                        sizeof(path),
+                        "%s/.svc.history",
+                        config->svdir) == -1) {
+            wrap_last_error("io_snprintf failed");
+            return NULL;
+        }
+        file = path;
+    }
+
+    hist *h = calloc(1, sizeof(*h));
+    if (h == NULL) {
+        set_last_error("calloc failed: %s", strerror(errno));
+        return NULL;
+    }
+
+    if (slotfile_open(&h->file, file, &layout, writable) == -1) {
+        free(h);
+        return NULL;
+    }
+
+    h->svdir  = config->svdir;
+    h->header = (hist_header *)h->file.map;
+    h->ring   = slotfile_tail(&h->file);
+    return h;
+}
+
+void
+hist_close(hist *h)
+{
+    if (h == NULL) {
+        return;
+    }
+
+    slotfile_close(&h->file);
+    free(h);
+}
+
+/**
+ * Returns the key of s, its root is left out when it's svdir so that a
+ * service has a single key whichever way it's scanned.
+ */
+static uint64_t
+key_of(hist const *h, svc const *s)
+{
+    int other = s->root != NULL && strcmp(s->root, h->svdir) != 0;
+    return slotfile_key(other ? s->root : NULL, s->name);
+}
+
+/**
+ * Count a start at the unix time t into the buckets of sl, the buckets left
+ * behind are reset.
+ */
+static void
+add_start(hist_slot *sl, time_t t)
+{
+    uint32_t b = t / HIST_BUCKET_SECS;
+    if (b + HIST_BUCKETS <= sl->bucket) {
+        // older than the hour kept
+        return;
+    }
+
+    if (b > sl->bucket) {
+        uint32_t gap = b - sl->bucket;
+        for (uint32_t i = 1; i <= gap && i <= HIST_BUCKETS; ++i) {
+            sl->starts[(sl->bucket + i) % HIST_BUCKETS] = 0;
+        }
+        sl->bucket = b;
+    }
+
+    if (sl->starts[b % HIST_BUCKETS] < UINT16_MAX) {
+        ++sl->starts[b % HIST_BUCKETS];
+    }
+}
+
+/**
+ * Record the transition of sl to the status of s, if any.
+ */
+static void
+record(hist *h, hist_slot *sl, svc const *s)
+{
+    unsigned char since[TAI_PACK_LEN] = {0};
+    tai_pack(&s->since, since);
+    if (sl->status == s->status && sl->pid == s->pid &&
+        memcmp(sl->since, since, sizeof(since)) == 0) {
+        return;
+    }
+
+    // a start is a new process running, finish to run included
+    if (s->status == SVC_RUNNING &&
+        (sl->status != SVC_RUNNING || sl->pid != s->pid)) {
+        add_start(sl, s->since.tv_sec);
+    }
+
+    hist_entry *e = &h->ring[h->header->head++ & (HIST_RING - 1)];
+    *e            = (hist_entry){
+                   .key  = sl->key,
+                   .pid  = s->pid,
+                   .from = sl->status,
+                   .to   = s->status,
+    };
+    memcpy(e->when, since, sizeof(since));
+
+    memcpy(sl->since, since, sizeof(since));
+    sl->pid    = s->pid;
+    sl->status = s->status;
+}
+
+/**
+ * Fill the restarts and flapping of s from the buckets of sl at the unix
+ * time now.
+ */
+static void
+count(hist_slot const *sl, time_t now, svc *s)
+{
+    uint32_t nb  = now / HIST_BUCKET_SECS;
+    int restarts = 0;
+    int recent   = 0;
+    for (uint32_t i = 0; i < HIST_BUCKETS; ++i) {
+        // a bucket ahead of now comes from a clock set back
+        uint32_t b = sl->bucket - i;
+        if (b > nb || b + HIST_BUCKETS <= nb) {
+            continue;
+        }
+
+        restarts += sl->starts[b % HIST_BUCKETS];
+        if (b + 2 > nb) {
+            recent += sl->starts[b % HIST_BUCKETS];
+        }
+    }
+
+    s->restarts = restarts;
+    s->flapping = recent >= HIST_FLAP_STARTS;
+}
+
+int
+hist_observe(hist *h, svc **list, size_t n)
+{
+    struct timespec now = {0};
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    if (slotfile_lock(&h->file) == -1) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        svc *s        = list[i];
+        int fresh     = 0;
+        hist_slot *sl = slotfile_find(&h->file, key_of(h, s), 1, &fresh);
+        if (sl == NULL) {
+            // never recorded, or no room left for it
+            s->restarts = -1;
+            continue;
+        }
+
+        if (fresh) {
+            tai_pack(&s->since, sl->since);
+            sl->pid    = s->pid;
+            sl->status = s->status;
+        } else if (h->file.writable) {
+            record(h, sl, s);
+        }
+        count(sl, now.tv_sec, s);
+    }
+
+    slotfile_unlock(&h->file);
+    return 0;
+}
+
+typedef struct {
+    uint64_t key;
+    svc const *s;
+} hist_name;
+
+static int
+cmp_names(void const *x, void const *y)
+{
+    uint64_t a = ((hist_name const *)x)->key;
+    uint64_t b = ((hist_name const *)y)->key;
+    return (a > b) - (a < b);
+}
+
+int
+hist_print(hist *h, FILE *f, svc *const *list, size_t n)
+{
+    hist_name *names = malloc(sizeof(*names) * (n + 1));
+    if (names == NULL) {
+        set_last_error("malloc failed: %s", strerror(errno));
+        return -1;
+    }
+
+    int width = 4;
+    for (size_t i = 0; i < n; ++i) {
+        names[i] = (hist_name){.key = key_of(h, list[i]), .s = list[i]};
+        int l    = strlen(list[i]->name);
+        width    = l > width ? l : width;
+    }
+    qsort(names, n, sizeof(*names), cmp_names);
+
+    if (flock(h->file.fd, LOCK_SH) == -1) {
+        set_last_error("failed to lock history: %s", strerror(errno));
+        free(names);
+        return -1;
+    }
+
+    fprintf(f,
+            "%-23s  %-*s  %-9s  %-9s  %s\n",
+            "TIME",
+            width,
+            "NAME",
+            "FROM",
+            "TO",
+            "PID");
+    fputs("-----------------------  ", f);
+    for (int i = 0; i < width; ++i) {
+        fputc('-', f);
+    }
+    fputs("  ---------  ---------  ---\n", f);
+
+    uint64_t head  = h->header->head;
+    uint64_t first = head > HIST_RING ? head - HIST_RING : 0;
+    for (uint64_t i = first; i < head; ++i) {
+        hist_entry const *e = &h->ring[i & (HIST_RING - 1)];
+        hist_name key       = {.key = e->key};
+        hist_name const *m =
+            bsearch(&key, names, n, sizeof(*names), cmp_names);
+        if (m == NULL) {
+            continue;
+        }
+
+        struct timespec ts = {0};
+        tai_unpack(e->when, &ts);
+        struct tm tm  = {0};
+        char when[24] = {0};
+        localtime_r(&ts.tv_sec, &tm);
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+
+        fprintf(f,
+                "%s.%03ld  %-*s  %-9s  %-9s  %d\n",
+                when,
+                ts.tv_nsec / 1000000,
+                width,
+                m->s->name,
+                svc_status_str(e->from),
+                svc_status_str(e->to),
+                (int)e->pid);
+    }
+
+    slotfile_unlock(&h->file);
+    free(names);
+    return 0;
+}
@@ -0,0 +1,66 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#ifndef SVC_HISTORY_H
+#define SVC_HISTORY_H
+
+#include "arr.h"
+#include "config.h"
+#include "service.h"
+#include <stdio.h>
+
+/**
+ * Starts are counted per bucket of HIST_BUCKET_SECS seconds, the last
+ * HIST_BUCKETS of them make the hour restarts are reported over.
+ */
+#define HIST_BUCKETS     12
+#define HIST_BUCKET_SECS 300
+
+/**
+ * A service flaps when it started HIST_FLAP_STARTS times within the current
+ * and the previous bucket, that's at most 10 minutes.
+ */
+#define HIST_FLAP_STARTS 5
+
+/**
+ * The transitions observed by every svc process, kept in a file mapped in
+ * memory and shared by all of them: the last status known of each service
+ * with its recent starts, and a ring of the last transitions.
+ */
+typedef struct hist hist;
+
+/**
+ * Open the history of config, only read unless writable is 1. A writable
+ * history is created when missing and opened read-only when it can't be
+ * written. Nothing is recorded in a history only read, the restarts are still
+ * filled. The history must be closed upon usage with hist_close().
+ *
+ * Returns NULL on error and set last_error.
+ */
+hist *hist_open(cfg const *config, int writable);
+
+/**
+ * Close a history returned by hist_open(), NULL is ignored.
+ */
+void hist_close(hist *h);
+
+/**
+ * Compare the n services of list, whose status was read, to the last status
+ * known of each of them and record the transitions. Then fill their restarts
+ * and flapping. The first time a service is observed nothing is recorded, a
+ * history only read leaves the services it never recorded unknown.
+ *
+ * Returns -1 on error and set last_error.
+ */
+int hist_observe(hist *h, svc **list, size_t n);
+
+/**
+ * Print to f the transitions still in the ring of the n services of list,
+ * oldest first.
+ *
+ * Returns -1 on error and set last_error.
+ */
+int hist_print(hist *h, FILE *f, svc *const *list, size_t n);
+
+#endif
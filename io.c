@@ -4,75 +4,257 @@
  */
 #include "io.h"
 #include "err.h"
+#include "stats.h"
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
 #include <unistd.h>
 
-static int
-sort(void const *a, void const *b)
+// getdents64 fills this much of the listing per call, enough for thousands
+// of entries
+#define DENTS_LEN (64 * 1024)
+
+/**
+ * A record of getdents64, glibc and musl don't agree on exposing it.
+ */
+struct dent {
+    uint64_t ino;
+    int64_t off;
+    unsigned short reclen;
+    unsigned char type;
+    char name[];
+};
+
+/**
+ * A name with its first 8 bytes packed big-endian, comparing keys compares
+ * those bytes like strcmp does.
+ */
+typedef struct {
+    uint64_t key;
+    char *name;
+} entry;
+
+static uint64_t
+prefix(char const *s)
 {
-    return strcmp(*(arr_of(char *))a, *(arr_of(char *))b);
+    uint64_t k = 0;
+    for (int i = 0; i < 8; ++i) {
+        k <<= 8;
+        if (*s != '\0') {
+            k |= (unsigned char)*s++;
+        }
+    }
+
+    return k;
 }
 
-static arr_of(char *) list(DIR *d)
+// runs of equal keys shorter than this are finished with strcmp
+#define SORT_RUN_MIN 16
+
+/**
+ * Sort es, whose names share their first depth bytes, by name: a LSD radix
+ * sort on the keys, which only moves 16 bytes per entry and never chases the
+ * name pointers. Runs of equal keys are then sorted on their next 8 bytes,
+ * or with strcmp when they are short.
+ */
+static void
+sort(entry *es, entry *tmp, size_t n, size_t depth)
 {
-    arr_of(char *) arr = (arr_of(char *))arr_alloc(NULL, 8);
-    if (arr == NULL) {
-        set_last_error("failed to allocate array: %s", strerror(errno));
-        return NULL;
+    for (int shift = 0; shift < 64 && n > 1; shift += 8) {
+        size_t counts[256] = {0};
+        for (size_t i = 0; i < n; ++i) {
+            ++counts[(es[i].key >> shift) & 0xff];
+        }
+
+        // every key shares this byte, the pass wouldn't move anything
+        if (counts[(es[0].key >> shift) & 0xff] == n) {
+            continue;
+        }
+
+        size_t at = 0;
+        for (int b = 0; b < 256; ++b) {
+            size_t c  = counts[b];
+            counts[b] = at;
+            at += c;
+        }
+
+        for (size_t i = 0; i < n; ++i) {
+            tmp[counts[(es[i].key >> shift) & 0xff]++] = es[i];
+        }
+        memcpy(es, tmp, sizeof(*es) * n);
     }
 
-    while (1) {
-        errno            = 0;
-        struct dirent *e = readdir(d);
-
-        if (e == NULL) {
-            if (errno != 0) {
-                set_last_error("failed to read dir: %s", strerror(errno));
-            err:
-                arr_free_free((arr_ptr)arr, free);
-                arr = NULL;
-            }
+    for (size_t i = 0; i < n;) {
+        size_t j = i + 1;
+        while (j < n && es[j].key == es[i].key) {
+            ++j;
+        }
 
-            break;
+        // a key ending with a NUL byte holds the whole name, names of a dir
+        // are unique so such a run is a single entry
+        if (j - i >= SORT_RUN_MIN && (es[i].key & 0xff) != 0) {
+            for (size_t k = i; k < j; ++k) {
+                es[k].key = prefix(es[k].name + depth + 8);
+            }
+            sort(es + i, tmp, j - i, depth + 8);
+        } else {
+            for (size_t k = i + 1; k < j; ++k) {
+                entry e   = es[k];
+                size_t at = k;
+                while (at > i && strcmp(es[at - 1].name, e.name) > 0) {
+                    es[at] = es[at - 1];
+                    --at;
+                }
+                es[at] = e;
+            }
         }
 
-        if (e->d_name[0] == '.') {
-            continue;
+        i = j;
+    }
+}
+
+/**
+ * Returns 1 if the entry d of the dir fd is a dir or a link, which is assumed
+ * to lead to one, otherwise 0. Only filesystems without d_type cost a statx.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+is_dir(int fd, struct dent const *d)
+{
+    if (d->type == DT_DIR || d->type == DT_LNK) {
+        return 1;
+    } else if (d->type != DT_UNKNOWN) {
+        return 0;
+    }
+
+    struct statx st = {0};
+    stats_io(1, 0, 0);
+    if (statx(fd, d->name, 0, STATX_TYPE, &st) == -1) {
+        // a dangling link is still listed, reading it reports the error
+        if (errno == ENOENT) {
+            return 1;
         }
+        set_last_error("failed to stat %s: %s", d->name, strerror(errno));
+        return -1;
+    }
+
+    return S_ISDIR(st.stx_mode);
+}
+
+/**
+ * Append the dirs of fd to *es, *len holds their count and *cap the capacity.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+list(int fd, arena *a, entry **es, size_t *len, size_t *cap)
+{
+    char *buf = malloc(DENTS_LEN);
+    if (buf == NULL) {
+        set_last_error("malloc failed: %s", strerror(errno));
+        return -1;
+    }
 
-        char *name = strdup(e->d_name);
-        if (name == NULL) {
-            set_last_error("strdup failed: %s", strerror(errno));
-            goto err;
+    int r = -1;
+    while (1) {
+        long n = syscall(SYS_getdents64, fd, buf, DENTS_LEN);
+        stats_io(1, n > 0 ? n : 0, 0);
+        if (n == -1) {
+            set_last_error("failed to read dir: %s", strerror(errno));
+            goto end;
+        } else if (n == 0) {
+            break;
         }
-        if (arr_append((arr_ptr *)&arr, name) < 0) {
-            set_last_error("failed to append to array: %s", strerror(errno));
-            free(name);
-            goto err;
+
+        for (long off = 0; off < n;) {
+            struct dent const *d = (struct dent const *)(buf + off);
+            off += d->reclen;
+
+            if (d->name[0] == '.') {
+                continue;
+            }
+
+            int dir = is_dir(fd, d);
+            if (dir == -1) {
+                goto end;
+            } else if (dir == 0) {
+                continue;
+            }
+
+            if (*len == *cap) {
+                size_t c = *cap == 0 ? 64 : *cap * 2;
+                entry *e = realloc(*es, sizeof(*e) * c);
+                if (e == NULL) {
+                    set_last_error("realloc failed: %s", strerror(errno));
+                    goto end;
+                }
+                *es  = e;
+                *cap = c;
+            }
+
+            char *name = arena_strdup(a, d->name);
+            if (name == NULL) {
+                set_last_error("arena_strdup failed: %s", strerror(errno));
+                goto end;
+            }
+            (*es)[(*len)++] = (entry){.key = prefix(name), .name = name};
         }
     }
 
-    return arr;
+    r = 0;
+
+end:
+    free(buf);
+    return r;
 }
 
-arr_of(char *) io_list_dirs(char const *path)
+arr_of(char *) io_list_dirs(char const *path, arena *a)
 {
-    DIR *d = opendir(path);
-    if (d == NULL) {
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    stats_io(fd == -1 ? 1 : 2, 0, 0);
+    if (fd == -1) {
         set_last_error("failed to open dir '%s': %s", path, strerror(errno));
         return NULL;
     }
 
-    arr_of(char *) arr = list(d);
-    if (arr != NULL) {
-        qsort(arr, arr_len(arr), sizeof(*arr), sort);
+    arr_of(char *) arr = NULL;
+    entry *es          = NULL;
+    size_t len         = 0;
+    size_t cap         = 0;
+
+    if (list(fd, a, &es, &len, &cap) == -1) {
+        goto end;
+    }
+
+    entry *tmp = malloc(sizeof(*tmp) * (len + 1));
+    arr        = (arr_of(char *))arr_alloc(NULL, len < 8 ? 8 : len);
+    if (tmp == NULL || arr == NULL) {
+        set_last_error("failed to allocate array: %s", strerror(errno));
+        free(tmp);
+        arr_free((arr_ptr)arr);
+        arr = NULL;
+        goto end;
+    }
+
+    sort(es, tmp, len, 0);
+    for (size_t i = 0; i < len; ++i) {
+        arr[i] = es[i].name;
     }
+    arr_len(arr) = len;
+    free(tmp);
 
-    closedir(d);
+end:
+    free(es);
+    close(fd);
     return arr;
 }
 
@@ -85,6 +267,7 @@ io_exists(char const *path)
 int
 io_existsat(int fd, char const *name)
 {
+    stats_io(1, 0, 0);
     if (faccessat(fd, name, F_OK, 0) == 0) {
         return 1;
     } else if (errno == ENOENT) {
@@ -119,11 +302,13 @@ io_readat(int fd, char const *path, char *buf, size_t buf_len)
 {
     int f = openat(fd, path, O_RDONLY);
     if (f == -1) {
+        stats_io(1, 0, 0);
         set_last_error("open failed: %s", strerror(errno));
         return -1;
     }
 
     int n = read(f, buf, buf_len);
+    stats_io(3, n > 0 ? n : 0, 0);
     if (n == -1) {
         set_last_error("%s", strerror(errno));
     }
@@ -149,3 +334,98 @@ io_writeat(int fd, char const *path, char *buf, size_t buf_len)
     close(f);
     return n;
 }
+
+int
+io_write_all(int fd, char const *buf, size_t buf_len)
+{
+    while (buf_len > 0) {
+        ssize_t n = write(fd, buf, buf_len);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            set_last_error("write failed: %s", strerror(errno));
+            return -1;
+        }
+        buf += n;
+        buf_len -= n;
+    }
+
+    return 0;
+}
+
+/**
+ * Returns 1 if a process accepts connections on the socket of addr, 0 if the
+ * socket is stale, -1 on error and set last_error.
+ */
+static int
+is_served(struct sockaddr_un const *addr)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        set_last_error("socket failed: %s", strerror(errno));
+        return -1;
+    }
+
+    int r = 1;
+    if (connect(fd, (struct sockaddr const *)addr, sizeof(*addr)) == -1) {
+        r = errno == ECONNREFUSED ? 0 : -1;
+        if (r == -1) {
+            set_last_error("failed to connect to %s: %s",
+                           addr->sun_path,
+                           strerror(errno));
+        }
+    }
+
+    close(fd);
+    return r;
+}
+
+int
+io_listen(char const *path)
+{
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (io_snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path) ==
+        -1) {
+        wrap_last_error("socket path too long");
+        return -1;
+    }
+
+    // only a stale socket is replaced, never a live one or another file
+    struct stat st = {0};
+    if (lstat(path, &st) == 0) {
+        int served = S_ISSOCK(st.st_mode) ? is_served(&addr) : -1;
+        if (served == 1) {
+            set_last_error("%s is served by another process", path);
+            return -1;
+        } else if (served == -1) {
+            if (!S_ISSOCK(st.st_mode)) {
+                set_last_error("%s exists and isn't a socket", path);
+            }
+            return -1;
+        }
+        unlink(path);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        set_last_error("socket failed: %s", strerror(errno));
+        return -1;
+    }
+
+    // connecting needs write access, left to the umask like any file
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+        set_last_error("failed to bind %s: %s", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    if (listen(fd, 64) == -1) {
+        set_last_error("listen failed: %s", strerror(errno));
+        unlink(path);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
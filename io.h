@@ -5,15 +5,17 @@
 #ifndef SVC_IO_H
 #define SVC_IO_H
 
+#include "arena.h"
 #include "arr.h"
 
 /**
- * Returns the list of present directories inside the given path, the list and
- * its elements must be freed upon usage with `arr_free_free(list, free)`.
+ * Returns the sorted list of present directories, or links, inside the given
+ * path, dot entries excluded. The names are allocated in a, the list must be
+ * freed upon usage with `arr_free(list)` and the names with `arena_free(a)`.
  *
  * Returns NULL on error and set last_error.
  */
-arr_of(char *) io_list_dirs(char const *path);
+arr_of(char *) io_list_dirs(char const *path, arena *a);
 
 /**
  * Returns 1 if the given path exists, otherwise 0.
@@ -50,4 +52,21 @@ int io_readat(int fd, char const *path, char *buf, size_t buf_len);
  */
 int io_writeat(int fd, char const *path, char *buf, size_t buf_len);
 
+/**
+ * Write the whole buf to fd, retrying on short writes and interruptions.
+ *
+ * Returns -1 on error and set last_error.
+ */
+int io_write_all(int fd, char const *buf, size_t buf_len);
+
+/**
+ * Listen on a Unix stream socket bound to path, replacing a stale socket left
+ * behind but refusing one another process still serves. The socket gets the
+ * mode the umask leaves, only the users allowed to write it can connect.
+ * Returns the listening fd.
+ *
+ * Returns -1 on error and set last_error.
+ */
+int io_listen(char const *path);
+
 #endif
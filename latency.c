@@ -0,0 +1,328 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#include "latency.h"
+#include "err.h"
+#include "io.h"
+#include "slotfile.h"
+#include "tai.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LAT_MAGIC "svclat01"
+
+// services kept, a power of 2 like LAT_SAMPLES
+#define LAT_SLOTS 16384
+
+// statuses a control can be waited for, SVC_RUNNING and SVC_STOPPED
+#define LAT_KINDS 2
+
+// the histogram counts the samples below each bound, in microseconds, and
+// past the last one
+#define LAT_BUCKETS 14
+
+static uint32_t const bounds[LAT_BUCKETS - 1] = {
+    1000,   2000,   5000,    10000,   20000,   50000,   100000,
+    200000, 500000, 1000000, 2000000, 5000000, 10000000,
+};
+
+typedef struct {
+    /**
+     * Hash of the service, 0 for a free slot.
+     */
+    uint64_t key;
+
+    /**
+     * Status + 1 of a control written but not seen taking effect yet, 0 for
+     * none, with when it was written and the change time of the service
+     * before it.
+     */
+    uint8_t pending;
+    uint8_t pad[3];
+    unsigned char written[TAI_PACK_LEN];
+    unsigned char before[TAI_PACK_LEN];
+
+    /**
+     * Samples ever recorded per status, the next one goes to count %
+     * LAT_SAMPLES, in microseconds.
+     */
+    uint32_t count[LAT_KINDS];
+    uint32_t usec[LAT_KINDS][LAT_SAMPLES];
+} lat_slot;
+
+static slotfile_layout const layout = {
+    .magic     = LAT_MAGIC,
+    .what      = "latencies",
+    .slots     = LAT_SLOTS,
+    .slot_size = sizeof(lat_slot),
+    .param     = LAT_SAMPLES,
+};
+
+struct lat {
+    slotfile file;
+};
+
+lat *
+lat_open(cfg const *config)
+{
+    char path[4096]  = {0};
+    char const *file = config->latency;
+    if (file == NULL) {
+        if (io_snprintf(path,
+                        sizeof(path),
+                        "%s/.svc.latency",
+                        config->svdir) == -1) {
+            wrap_last_error("io_snprintf failed");
+            return NULL;
+        }
+        file = path;
+    }
+
+    lat *l = calloc(1, sizeof(*l));
+    if (l == NULL) {
+        set_last_error("calloc failed: %s", strerror(errno));
+        return NULL;
+    }
+
+    if (slotfile_open(&l->file, file, &layout, 1) == -1) {
+        free(l);
+        return NULL;
+    }
+
+    return l;
+}
+
+void
+lat_close(lat *l)
+{
+    if (l == NULL) {
+        return;
+    }
+
+    slotfile_close(&l->file);
+    free(l);
+}
+
+/**
+ * Returns the slot of the service name, taking a free one when add is 1.
+ * Returns NULL if there's none.
+ */
+static lat_slot *
+find(lat *l, char const *name, int add)
+{
+    int fresh = 0;
+    return slotfile_find(&l->file, slotfile_key(NULL, name), add, &fresh);
+}
+
+static double
+diff(struct timespec const *a, struct timespec const *b)
+{
+    return (double)(a->tv_sec - b->tv_sec) +
+           (double)(a->tv_nsec - b->tv_nsec) / 1e9;
+}
+
+/**
+ * Sample a control that took seconds to get the service of sl to status,
+ * unless it's out of the range kept.
+ */
+static void
+add(lat_slot *sl, svc_status status, double seconds)
+{
+    if (status >= LAT_KINDS || !(seconds >= 0) || seconds > LAT_MAX) {
+        return;
+    }
+
+    uint32_t n                              = sl->count[status]++;
+    sl->usec[status][n & (LAT_SAMPLES - 1)] = (uint32_t)(seconds * 1e6);
+}
+
+/**
+ * Sample the control pending on sl if the service, now in status since the
+ * given time, got there. A service that moved to another status is dropped.
+ */
+static void
+resolve(lat_slot *sl, svc_status status, struct timespec const *since)
+{
+    if (sl->pending == 0) {
+        return;
+    }
+
+    struct timespec written = {0};
+    struct timespec before  = {0};
+    tai_unpack(sl->written, &written);
+    tai_unpack(sl->before, &before);
+    if (since->tv_sec == before.tv_sec && since->tv_nsec == before.tv_nsec) {
+        // not taken effect yet
+        return;
+    }
+
+    svc_status want = sl->pending - 1;
+    sl->pending     = 0;
+    if (status == want) {
+        add(sl, want, diff(since, &written));
+    }
+}
+
+int
+lat_record(lat *l, waiter const *ws, size_t n)
+{
+    if (!l->file.writable) {
+        return 0;
+    }
+
+    if (slotfile_lock(&l->file) == -1) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        waiter const *w = &ws[i];
+        lat_slot *sl    = NULL;
+        if (w->status >= LAT_KINDS ||
+            (sl = find(l, w->name, 1)) == NULL) {
+            continue;
+        }
+
+        resolve(sl, w->was, &w->before);
+        if (w->reached) {
+            add(sl, w->status, w->latency);
+            continue;
+        }
+
+        sl->pending = w->status + 1;
+        tai_pack(&w->written, sl->written);
+        tai_pack(&w->before, sl->before);
+    }
+
+    slotfile_unlock(&l->file);
+    return 0;
+}
+
+int
+lat_save(cfg const *config, waiter const *ws, size_t n)
+{
+    lat *l = lat_open(config);
+    if (l == NULL) {
+        return -1;
+    }
+
+    int r = lat_record(l, ws, n);
+    lat_close(l);
+    return r;
+}
+
+static int
+cmp_usec(void const *x, void const *y)
+{
+    uint32_t a = *(uint32_t const *)x;
+    uint32_t b = *(uint32_t const *)y;
+    return (a > b) - (a < b);
+}
+
+/**
+ * Format the latency usec into buf, of at least 16 bytes.
+ */
+static void
+format_usec(uint32_t usec, char *buf)
+{
+    if (usec < 1000) {
+        snprintf(buf, 16, "%uus", usec);
+    } else if (usec < 1000000) {
+        snprintf(buf, 16, "%.1fms", usec / 1e3);
+    } else {
+        snprintf(buf, 16, "%.2fs", usec / 1e6);
+    }
+}
+
+/**
+ * Print the row of the service name for the samples of sl reaching status.
+ */
+static void
+print_row(FILE *f, int width, char const *name, lat_slot const *sl, int st)
+{
+    static char const ramp[] = "_.:-=+*#%@";
+
+    uint32_t k = sl->count[st] < LAT_SAMPLES ? sl->count[st] : LAT_SAMPLES;
+    uint32_t sorted[LAT_SAMPLES];
+    memcpy(sorted, sl->usec[st], sizeof(*sorted) * k);
+    qsort(sorted, k, sizeof(*sorted), cmp_usec);
+
+    fprintf(f, "%-*s  %-9s  %3u", width, name, svc_status_str(st), k);
+    static int const ps[] = {50, 90, 99};
+    for (size_t i = 0; i < sizeof(ps) / sizeof(*ps); ++i) {
+        // nearest rank
+        char p[16] = {0};
+        format_usec(sorted[(ps[i] * k + 99) / 100 - 1], p);
+        fprintf(f, "  %8s", p);
+    }
+
+    uint32_t buckets[LAT_BUCKETS] = {0};
+    uint32_t most                 = 0;
+    for (uint32_t i = 0, b = 0; i < k; ++i) {
+        while (b < LAT_BUCKETS - 1 && sorted[i] >= bounds[b]) {
+            ++b;
+        }
+        most = ++buckets[b] > most ? buckets[b] : most;
+    }
+
+    fputs("  ", f);
+    for (size_t b = 0; b < LAT_BUCKETS; ++b) {
+        // a bucket holding any sample never shows as empty
+        size_t c = (buckets[b] * (sizeof(ramp) - 2) + most - 1) / most;
+        fputc(ramp[c], f);
+    }
+    fputc('\n', f);
+}
+
+int
+lat_print(lat *l, FILE *f, svc *const *list, size_t n)
+{
+    int width = 4;
+    for (size_t i = 0; i < n; ++i) {
+        int len = strlen(list[i]->name);
+        width   = len > width ? len : width;
+    }
+
+    if (slotfile_lock(&l->file) == -1) {
+        return -1;
+    }
+
+    fprintf(f,
+            "%-*s  %-9s  %3s  %8s  %8s  %8s  %s\n",
+            width,
+            "NAME",
+            "TO",
+            "N",
+            "P50",
+            "P90",
+            "P99",
+            "<1ms      >10s");
+    for (int i = 0; i < width; ++i) {
+        fputc('-', f);
+    }
+    fputs("  ---------  ---  --------  --------  --------  --------------\n",
+          f);
+
+    for (size_t i = 0; i < n; ++i) {
+        svc const *s = list[i];
+        lat_slot *sl = find(l, s->name, 0);
+        if (sl == NULL) {
+            continue;
+        }
+
+        if (l->file.writable) {
+            resolve(sl, s->status, &s->since);
+        }
+        for (int st = 0; st < LAT_KINDS; ++st) {
+            if (sl->count[st] > 0) {
+                print_row(f, width, s->name, sl, st);
+            }
+        }
+    }
+
+    slotfile_unlock(&l->file);
+    return 0;
+}
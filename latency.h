@@ -0,0 +1,71 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#ifndef SVC_LATENCY_H
+#define SVC_LATENCY_H
+
+#include "config.h"
+#include "service.h"
+#include "waiter.h"
+#include <stdio.h>
+
+/**
+ * Samples kept per service and status reached, the oldest are overwritten.
+ */
+#define LAT_SAMPLES 128
+
+/**
+ * A control not seen taking effect within LAT_MAX seconds isn't sampled, the
+ * service likely got there through something else.
+ */
+#define LAT_MAX 60
+
+/**
+ * The latencies of the controls written with --timing, from the write to the
+ * change time runsv put in supervise/status once the service got to its new
+ * status, kept in a file mapped in memory and shared by every svc process.
+ */
+typedef struct lat lat;
+
+/**
+ * Open the latencies of config, created when missing. When they can't be
+ * written they're opened read-only, nothing is then recorded. The latencies
+ * must be closed upon usage with lat_close().
+ *
+ * Returns NULL on error and set last_error.
+ */
+lat *lat_open(cfg const *config);
+
+/**
+ * Close latencies returned by lat_open(), NULL is ignored.
+ */
+void lat_close(lat *l);
+
+/**
+ * Record the n waiters of ws, whose control was written: the ones that
+ * reached their status are sampled, the others are left pending until a svc
+ * reading their service sees it there. A control pending from before is
+ * resolved first against the status the waiter found.
+ *
+ * Returns -1 on error and set last_error.
+ */
+int lat_record(lat *l, waiter const *ws, size_t n);
+
+/**
+ * Like lat_record() on the latencies of config, opened and closed around it.
+ *
+ * Returns -1 on error and set last_error.
+ */
+int lat_save(cfg const *config, waiter const *ws, size_t n);
+
+/**
+ * Print to f the p50, p90 and p99 latencies of the n services of list, whose
+ * status was read, with a histogram of their samples. Their pending controls
+ * are resolved first.
+ *
+ * Returns -1 on error and set last_error.
+ */
+int lat_print(lat *l, FILE *f, svc *const *list, size_t n);
+
+#endif
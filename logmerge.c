@@ -0,0 +1,527 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#include "logmerge.h"
+#include "arena.h"
+#include "arr.h"
+#include "buf.h"
+#include "err.h"
+#include "io.h"
+#include "svlog.h"
+#include "tai.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// a line longer than this is cut, svlogd's own limit is 1000 by default
+#define MERGE_BUF (64 * 1024)
+
+// the output is written once it holds this much
+#define MERGE_OUT (64 * 1024)
+
+// new lines and rotations wake the merge up, it then looks at every log
+#define MERGE_MASK (IN_MODIFY | IN_CREATE | IN_MOVED_TO)
+
+static volatile sig_atomic_t stopped;
+
+static void
+on_signal(int sig)
+{
+    (void)sig;
+    stopped = 1;
+}
+
+typedef struct {
+    char const *name;
+    char dir[PATH_MAX];
+    int wd;
+
+    /**
+     * The logs of the service oldest first, current last, and the index of
+     * the next one to read. fd is the one read, -1 while there's none.
+     */
+    arena a;
+    arr_of(char *) files;
+    size_t next;
+    int fd;
+
+    /**
+     * The bytes read and not merged yet are between start and end.
+     */
+    char *buf;
+    size_t start;
+    size_t end;
+
+    /**
+     * The line at start, its length without and with its newline, and the
+     * length of its stamp, -1 without one. ts is the time of the last stamp
+     * seen, the lines without one keep the place of the line before them.
+     */
+    size_t len;
+    size_t skip;
+    int stamp;
+    struct timespec ts;
+} merge_src;
+
+typedef struct {
+    merge_src *srcs;
+    size_t n;
+    int follow;
+    int width;
+
+    /**
+     * Indexes in srcs of the sources with a line, the oldest first.
+     */
+    size_t *heap;
+    size_t heap_len;
+
+    buf out;
+
+    tai_local local;
+} merge;
+
+/**
+ * Returns 1 if the line of the source a is to be printed before the line of
+ * b, in time order and then in the order the services were given.
+ */
+static int
+before(merge const *m, size_t a, size_t b)
+{
+    struct timespec const *x = &m->srcs[a].ts;
+    struct timespec const *y = &m->srcs[b].ts;
+    if (x->tv_sec != y->tv_sec) {
+        return x->tv_sec < y->tv_sec;
+    } else if (x->tv_nsec != y->tv_nsec) {
+        return x->tv_nsec < y->tv_nsec;
+    }
+
+    return a < b;
+}
+
+static void
+sift_down(merge *m, size_t i)
+{
+    for (;;) {
+        size_t min = i;
+        size_t l   = 2 * i + 1;
+        size_t r   = l + 1;
+        if (l < m->heap_len && before(m, m->heap[l], m->heap[min])) {
+            min = l;
+        }
+        if (r < m->heap_len && before(m, m->heap[r], m->heap[min])) {
+            min = r;
+        }
+        if (min == i) {
+            return;
+        }
+
+        size_t t     = m->heap[i];
+        m->heap[i]   = m->heap[min];
+        m->heap[min] = t;
+        i            = min;
+    }
+}
+
+static void
+push(merge *m, size_t src)
+{
+    size_t i   = m->heap_len++;
+    m->heap[i] = src;
+    while (i > 0 && before(m, m->heap[i], m->heap[(i - 1) / 2])) {
+        size_t p   = (i - 1) / 2;
+        size_t t   = m->heap[i];
+        m->heap[i] = m->heap[p];
+        m->heap[p] = t;
+        i          = p;
+    }
+}
+
+/**
+ * Open the log name of s in place of the one it reads.
+ *
+ * Returns -1 on error and set last_error, errno is then ENOENT when the log
+ * is gone.
+ */
+static int
+open_log(merge_src *s, char const *name)
+{
+    char path[PATH_MAX + NAME_MAX + 1] = {0};
+    if (io_snprintf(path, sizeof(path), "%s/%s", s->dir, name) == -1) {
+        wrap_last_error("io_snprintf failed");
+        return -1;
+    }
+
+    if (s->fd != -1) {
+        close(s->fd);
+    }
+    s->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (s->fd == -1) {
+        int e = errno;
+        set_last_error("failed to open '%s': %s", path, strerror(errno));
+        errno = e;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Returns 1 if the current log of s isn't the file s reads anymore.
+ */
+static int
+rotated(merge_src const *s)
+{
+    char path[PATH_MAX + sizeof(SVLOG_CURRENT)] = {0};
+    struct stat cur                             = {0};
+    struct stat st                              = {0};
+    if (s->fd == -1 ||
+        io_snprintf(path, sizeof(path), "%s/" SVLOG_CURRENT, s->dir) == -1 ||
+        stat(path, &cur) == -1 || fstat(s->fd, &st) == -1) {
+        clear_last_error();
+        return 1;
+    }
+
+    return cur.st_ino != st.st_ino || cur.st_dev != st.st_dev;
+}
+
+/**
+ * Move s to its next log once the one it reads is read to its end: the next
+ * one of its list, then the new current one when following.
+ *
+ * Returns 1 if s moved to another log, 0 if there's none, -1 on error and
+ * set last_error.
+ */
+static int
+next_log(merge const *m, merge_src *s)
+{
+    while (s->next < arr_len(s->files)) {
+        if (open_log(s, s->files[s->next++]) == 0) {
+            return 1;
+        } else if (errno != ENOENT) {
+            return -1;
+        }
+        // removed by svlogd since the listing
+        clear_last_error();
+    }
+
+    if (!m->follow || !rotated(s)) {
+        return 0;
+    } else if (open_log(s, SVLOG_CURRENT) == 0) {
+        return 1;
+    } else if (errno != ENOENT) {
+        return -1;
+    }
+
+    // renamed and not created again yet
+    clear_last_error();
+    return 0;
+}
+
+/**
+ * Read more of the log of s into its buffer.
+ *
+ * Returns the bytes read, 0 at the end of the log, -1 on error and set
+ * last_error.
+ */
+static ssize_t
+fill(merge_src *s)
+{
+    if (s->fd == -1) {
+        return 0;
+    }
+
+    if (s->start > 0) {
+        memmove(s->buf, s->buf + s->start, s->end - s->start);
+        s->end -= s->start;
+        s->start = 0;
+    }
+
+    ssize_t r = -1;
+    while ((r = read(s->fd, s->buf + s->end, MERGE_BUF - s->end)) == -1 &&
+           errno == EINTR) {
+    }
+    if (r == -1) {
+        set_last_error(
+            "failed to read the log of %s: %s", s->name, strerror(errno));
+        return -1;
+    }
+
+    s->end += r;
+    return r;
+}
+
+/**
+ * Make the line of len bytes at the start of s the line of s, has_nl when a
+ * newline follows it.
+ */
+static void
+head(merge_src *s, size_t len, int has_nl)
+{
+    s->len   = len;
+    s->skip  = len + has_nl;
+    s->stamp = svlog_stamp(s->buf + s->start, len, &s->ts);
+}
+
+/**
+ * Read the next line of s, from its next logs when needed.
+ *
+ * Returns 1 if s has a line, 0 if its logs hold no more for now, -1 on
+ * error and set last_error.
+ */
+static int
+advance(merge const *m, merge_src *s)
+{
+    for (;;) {
+        char *p    = s->buf + s->start;
+        size_t len = s->end - s->start;
+        char *nl   = memchr(p, '\n', len);
+        if (nl != NULL || len == MERGE_BUF) {
+            head(s, nl != NULL ? (size_t)(nl - p) : len, nl != NULL);
+            return 1;
+        }
+
+        ssize_t r = fill(s);
+        if (r == -1) {
+            return -1;
+        } else if (r > 0) {
+            continue;
+        }
+
+        int moved = next_log(m, s);
+        if (moved == -1) {
+            return -1;
+        } else if (len > 0 && (moved || !m->follow)) {
+            // the last line of a log without its newline, while following
+            // it may still be written
+            head(s, len, 0);
+            return 1;
+        } else if (!moved) {
+            return 0;
+        }
+    }
+}
+
+/**
+ * Write the output of m to stdout.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+flush(merge *m)
+{
+    if (m->out.len > 0 &&
+        io_write_all(STDOUT_FILENO, m->out.data, m->out.len) == -1) {
+        wrap_last_error("failed to print the logs");
+        return -1;
+    }
+
+    m->out.len = 0;
+    return 0;
+}
+
+/**
+ * Append the line of s to the output of m.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+print(merge *m, merge_src *s)
+{
+    char const *line = s->buf + s->start;
+    size_t len       = s->len;
+    size_t name_len  = strlen(s->name);
+    size_t prefix    = TAI_LOCAL_LEN + 2 + m->width + 2;
+    if (buf_reserve(&m->out, prefix + len + 1) == -1) {
+        set_last_error("failed to keep a line: %s", strerror(errno));
+        return -1;
+    }
+
+    // written by hand, printf would cost more than the merge
+    char *o = m->out.data + m->out.len;
+    memset(o, ' ', prefix);
+    memcpy(o + TAI_LOCAL_LEN + 2, s->name, name_len);
+    if (s->stamp != -1) {
+        tai_local_format(&m->local, &s->ts, o);
+
+        // the stamp is replaced, so is the space after it
+        line += s->stamp;
+        len -= s->stamp;
+        if (len > 0 && *line == ' ') {
+            ++line;
+            --len;
+        }
+    }
+
+    memcpy(o + prefix, line, len);
+    o[prefix + len] = '\n';
+    m->out.len += prefix + len + 1;
+    return m->out.len >= MERGE_OUT ? flush(m) : 0;
+}
+
+/**
+ * Print every line the logs of m hold for now in time order.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+merge_lines(merge *m)
+{
+    m->heap_len = 0;
+    for (size_t i = 0; i < m->n; ++i) {
+        int r = m->srcs[i].buf != NULL ? advance(m, &m->srcs[i]) : 0;
+        if (r == -1) {
+            return -1;
+        } else if (r == 1) {
+            push(m, i);
+        }
+    }
+
+    while (m->heap_len > 0) {
+        merge_src *s = &m->srcs[m->heap[0]];
+        if (print(m, s) == -1) {
+            return -1;
+        }
+        s->start += s->skip;
+
+        int r = advance(m, s);
+        if (r == -1) {
+            return -1;
+        } else if (r == 0) {
+            m->heap[0] = m->heap[--m->heap_len];
+        }
+        sift_down(m, 0);
+    }
+
+    return flush(m);
+}
+
+/**
+ * Merge the lines added to the logs of m as they come, until stopped.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+follow(merge *m, int ifd)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    while (!stopped) {
+        // no SA_RESTART, a signal interrupts the read
+        ssize_t len = read(ifd, buf, sizeof(buf));
+        if (len == -1 && errno == EINTR) {
+            continue;
+        } else if (len == -1) {
+            set_last_error("failed to read inotify: %s", strerror(errno));
+            return -1;
+        }
+
+        // which log changed doesn't matter, the ones without news cost a
+        // read, an overflow loses nothing
+        if (merge_lines(m) == -1) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Set s up to read the logs of its service, which may have none.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+open_src(cfg const *config, merge_src *s, int ifd, size_t n)
+{
+    if (svlog_dir(config, s->name, s->dir, sizeof(s->dir)) == -1) {
+        // the services matched by a pattern may not all have a log
+        if (errno != ENOENT || n == 1) {
+            return -1;
+        }
+        print_last_error("skipped %s", s->name);
+        return 0;
+    }
+
+    // watch first, a rotation meanwhile is then seen rather than lost
+    if (ifd != -1 &&
+        (s->wd = inotify_add_watch(ifd, s->dir, MERGE_MASK)) == -1) {
+        set_last_error("cannot watch %s: %s", s->dir, strerror(errno));
+        return -1;
+    }
+
+    s->files = svlog_files(s->dir, &s->a);
+    s->buf   = malloc(MERGE_BUF);
+    if (s->files == NULL) {
+        return -1;
+    } else if (s->buf == NULL) {
+        set_last_error("malloc failed: %s", strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+int
+logmerge_run(cfg const *config, char *const *names, size_t n)
+{
+    struct sigaction sa = {.sa_handler = on_signal};
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    int r   = -1;
+    int ifd = -1;
+    merge m = {.n = n, .follow = config->follow};
+    m.srcs  = calloc(n + 1, sizeof(*m.srcs));
+    m.heap  = calloc(n + 1, sizeof(*m.heap));
+    if (m.srcs == NULL || m.heap == NULL) {
+        set_last_error("calloc failed: %s", strerror(errno));
+        goto end;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        m.srcs[i] = (merge_src){.name = names[i], .fd = -1, .wd = -1};
+        int l     = strlen(names[i]);
+        m.width   = l > m.width ? l : m.width;
+    }
+
+    if (config->follow && (ifd = inotify_init1(IN_CLOEXEC)) == -1) {
+        set_last_error("inotify_init1 failed: %s", strerror(errno));
+        goto end;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        if (open_src(config, &m.srcs[i], ifd, n) == -1) {
+            goto end;
+        }
+    }
+
+    if (merge_lines(&m) == -1) {
+        goto end;
+    }
+    r = ifd != -1 ? follow(&m, ifd) : 0;
+
+end:
+    for (size_t i = 0; m.srcs != NULL && i < n; ++i) {
+        merge_src *s = &m.srcs[i];
+        if (s->fd != -1) {
+            close(s->fd);
+        }
+        arr_free((arr_ptr)s->files);
+        arena_free(&s->a);
+        free(s->buf);
+    }
+    if (ifd != -1) {
+        close(ifd);
+    }
+    buf_free(&m.out);
+    free(m.heap);
+    free(m.srcs);
+    return r;
+}
@@ -0,0 +1,23 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#ifndef SVC_LOGMERGE_H
+#define SVC_LOGMERGE_H
+
+#include "config.h"
+#include <stddef.h>
+
+/**
+ * Print the logs of the n services of names as one stream in time order,
+ * the rotated logs first, each line with its stamp in local time and its
+ * service. Then the new lines until SIGINT or SIGTERM when config->follow is
+ * 1, rotations included. Each service is read through a fixed size buffer,
+ * whatever the size of its logs. Among several services, the ones without a
+ * log are skipped.
+ *
+ * Returns -1 on error and set last_error.
+ */
+int logmerge_run(cfg const *config, char *const *names, size_t n);
+
+#endif
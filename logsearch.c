@@ -0,0 +1,494 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#include "logsearch.h"
+#include "buf.h"
+#include "err.h"
+#include "io.h"
+#include "pool.h"
+#include "svlog.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// below this many bytes the binary search reads the lines one by one
+#define SEEK_LINEAR 4096
+
+// lines found a file holds before printing them, once the files before it
+// are done, so that memory doesn't grow with the result
+#define LOGSEARCH_FLUSH (1024 * 1024)
+
+// bytes from the most to the least common in logs, the bytes missing are
+// rarer than all of them
+static char const common[] =
+    "0123456789 etaoinsrlcdhumpfgybwvk.:-_@/=,xjqz"
+    "ETAOINSRLCDHUMPFGYBWVKXJQZ\"'()[]<>";
+
+typedef struct {
+    char const *service;
+    char path[PATH_MAX];
+
+    /**
+     * The lines found and not printed yet.
+     */
+    buf out;
+    size_t found;
+} search_file;
+
+typedef struct {
+    cfg const *config;
+    char const *pattern;
+    size_t len;
+
+    /**
+     * Index in pattern of its rarest byte, the one looked for first.
+     */
+    size_t rare;
+
+    search_file *files;
+    size_t files_len;
+    size_t files_cap;
+
+    /**
+     * The lines are printed in the order of files: a file is marked done
+     * once searched, and every done file from next on is printed under lock.
+     * A file holding LOGSEARCH_FLUSH bytes waits on turn to be the next.
+     */
+    pthread_mutex_t lock;
+    pthread_cond_t turn;
+    char *done;
+    size_t next;
+
+    /**
+     * Set with the first error, the files waiting for their turn give up.
+     */
+    int failed;
+    char err[512];
+} search;
+
+static int
+cmp_time(struct timespec const *a, struct timespec const *b)
+{
+    if (a->tv_sec != b->tv_sec) {
+        return (a->tv_sec > b->tv_sec) - (a->tv_sec < b->tv_sec);
+    }
+
+    return (a->tv_nsec > b->tv_nsec) - (a->tv_nsec < b->tv_nsec);
+}
+
+static int
+is_set(struct timespec const *t)
+{
+    return t->tv_sec != 0 || t->tv_nsec != 0;
+}
+
+/**
+ * Returns the index in pattern of len bytes of its rarest byte.
+ */
+static size_t
+rarest(char const *pattern, size_t len)
+{
+    size_t best    = 0;
+    size_t best_at = 0;
+    for (size_t i = 0; i < len; ++i) {
+        char const *c = pattern[i] != '\0' ? strchr(common, pattern[i]) : NULL;
+        size_t rank   = c != NULL ? (size_t)(c - common) : sizeof(common);
+        if (rank > best) {
+            best    = rank;
+            best_at = i;
+        }
+    }
+
+    return best_at;
+}
+
+/**
+ * Returns the first occurrence of the pattern of s between p and end, or
+ * NULL. The rarest byte of the pattern is looked for with memchr(), which
+ * the libc vectorizes, and the pattern only compared where it's found.
+ */
+static char const *
+find(search const *s, char const *p, char const *end)
+{
+    while ((size_t)(end - p) >= s->len) {
+        char const *c =
+            memchr(p + s->rare, s->pattern[s->rare], end - p - s->len + 1);
+        if (c == NULL) {
+            return NULL;
+        }
+
+        char const *at = c - s->rare;
+        if (memcmp(at, s->pattern, s->len) == 0) {
+            return at;
+        }
+        p = at + 1;
+    }
+
+    return NULL;
+}
+
+/**
+ * Returns the offset of the line following the one holding the offset at of
+ * p, or hi when it's the last one before hi.
+ */
+static size_t
+next_line(char const *p, size_t at, size_t hi)
+{
+    char const *nl = memchr(p + at, '\n', hi - at);
+    return nl != NULL ? (size_t)(nl - p) + 1 : hi;
+}
+
+/**
+ * Returns the offset of the first line of the size bytes at p stamped at t
+ * or later, size if there's none. The lines are in time order, the ones
+ * without a stamp are skipped.
+ */
+static size_t
+seek(char const *p, size_t size, struct timespec const *t)
+{
+    // the lines before lo are older than t, the ones from hi aren't
+    size_t lo = 0;
+    size_t hi = size;
+    while (hi - lo > SEEK_LINEAR) {
+        size_t s           = next_line(p, lo + (hi - lo) / 2, hi);
+        struct timespec ts = {0};
+        while (s < hi && svlog_stamp(p + s, hi - s, &ts) == -1) {
+            s = next_line(p, s, hi);
+        }
+
+        if (s >= hi) {
+            break;
+        } else if (cmp_time(&ts, t) < 0) {
+            lo = next_line(p, s, hi);
+        } else {
+            hi = s;
+        }
+    }
+
+    for (size_t s = lo; s < hi; s = next_line(p, s, hi)) {
+        struct timespec ts = {0};
+        if (svlog_stamp(p + s, hi - s, &ts) != -1 &&
+            cmp_time(&ts, t) >= 0) {
+            return s;
+        }
+    }
+
+    return hi;
+}
+
+/**
+ * Print the lines held by f.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+print(search_file *f)
+{
+    if (io_write_all(STDOUT_FILENO, f->out.data, f->out.len) == -1) {
+        wrap_last_error("failed to print the lines found");
+        return -1;
+    }
+
+    f->out.len = 0;
+    return 0;
+}
+
+/**
+ * Print the done files following s->next, to be called under lock.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+emit_ready(search *s)
+{
+    for (; s->next < s->files_len && s->done[s->next]; ++s->next) {
+        search_file *f = &s->files[s->next];
+        if (print(f) == -1) {
+            return -1;
+        }
+        buf_free(&f->out);
+    }
+
+    return 0;
+}
+
+/**
+ * Print the lines held by the file i of s once the files before it are done.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+flush(search *s, size_t i)
+{
+    pthread_mutex_lock(&s->lock);
+    while (s->next != i && !s->failed) {
+        pthread_cond_wait(&s->turn, &s->lock);
+    }
+    int failed = s->failed;
+    pthread_mutex_unlock(&s->lock);
+
+    if (failed) {
+        set_last_error("stopped by an earlier error");
+        return -1;
+    }
+
+    // only the file i itself prints it until it's done
+    return print(&s->files[i]);
+}
+
+/**
+ * Append to the file i of s every line between p and end holding the
+ * pattern, p starts a line.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+scan(search *s, size_t i, char const *p, char const *end)
+{
+    search_file *f     = &s->files[i];
+    size_t service_len = strlen(f->service);
+
+    char const *at = NULL;
+    while ((at = find(s, p, end)) != NULL) {
+        char const *start = memrchr(p, '\n', at - p);
+        char const *stop  = memchr(at + s->len, '\n', end - at - s->len);
+        start             = start != NULL ? start + 1 : p;
+        stop              = stop != NULL ? stop : end;
+
+        if (buf_reserve(&f->out, service_len + 3 + (stop - start)) == -1) {
+            set_last_error("failed to keep a line: %s", strerror(errno));
+            return -1;
+        }
+        buf_append(&f->out, f->service, service_len);
+        buf_append(&f->out, ": ", 2);
+        buf_append(&f->out, start, stop - start);
+        buf_append(&f->out, "\n", 1);
+        ++f->found;
+
+        if (f->out.len >= LOGSEARCH_FLUSH && flush(s, i) == -1) {
+            return -1;
+        }
+
+        p = stop < end ? stop + 1 : end;
+    }
+
+    return 0;
+}
+
+/**
+ * Search the file i of s.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+search_file_at(search *s, size_t i)
+{
+    search_file *f = &s->files[i];
+
+    int fd = open(f->path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1 && errno == ENOENT) {
+        // removed by svlogd since the listing
+        return 0;
+    } else if (fd == -1) {
+        set_last_error("failed to open '%s': %s", f->path, strerror(errno));
+        return -1;
+    }
+
+    int r          = -1;
+    struct stat st = {0};
+    char *p        = MAP_FAILED;
+    if (fstat(fd, &st) == -1) {
+        set_last_error("failed to stat '%s': %s", f->path, strerror(errno));
+        goto end;
+    } else if (st.st_size == 0) {
+        r = 0;
+        goto end;
+    }
+
+    size_t size = st.st_size;
+    p           = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+        set_last_error("failed to map '%s': %s", f->path, strerror(errno));
+        goto end;
+    }
+
+    cfg const *c = s->config;
+    size_t b     = is_set(&c->since) ? seek(p, size, &c->since) : 0;
+    size_t e     = size;
+    if (is_set(&c->until)) {
+        // the first line after until
+        struct timespec after = c->until;
+        if (++after.tv_nsec == 1000000000) {
+            after.tv_nsec = 0;
+            ++after.tv_sec;
+        }
+        e = seek(p, size, &after);
+    }
+
+    if (b < e) {
+        // the range is read once, front to back
+        madvise(p + (b & ~4095UL), e - (b & ~4095UL), MADV_SEQUENTIAL);
+        r = scan(s, i, p + b, p + e);
+    } else {
+        r = 0;
+    }
+
+end:
+    if (p != MAP_FAILED) {
+        munmap(p, st.st_size);
+    }
+    close(fd);
+    return r;
+}
+
+static int
+search_one(void *ctx, size_t i)
+{
+    search *s = ctx;
+    int r     = search_file_at(s, i);
+
+    pthread_mutex_lock(&s->lock);
+    if (r == 0) {
+        s->done[i] = 1;
+        r          = emit_ready(s);
+    }
+    if (r == -1 && !s->failed) {
+        s->failed = 1;
+        snprintf(s->err, sizeof(s->err), "%s", get_last_error());
+    }
+    pthread_cond_broadcast(&s->turn);
+    pthread_mutex_unlock(&s->lock);
+    return r;
+}
+
+/**
+ * Add the logs of the dir of service that may hold lines between since and
+ * until to s.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+add_files(search *s, char const *service, char const *dir)
+{
+    arena a              = {0};
+    arr_of(char *) files = svlog_files(dir, &a);
+    if (files == NULL) {
+        arena_free(&a);
+        return -1;
+    }
+
+    cfg const *c         = s->config;
+    int r                = -1;
+    int has_prev         = 0;
+    struct timespec prev = {0};
+    for (size_t i = 0; i < arr_len(files); ++i) {
+        // a rotated log holds the lines written after the previous rotation
+        // and before its own
+        struct timespec t = {0};
+        int rotated       = svlog_file_time(files[i], &t) == 0;
+        int skip          = (rotated && is_set(&c->since) &&
+                    cmp_time(&t, &c->since) < 0) ||
+                   (has_prev && is_set(&c->until) &&
+                    cmp_time(&prev, &c->until) > 0);
+        has_prev = rotated;
+        prev     = t;
+        if (skip) {
+            continue;
+        }
+
+        if (s->files_len == s->files_cap) {
+            size_t cap      = s->files_cap == 0 ? 64 : s->files_cap * 2;
+            search_file *fs = realloc(s->files, sizeof(*fs) * cap);
+            if (fs == NULL) {
+                set_last_error("realloc failed: %s", strerror(errno));
+                goto end;
+            }
+            s->files     = fs;
+            s->files_cap = cap;
+        }
+
+        search_file *f = &s->files[s->files_len];
+        *f             = (search_file){.service = service};
+        if (io_snprintf(f->path, sizeof(f->path), "%s/%s", dir, files[i]) ==
+            -1) {
+            wrap_last_error("io_snprintf failed");
+            goto end;
+        }
+        ++s->files_len;
+    }
+    r = 0;
+
+end:
+    arr_free((arr_ptr)files);
+    arena_free(&a);
+    return r;
+}
+
+long
+logsearch_run(cfg const *config,
+              char const *pattern,
+              char *const *names,
+              size_t n)
+{
+    search s = {
+        .config  = config,
+        .pattern = pattern,
+        .len     = strlen(pattern),
+        .rare    = rarest(pattern, strlen(pattern)),
+        .lock    = PTHREAD_MUTEX_INITIALIZER,
+        .turn    = PTHREAD_COND_INITIALIZER,
+    };
+
+    long found = -1;
+    for (size_t i = 0; i < n; ++i) {
+        char dir[PATH_MAX] = {0};
+        if (svlog_dir(config, names[i], dir, sizeof(dir)) == -1) {
+            if (errno != ENOENT) {
+                goto end;
+            }
+            clear_last_error();
+            continue;
+        }
+
+        if (add_files(&s, names[i], dir) == -1) {
+            goto end;
+        }
+    }
+
+    if ((s.done = calloc(s.files_len + 1, sizeof(*s.done))) == NULL) {
+        set_last_error("calloc failed: %s", strerror(errno));
+        goto end;
+    }
+
+    long jobs = config->jobs > 0 ? config->jobs : pool_cpus();
+    if (s.len > 0 && pool_run(jobs, s.files_len, search_one, &s) == -1) {
+        // a file giving up for another may have failed first
+        if (s.err[0] != '\0') {
+            set_last_error("%s", s.err);
+        }
+        goto end;
+    }
+
+    found = 0;
+    for (size_t i = 0; i < s.files_len; ++i) {
+        found += s.files[i].found;
+    }
+
+end:
+    for (size_t i = 0; i < s.files_len; ++i) {
+        buf_free(&s.files[i].out);
+    }
+    free(s.files);
+    free(s.done);
+    pthread_mutex_destroy(&s.lock);
+    pthread_cond_destroy(&s.turn);
+    return found;
+}
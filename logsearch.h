@@ -0,0 +1,28 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#ifndef SVC_LOGSEARCH_H
+#define SVC_LOGSEARCH_H
+
+#include "config.h"
+#include <stddef.h>
+
+/**
+ * Print the lines holding the literal pattern among the logs of the n
+ * services of names, rotated ones included, each prefixed by its service.
+ * Only the lines stamped between config->since and config->until are read:
+ * the rotated logs out of that range are skipped by their name and the range
+ * is found in the others by a binary search on the stamps. Files are
+ * searched concurrently by config->jobs workers, every online CPU for 0, and
+ * printed in order, oldest first per service, as soon as the files before
+ * them were searched. Services without a log are skipped.
+ *
+ * Returns the number of lines found, returns -1 on error and set last_error.
+ */
+long logsearch_run(cfg const *config,
+                   char const *pattern,
+                   char *const *names,
+                   size_t n);
+
+#endif
@@ -5,26 +5,55 @@
 #include "availables.h"
 #include "config.h"
 #include "err.h"
+#include "history.h"
+#include "io.h"
+#include "latency.h"
+#include "logmerge.h"
+#include "logsearch.h"
+#include "metrics.h"
+#include "pool.h"
+#include "rolling.h"
 #include "service.h"
+#include "stats.h"
+#include "svcd.h"
+#include "svlog.h"
+#include "tai64n.h"
+#include "tail.h"
+#include "top.h"
+#include "view.h"
+#include "waiter.h"
+#include "watch.h"
 #include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fnmatch.h>
+#include <getopt.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
 
 #define UNUSED __attribute__((unused))
 
-#define IMPL_CONTROL_CMD(name, command, error, success)              \
-    static int cmd_##name(cfg *config, UNUSED int argc, char **argv) \
-    {                                                                \
-        if (svc_control(config, argv[2], command) < 0) {             \
-            print_last_error(error, argv[2]);                        \
-            return 1;                                                \
-        }                                                            \
-                                                                     \
-        printf(success "\n", argv[2]);                               \
-        return 0;                                                    \
+#define IMPL_CONTROL_CMD(name, command, error, success)                     \
+    static int cmd_##name(                                                  \
+        UNUSED cfg *config, svc_handle *h, UNUSED int argc, char **argv)    \
+    {                                                                       \
+        if (svc_control(h, command) < 0) {                                  \
+            print_last_error(error, argv[2]);                               \
+            return 1;                                                       \
+        }                                                                   \
+                                                                            \
+        printf(success "\n", argv[2]);                                      \
+        return 0;                                                           \
     }
 
-typedef int (*cmd)(cfg *config, int argc, char **argv);
+/**
+ * A command, h is the handle of the service argv[2] when the command requires
+ * it to be linked, otherwise NULL.
+ */
+typedef int (*cmd)(cfg *config, svc_handle *h, int argc, char **argv);
 
 typedef enum {
     CMD_REQ_SVC              = 1 << 0,
@@ -38,33 +67,16 @@ typedef enum {
 } cmd_req;
 
 static int
-nofdigits(int n)
-{
-    int r = 1;
-
-    if (n >= 10000) {
-        r += 4;
-        n /= 10000;
-    }
-
-    if (n >= 100) {
-        r += 2;
-        n /= 100;
-    }
-
-    if (n >= 10) {
-        ++r;
-    }
-
-    return r;
-}
-
-static int
-cmd_list_availables(cfg *config, UNUSED int argc, UNUSED char **argv)
+cmd_list_availables(cfg *config,
+                    UNUSED svc_handle *h,
+                    UNUSED int argc,
+                    UNUSED char **argv)
 {
-    arr_of(char *) list = availables_get(config);
+    arena a             = {0};
+    arr_of(char *) list = availables_get(config, &a);
     if (list == NULL) {
         print_last_error("failed to get availables list");
+        arena_free(&a);
         return 1;
     }
 
@@ -72,7 +84,8 @@ cmd_list_availables(cfg *config, UNUSED int argc, UNUSED char **argv)
         printf("%s/%s\n", config->available, list[i]);
     }
 
-    arr_free_free((arr_ptr)list, free);
+    arr_free((arr_ptr)list);
+    arena_free(&a);
     return 0;
 }
 
@@ -81,20 +94,26 @@ IMPL_CONTROL_CMD(stop, 'd', "failed to stop %s", "stopped %s")
 IMPL_CONTROL_CMD(once, 'o', "failed to start once %s", "started once %s")
 
 static int
-cmd_restart(cfg *config, UNUSED int argc, char **argv)
+cmd_restart(cfg *config,
+            svc_handle *h,
+            int argc,
+            char **argv)
 {
-    int r = cmd_stop(config, argc, argv);
+    int r = cmd_stop(config, h, argc, argv);
     if (r == 0) {
-        r = cmd_start(config, argc, argv);
+        r = cmd_start(config, h, argc, argv);
     }
 
     return r;
 }
 
 static int
-cmd_down(cfg *config, UNUSED int argc, char **argv)
+cmd_down(UNUSED cfg *config,
+         svc_handle *h,
+         UNUSED int argc,
+         char **argv)
 {
-    if (svc_down(config, argv[2]) == -1) {
+    if (svc_down(h) == -1) {
         print_last_error("failed to down %s", argv[2]);
         return 1;
     }
@@ -104,9 +123,12 @@ cmd_down(cfg *config, UNUSED int argc, char **argv)
 }
 
 static int
-cmd_up(cfg *config, UNUSED int argc, char **argv)
+cmd_up(UNUSED cfg *config,
+       svc_handle *h,
+       UNUSED int argc,
+       char **argv)
 {
-    if (svc_up(config, argv[2]) == -1) {
+    if (svc_up(h) == -1) {
         print_last_error("failed to up %s", argv[2]);
         return 1;
     }
@@ -157,7 +179,10 @@ IMPL_CONTROL_CMD(sig_kill,
                  "sent KILL signal to %s")
 
 static int
-cmd_link(cfg *config, UNUSED int argc, char **argv)
+cmd_link(cfg *config,
+         UNUSED svc_handle *h,
+         UNUSED int argc,
+         char **argv)
 {
     if (svc_link(config, argv[2]) == -1) {
         print_last_error("failed to link %s", argv[2]);
@@ -169,7 +194,10 @@ cmd_link(cfg *config, UNUSED int argc, char **argv)
 }
 
 static int
-cmd_unlink(cfg *config, UNUSED int argc, char **argv)
+cmd_unlink(cfg *config,
+           UNUSED svc_handle *h,
+           UNUSED int argc,
+           char **argv)
 {
     if (svc_unlink(config, argv[2]) == -1) {
         print_last_error("failed to unlink %s", argv[2]);
@@ -180,95 +208,659 @@ cmd_unlink(cfg *config, UNUSED int argc, char **argv)
     return 0;
 }
 
+/**
+ * Returns 1 if the service i of list has a log, the log of a service comes
+ * right after it.
+ */
 static int
-cmd_view(cfg *config, UNUSED int argc, UNUSED char **argv)
+has_log(arr_of(svc *) list, size_t i)
 {
-    arr_of(svc *) list = svc_list(config);
-    if (list == NULL) {
-        print_last_error("failed to get services list");
+    char const *name = list[i]->name;
+    if (strchr(name, '/') != NULL) {
+        // a log, its service has one
         return 1;
+    } else if (i + 1 >= arr_len(list)) {
+        return 0;
     }
 
-    int widths[5] = {0, 0, 0, 4, 0};
-    char *cols[5] = {"PID", "NAME", "STATUS", "DOWN", "TIME"};
+    size_t l         = strlen(name);
+    char const *next = list[i + 1]->name;
+    return strncmp(next, name, l) == 0 && strcmp(next + l, "/log") == 0;
+}
+
+/**
+ * Keep in list only the services filter keeps, NULL to only match pattern,
+ * and matching pattern, NULL for any.
+ */
+static void
+filter_services(arr_of(svc *) list,
+                cfg_filter const *filter,
+                char const *pattern)
+{
+    size_t n = 0;
     for (size_t i = 0; i < arr_len(list); ++i) {
-        svc *service = list[i];
+        svc *s   = list[i];
+        int keep = filter == NULL ||
+                   svc_filter_match(filter, s, has_log(list, i));
+        if (keep && (pattern == NULL || fnmatch(pattern, s->name, 0) == 0)) {
+            list[n++] = s;
+        }
+    }
+    arr_len(list) = n;
+}
+
+/**
+ * Ask the daemon for the services filter keeps that match pattern, NULL for
+ * any, allocated in a into *list.
+ *
+ * Returns 1 if no daemon is running, -1 on error and set last_error.
+ */
+static int
+query_daemon(cfg *config,
+             cfg_filter const *filter,
+             char const *pattern,
+             arena *a,
+             arr_of(svc *) * list)
+{
+    // the daemon matches names only, a log filter looks at the logs the name
+    // may not match
+    double t = stats_clock();
+    int r    = svcd_query(
+        config, filter->log == -1 ? filter->pattern : NULL, a, list);
+    if (r == 0) {
+        stats_phase_end(STATS_DAEMON, t, arr_len(*list));
+        filter_services(*list, filter, pattern);
+    }
+
+    return r;
+}
+
+/**
+ * Fill the restarts of the services of list from the history, only read, a
+ * history that can't be opened leaves them unknown.
+ */
+static void
+observe_history(cfg *config, arr_of(svc *) list)
+{
+    hist *h = hist_open(config, 0);
+    if (h == NULL || hist_observe(h, list, arr_len(list)) == -1) {
+        clear_last_error();
+    }
+    hist_close(h);
+}
+
+/**
+ * Get the services matching pattern, NULL for all, and kept by the filter of
+ * config, from the daemon when one is running, otherwise by scanning them. The
+ * services are allocated in a and sorted as config asks.
+ *
+ * Returns NULL on error and set last_error.
+ */
+static arr_of(svc *) get_services(cfg *config, char const *pattern, arena *a)
+{
+    // pattern is pushed down with the filter unless both are given
+    cfg_filter filter = config->filter;
+    if (filter.pattern == NULL) {
+        filter.pattern = pattern;
+        pattern        = NULL;
+    }
+
+    // a daemon serves a single root
+    arr_of(svc *) list = NULL;
+    int r              = 1;
+    if (config->roots_len == 1) {
+        r = query_daemon(config, &filter, pattern, a, &list);
+    }
 
-        int n = 0;
-        if ((n = nofdigits(service->pid)) > widths[0]) {
-            widths[0] = n;
+    if (r == -1) {
+        return NULL;
+    } else if (r == 1) {
+        list = svc_select_roots(config, &filter, view_fields(config), a);
+        if (list == NULL) {
+            return NULL;
         }
-        if ((n = strlen(service->name)) > widths[1]) {
-            widths[1] = n;
+        filter_services(list, NULL, pattern);
+    }
+
+    // recorded by the monitors, a view only reads it
+    if (view_fields(config) & SVC_FIELD_STATUS) {
+        observe_history(config, list);
+    }
+
+    if (config->sort != -1) {
+        view_sort(list, arr_len(list), config->sort, config->sort_desc);
+    }
+
+    return list;
+}
+
+typedef struct {
+    cfg_format format;
+    char const *pattern;
+    struct timespec now;
+} records;
+
+static int
+print_record(void *ctx, svc const *s)
+{
+    records const *r = ctx;
+    if (r->pattern == NULL || fnmatch(r->pattern, s->name, 0) == 0) {
+        double t = stats_clock();
+        view_print_record(stdout, r->format, s, &r->now);
+        stats_phase_end(STATS_RENDER, t, 1);
+    }
+
+    return 0;
+}
+
+/**
+ * Print a record per service as soon as it's scanned, there's no width to
+ * compute. Sorted records, or the ones of several roots, are only printed
+ * once every service is read. Records always hold every field.
+ */
+static int
+view_records(cfg *config, char const *pattern)
+{
+    // a single large buffer, records reach the reader in big writes
+    static char out[64 * 1024];
+    setvbuf(stdout, out, _IOFBF, sizeof(out));
+
+    records rec = {.format = config->format};
+    if (clock_gettime(CLOCK_REALTIME, &rec.now) == -1) {
+        print_last_error("failed to get time: %s", strerror(errno));
+        return 1;
+    }
+
+    view_print_records_header(stdout, config->format);
+
+    cfg_filter filter = config->filter;
+    if (filter.pattern == NULL) {
+        filter.pattern = pattern;
+    } else {
+        rec.pattern = pattern;
+    }
+
+    arena a            = {0};
+    arr_of(svc *) list = NULL;
+    int r              = 1;
+    if (config->sort != -1 || config->roots_len > 1) {
+        list = get_services(config, pattern, &a);
+        r    = list == NULL ? -1 : 0;
+    } else {
+        r = query_daemon(config, &filter, rec.pattern, &a, &list);
+    }
+
+    if (r == 0) {
+        for (size_t i = 0; i < arr_len(list); ++i) {
+            print_record(&rec, list[i]);
         }
-        if ((n = strlen(svc_status_str(service->status))) > widths[2]) {
-            widths[2] = n;
+        arr_free((arr_ptr)list);
+    } else if (r == 1) {
+        r = svc_each(config, &filter, SVC_FIELDS_ALL, print_record, &rec);
+    }
+    arena_free(&a);
+
+    fflush(stdout);
+    if (r == -1) {
+        print_last_error("failed to get services list");
+        return 1;
+    }
+
+    return 0;
+}
+
+static int
+cmd_view(cfg *config,
+         UNUSED svc_handle *h,
+         int argc,
+         char **argv)
+{
+    if (config->format != CFG_FORMAT_TABLE) {
+        return view_records(config, argc > 2 ? argv[2] : NULL);
+    }
+
+    arena a            = {0};
+    arr_of(svc *) list = get_services(config, argc > 2 ? argv[2] : NULL, &a);
+    if (list == NULL) {
+        print_last_error("failed to get services list");
+        arena_free(&a);
+        return 1;
+    }
+
+    int r = 1;
+
+    struct timespec now = {0};
+    if (clock_gettime(CLOCK_REALTIME, &now) == -1) {
+        print_last_error("failed to get time: %s", strerror(errno));
+        goto end;
+    }
+
+    double t           = stats_clock();
+    view_layout layout = {0};
+    view_layout_init(&layout);
+    view_layout_columns(&layout, config->columns, config->columns_len);
+    for (size_t i = 0; i < arr_len(list); ++i) {
+        if (view_layout_fit(&layout, list[i], &now) == -1) {
+            print_last_error("failed to format time of %s", list[i]->name);
+            goto end;
         }
-        if ((n = strlen(service->time)) > widths[4]) {
-            widths[4] = n;
+    }
+
+    view_print_header(stdout, &layout);
+    for (size_t i = 0; i < arr_len(list); ++i) {
+        view_print_row(stdout, &layout, list[i], &now);
+        fputc('\n', stdout);
+    }
+    fflush(stdout);
+    stats_phase_end(STATS_RENDER, t, arr_len(list));
+
+    r = 0;
+
+end:
+    arr_free((arr_ptr)list);
+    arena_free(&a);
+    return r;
+}
+
+static int
+cmd_watch(cfg *config,
+          UNUSED svc_handle *h,
+          UNUSED int argc,
+          UNUSED char **argv)
+{
+    if (watch_run(config) == -1) {
+        print_last_error("failed to watch services");
+        return 1;
+    }
+
+    return 0;
+}
+
+static int
+cmd_top(cfg *config,
+        UNUSED svc_handle *h,
+        int argc,
+        char **argv)
+{
+    top_sort sort = TOP_SORT_CPU;
+    if (argc > 2) {
+        if (strcmp(argv[2], "mem") == 0) {
+            sort = TOP_SORT_MEM;
+        } else if (strcmp(argv[2], "cpu") != 0) {
+            print_last_error("unknown top sort %s, expected cpu or mem",
+                             argv[2]);
+            return 1;
         }
     }
 
-    printf("%-*s  %-*s  %-*s  %-*s  %-*s\n",
-           widths[0],
-           cols[0],
-           widths[1],
-           cols[1],
-           widths[2],
-           cols[2],
-           widths[3],
-           cols[3],
-           widths[4],
-           cols[4]);
+    if (top_run(config, sort) == -1) {
+        print_last_error("failed to show services usage");
+        return 1;
+    }
+
+    return 0;
+}
+
+static int
+cmd_history(cfg *config,
+            UNUSED svc_handle *h,
+            int argc,
+            char **argv)
+{
+    cfg_filter filter = {
+        .pattern = argc > 2 ? argv[2] : NULL,
+        .status  = -1,
+        .down    = -1,
+        .log     = -1,
+    };
+
+    int r              = 1;
+    arena a            = {0};
+    hist *hs           = NULL;
+    arr_of(svc *) list = svc_select(config, &filter, 0, &a);
+    if (list == NULL) {
+        print_last_error("failed to get services list");
+        goto end;
+    }
+
+    if ((hs = hist_open(config, 0)) == NULL ||
+        hist_print(hs, stdout, list, arr_len(list)) == -1) {
+        print_last_error("failed to print history");
+        goto end;
+    }
+    r = 0;
 
-    for (size_t i = 0; i < 5; ++i) {
-        if (i > 0) {
-            printf("  ");
+end:
+    hist_close(hs);
+    if (list != NULL) {
+        arr_free((arr_ptr)list);
+    }
+    arena_free(&a);
+    return r;
+}
+
+static int
+cmd_latency(cfg *config,
+            UNUSED svc_handle *h,
+            int argc,
+            char **argv)
+{
+    cfg_filter filter = {
+        .pattern = argc > 2 ? argv[2] : NULL,
+        .status  = -1,
+        .down    = -1,
+        .log     = -1,
+    };
+
+    int r              = 1;
+    arena a            = {0};
+    lat *l             = NULL;
+    arr_of(svc *) list = svc_select(config, &filter, SVC_FIELD_STATUS, &a);
+    if (list == NULL) {
+        print_last_error("failed to get services list");
+        goto end;
+    }
+
+    if ((l = lat_open(config)) == NULL ||
+        lat_print(l, stdout, list, arr_len(list)) == -1) {
+        print_last_error("failed to print latencies");
+        goto end;
+    }
+    r = 0;
+
+end:
+    lat_close(l);
+    if (list != NULL) {
+        arr_free((arr_ptr)list);
+    }
+    arena_free(&a);
+    return r;
+}
+
+// defined with the other helpers resolving targets
+static arr_of(char *) resolve_targets(char const *dir,
+                                      int argc,
+                                      char **argv,
+                                      arena *a,
+                                      size_t *unmatched);
+
+static int
+cmd_rolling_restart(cfg *config,
+                    UNUSED svc_handle *h,
+                    int argc,
+                    char **argv)
+{
+    if (argc < 3) {
+        print_last_error("[service] expected");
+        return 1;
+    }
+
+    arena a                = {0};
+    size_t unmatched       = 0;
+    arr_of(char *) targets =
+        resolve_targets(config->svdir, argc, argv, &a, &unmatched);
+    if (targets == NULL) {
+        arena_free(&a);
+        return 1;
+    }
+
+    // a pattern matching nothing may be a typo, nothing is restarted then
+    int r = 1;
+    if (unmatched == 0 && arr_len(targets) > 0) {
+        long failed = rolling_run(config, targets, arr_len(targets));
+        if (failed == -1) {
+            print_last_error("failed to restart services");
+        } else if (failed == 0) {
+            r = 0;
+        } else if (failed < (long)arr_len(targets)) {
+            r = 2;
         }
-        for (int j = 0; j < widths[i]; ++j) {
-            putc('-', stdout);
+    }
+
+    arr_free((arr_ptr)targets);
+    arena_free(&a);
+    return r;
+}
+
+static int
+cmd_log(cfg *config,
+        UNUSED svc_handle *h,
+        int argc,
+        char **argv)
+{
+    if (argc < 3) {
+        print_last_error("[service] expected");
+        return 1;
+    }
+
+    arena a                = {0};
+    size_t unmatched       = 0;
+    arr_of(char *) targets =
+        resolve_targets(config->svdir, argc, argv, &a, &unmatched);
+    if (targets == NULL) {
+        arena_free(&a);
+        return 1;
+    }
+
+    int r = 0;
+    if (arr_len(targets) > 0 &&
+        tail_run(config, targets, arr_len(targets)) == -1) {
+        print_last_error("failed to print logs");
+        r = 1;
+    } else if (unmatched > 0) {
+        r = arr_len(targets) > 0 ? 2 : 1;
+    }
+
+    arr_free((arr_ptr)targets);
+    arena_free(&a);
+    return r;
+}
+
+/**
+ * Returns the services whose logs a command reads, the ones given from
+ * argv[first] on or every service of config->svdir when none is, like
+ * resolve_targets().
+ *
+ * Returns NULL on error.
+ */
+static arr_of(char *) log_targets(cfg *config,
+                                  int argc,
+                                  char **argv,
+                                  int first,
+                                  arena *a,
+                                  size_t *unmatched)
+{
+    // resolve_targets() starts at argv[2]
+    return resolve_targets(config->svdir,
+                           argc - (first - 2),
+                           argv + (first - 2),
+                           a,
+                           unmatched);
+}
+
+static int
+cmd_logsearch(cfg *config,
+              UNUSED svc_handle *h,
+              int argc,
+              char **argv)
+{
+    if (argc < 3) {
+        print_last_error("[pattern] expected");
+        return 1;
+    }
+
+    // the services follow the pattern
+    arena a                = {0};
+    size_t unmatched       = 0;
+    arr_of(char *) targets =
+        log_targets(config, argc, argv, 3, &a, &unmatched);
+    if (targets == NULL) {
+        arena_free(&a);
+        return 1;
+    }
+
+    int r      = 0;
+    long found = logsearch_run(config, argv[2], targets, arr_len(targets));
+    if (found == -1) {
+        print_last_error("failed to search logs");
+        r = 1;
+    } else if (found == 0) {
+        // like grep, nothing found isn't an error but tells so
+        r = 1;
+    } else if (unmatched > 0) {
+        r = 2;
+    }
+
+    arr_free((arr_ptr)targets);
+    arena_free(&a);
+    return r;
+}
+
+static int
+cmd_logmerge(cfg *config,
+             UNUSED svc_handle *h,
+             int argc,
+             char **argv)
+{
+    arena a                = {0};
+    size_t unmatched       = 0;
+    arr_of(char *) targets =
+        log_targets(config, argc, argv, 2, &a, &unmatched);
+    if (targets == NULL) {
+        arena_free(&a);
+        return 1;
+    }
+
+    int r = 0;
+    if (arr_len(targets) > 0 &&
+        logmerge_run(config, targets, arr_len(targets)) == -1) {
+        print_last_error("failed to merge logs");
+        r = 1;
+    } else if (unmatched > 0) {
+        r = arr_len(targets) > 0 ? 2 : 1;
+    }
+
+    arr_free((arr_ptr)targets);
+    arena_free(&a);
+    return r;
+}
+
+static int
+cmd_tai64n(UNUSED cfg *config,
+           UNUSED svc_handle *h,
+           int argc,
+           char **argv)
+{
+    if (tai64n_run(argv + 2, argc - 2) == -1) {
+        print_last_error("failed to convert logs");
+        return 1;
+    }
+
+    return 0;
+}
+
+static int
+cmd_metrics(cfg *config,
+            UNUSED svc_handle *h,
+            int argc,
+            char **argv)
+{
+    if (argc < 3) {
+        if (metrics_print(config, STDOUT_FILENO) == -1) {
+            print_last_error("failed to print metrics");
+            return 1;
         }
+        return 0;
+    }
+
+    metrics_sink sink = METRICS_FILE;
+    if (strcmp(argv[2], "socket") == 0) {
+        sink = METRICS_SOCKET;
+    } else if (strcmp(argv[2], "file") != 0) {
+        print_last_error("unknown metrics sink %s", argv[2]);
+        return 1;
+    }
+
+    if (argc < 4) {
+        print_last_error("missing metrics %s path", argv[2]);
+        return 1;
+    }
+
+    if (metrics_run(config, sink, argv[3]) == -1) {
+        print_last_error("failed to export metrics");
+        return 1;
+    }
+
+    return 0;
+}
+
+static int
+cmd_daemon(cfg *config,
+           UNUSED svc_handle *h,
+           UNUSED int argc,
+           UNUSED char **argv)
+{
+    if (svcd_run(config) == -1) {
+        print_last_error("failed to serve services");
+        return 1;
     }
-    fputc('\n', stdout);
 
-    for (size_t i = 0; i < arr_len(list); ++i) {
-        svc *service = list[i];
-        printf("%-*d  %-*s  %-*s  %-*s  %-*s\n",
-               widths[0],
-               service->pid,
-               widths[1],
-               service->name,
-               widths[2],
-               svc_status_str(service->status),
-               widths[3],
-               service->is_down == 1 ? "yes" : "no",
-               widths[4],
-               service->time);
-    }
-
-    arr_free_free((arr_ptr)list, free);
     return 0;
 }
 
 static int
-cmd_help(UNUSED cfg *config, UNUSED int argc, char **argv)
+cmd_help(UNUSED cfg *config,
+         UNUSED svc_handle *h,
+         UNUSED int argc,
+         char **argv)
 {
     printf("%s [command] [args]...\n\n", argv[0]);
     puts("    SVC is a small and simple alternative to sv.\n");
     puts("Environments:\n");
-    puts("    SVDIR: running services directory (default: /var/service/)");
-    puts("    AVDIR: available services directory (default: /etc/sv/)\n");
+    puts("    SVDIR: running services directories separated by colons, view "
+         "shows them\n           all, the other commands use the first "
+         "(default: /var/service/)");
+    puts("    AVDIR: available services directory (default: /etc/sv/)");
+    puts("    SVCSOCK: daemon socket (default: $SVDIR/.svcd.sock)");
+    puts("    SVCHIST: transitions history (default: $SVDIR/.svc.history)");
+    puts("    SVCLAT: --timing latencies (default: $SVDIR/.svc.latency)\n");
     puts("Commands:\n");
     puts("    L, list-availables    list the available services");
     puts("    s, start [service]    start a service");
     puts("    S, stop [service]     stop a service");
     puts("    o, once [service]     start a service once");
     puts("    R, restart [service]  restart a service");
+    puts("    rolling-restart [service]");
+    puts("                          restart services a --batch at a time, "
+         "each wave");
+    puts("                          running and checked for --settle "
+         "seconds first");
     puts("    d, down [service]     down a service");
     puts("    u, up [service]       up a service");
     puts("    l, link [service]     link a service");
     puts("    r, unlink [service]   unlink a service");
-    puts("    v, view               show the services' statuses");
+    puts("    v, view [pattern]     show the services' statuses");
+    puts("    w, watch              show the services' statuses live");
+    puts("    top [cpu|mem]         show the services' CPU and memory usage "
+         "live");
+    puts("    history [pattern]     show the services' last transitions");
+    puts("    latency [pattern]     show the p50, p90 and p99 latencies of "
+         "the --timing");
+    puts("                          controls, with 1-2-5 buckets from 1ms "
+         "to 10s");
+    puts("    log [service]         show the last lines of a service's log");
+    puts("    logsearch [pattern] [service]");
+    puts("                          show the lines of the services' logs "
+         "holding pattern");
+    puts("    logmerge [service]    show the services' logs merged in time "
+         "order");
+    puts("    tai64n [file]         print logs, stdin by default, with their "
+         "tai64n");
+    puts("                          stamps in local time");
+    puts("    daemon                serve the services' statuses to view");
+    puts("    metrics               print the services' OpenMetrics");
+    puts("    metrics file [path]   keep the Prometheus textfile current");
+    puts("    metrics socket [path] serve the OpenMetrics on a Unix socket");
     puts("    h, help               show this helper\n");
     puts("Signals related commands:\n");
     puts("    sig-stop [service]    send a STOP signal to a service");
@@ -281,6 +873,48 @@ cmd_help(UNUSED cfg *config, UNUSED int argc, char **argv)
     puts("    sig-usr2 [service]    send a USR2 signal to a service");
     puts("    sig-term [service]    send a TERM signal to a service");
     puts("    sig-kill [service]    send a KILL signal to a service\n");
+    puts("Options:\n");
+    puts("    -j[n], --jobs[=n]     scan services with n workers (default: "
+         "online CPUs)");
+    puts("    -w, --wait [seconds]  wait for start, stop, once and restart to "
+         "take effect");
+    puts("    --timing              record how long start, stop, once and "
+         "restart take");
+    puts("    --batch [n]           rolling-restart n services at once "
+         "(default: 1)");
+    puts("    --settle [seconds]    keep a wave running that long before the "
+         "next one");
+    puts("    --format [format]     view as table, or stream json, tsv or nul "
+         "records");
+    puts("    --stats               report where view spent its time to "
+         "stderr");
+    puts("    --filter [criteria]   view only the services matching "
+         "name=pattern,");
+    puts("                          status=running|stopped|finishing, "
+         "down=yes|no,");
+    puts("                          log=yes|no, e.g. --filter "
+         "status=stopped,down=no");
+    puts("    --columns [columns]   view only root, pid, name, status, down, "
+         "time and");
+    puts("                          restarts, in order");
+    puts("    --sort [[-]column]    sort view by a column, - for descending "
+         "order");
+    puts("    -n, --lines [n]       log the last n lines (default: 10)");
+    puts("    -f, --follow          log or logmerge the lines as they're "
+         "written,");
+    puts("                          rotations included");
+    puts("    --since [time]        search the logs from time, a date, "
+         "unix seconds,");
+    puts("                          a tai64n label or e.g. -2h for 2 hours "
+         "ago");
+    puts("    --until [time]        search the logs up to time");
+    puts("    --auto-down [n]       down the services starting more than n "
+         "times an hour");
+    puts("                          while daemon, watch, top or metrics "
+         "runs\n");
+    puts("Commands taking a [service] also accept several services and "
+         "shell-style\npatterns, e.g. 'worker-*', they exit with 2 when only "
+         "some of them failed.\n");
     puts("The default command is view.");
     return 0;
 }
@@ -305,6 +939,7 @@ find_cmd(int argc, char **argv)
         case 'l': return cmd_link;
         case 'r': return cmd_unlink;
         case 'v': return cmd_view;
+        case 'w': return cmd_watch;
         case 'h': return cmd_help;
         }
     } else if (strcasecmp(cmd, "list-availables") == 0) {
@@ -327,6 +962,28 @@ find_cmd(int argc, char **argv)
         return cmd_unlink;
     } else if (strcasecmp(cmd, "view") == 0) {
         return cmd_view;
+    } else if (strcasecmp(cmd, "watch") == 0) {
+        return cmd_watch;
+    } else if (strcasecmp(cmd, "top") == 0) {
+        return cmd_top;
+    } else if (strcasecmp(cmd, "history") == 0) {
+        return cmd_history;
+    } else if (strcasecmp(cmd, "latency") == 0) {
+        return cmd_latency;
+    } else if (strcasecmp(cmd, "log") == 0) {
+        return cmd_log;
+    } else if (strcasecmp(cmd, "logsearch") == 0) {
+        return cmd_logsearch;
+    } else if (strcasecmp(cmd, "logmerge") == 0) {
+        return cmd_logmerge;
+    } else if (strcasecmp(cmd, "tai64n") == 0) {
+        return cmd_tai64n;
+    } else if (strcasecmp(cmd, "rolling-restart") == 0) {
+        return cmd_rolling_restart;
+    } else if (strcasecmp(cmd, "daemon") == 0) {
+        return cmd_daemon;
+    } else if (strcasecmp(cmd, "metrics") == 0) {
+        return cmd_metrics;
     } else if (strcasecmp(cmd, "help") == 0) {
         return cmd_help;
     } else if (strcasecmp(cmd, "sig-stop") == 0) {
@@ -355,29 +1012,48 @@ find_cmd(int argc, char **argv)
     return NULL;
 }
 
+/**
+ * Check reqs against the service argv[2], opening it into h when it has to be
+ * linked. The handle must be closed upon usage with svc_close(), even on
+ * error.
+ *
+ * Returns -1 on error.
+ */
 static int
-do_requirements(cmd_req reqs, cfg *config, int argc, char **argv)
+do_requirements(
+    cmd_req reqs, cfg *config, svc_handle **h, int argc, char **argv)
 {
     if (reqs & CMD_REQ_SVC && argc < 3) {
         print_last_error("[service] expected");
         return -1;
     }
 
-    if (reqs & CMD_REQ_SVC_LINKED || reqs & CMD_REQ_SVC_NOT_LINKED) {
+    if (reqs & CMD_REQ_SVC_LINKED) {
         assert(reqs & CMD_REQ_SVC);
 
-        int r = svc_linked(config, argv[2]);
-        if (r == -1) {
-            print_last_error("failed to check service %s", argv[2]);
+        // opening the service tells whether it's linked at once
+        if ((*h = svc_open(config, argv[2])) == NULL) {
+            if (errno == ENOENT) {
+                clear_last_error();
+                print_last_error("service %s is already not linked",
+                                 argv[2]);
+            } else {
+                print_last_error("failed to open service %s", argv[2]);
+            }
             return -1;
         }
+    }
 
-        if (reqs & CMD_REQ_SVC_LINKED && r == 0) {
-            print_last_error("service %s is already not linked", argv[2]);
+    if (reqs & CMD_REQ_SVC_NOT_LINKED) {
+        assert(reqs & CMD_REQ_SVC);
+
+        int r = svc_linked(config, argv[2]);
+        if (r == -1) {
+            print_last_error("failed to check service %s", argv[2]);
             return -1;
         }
 
-        if (reqs & CMD_REQ_SVC_NOT_LINKED && r == 1) {
+        if (r == 1) {
             print_last_error("service %s is already linked", argv[2]);
             return -1;
         }
@@ -386,7 +1062,9 @@ do_requirements(cmd_req reqs, cfg *config, int argc, char **argv)
     if (reqs & CMD_REQ_SVC_RUNNING || reqs & CMD_REQ_SVC_NOT_RUNNING) {
         assert(reqs & CMD_REQ_SVC);
 
-        int r = svc_running(config, argv[2]);
+        assert(reqs & CMD_REQ_SVC_LINKED);
+
+        int r = svc_running(*h);
         if (r == -1) {
             print_last_error("failed to get service %s status", argv[2]);
             return -1;
@@ -419,7 +1097,9 @@ do_requirements(cmd_req reqs, cfg *config, int argc, char **argv)
     if (reqs & CMD_REQ_SVC_DOWN || reqs & CMD_REQ_SVC_NOT_DOWN) {
         assert(reqs & CMD_REQ_SVC);
 
-        int r = svc_is_down(config, argv[2]);
+        assert(reqs & CMD_REQ_SVC_LINKED);
+
+        int r = svc_is_down(*h);
         if (r == -1) {
             print_last_error("failed to get service %s downess", argv[2]);
             return -1;
@@ -439,9 +1119,573 @@ do_requirements(cmd_req reqs, cfg *config, int argc, char **argv)
     return 0;
 }
 
+static int
+isglob(char const *s)
+{
+    return strpbrk(s, "*?[") != NULL;
+}
+
+static int
+add_target(arr_of(char *) * targets, char *name)
+{
+    if (arr_append((arr_ptr *)targets, name) < 0) {
+        print_last_error("failed to add target %s: %s", name, strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+static int
+cmp_slots(void const *a, void const *b)
+{
+    char *const *x = *(char *const *const *)a;
+    char *const *y = *(char *const *const *)b;
+
+    int r = strcmp(*x, *y);
+    if (r != 0) {
+        return r;
+    }
+
+    // the first given sorts first and is the one kept
+    return (x > y) - (x < y);
+}
+
+/**
+ * Remove the names of targets given more than once, by name or through
+ * patterns, keeping the order of their first occurrence. The slots are sorted
+ * by name so it stays O(n log n) however many targets a pattern expands to.
+ *
+ * Returns -1 on error.
+ */
+static int
+dedup_targets(arr_of(char *) targets)
+{
+    size_t n = arr_len(targets);
+    if (n < 2) {
+        return 0;
+    }
+
+    char ***slots = malloc(n * sizeof(*slots));
+    if (slots == NULL) {
+        print_last_error("malloc failed: %s", strerror(errno));
+        return -1;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        slots[i] = &targets[i];
+    }
+
+    qsort(slots, n, sizeof(*slots), cmp_slots);
+    char const *kept = NULL;
+    for (size_t i = 0; i < n; ++i) {
+        if (kept != NULL && strcmp(*slots[i], kept) == 0) {
+            *slots[i] = NULL;
+        } else {
+            kept = *slots[i];
+        }
+    }
+    free(slots);
+
+    size_t len = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (targets[i] != NULL) {
+            targets[len++] = targets[i];
+        }
+    }
+    arr_len(targets) = len;
+    return 0;
+}
+
+/**
+ * Expand the names and shell-style patterns of argv[2..] into targets, every
+ * pattern is matched against a single listing of dir. Patterns matching
+ * nothing are reported and counted in unmatched, a service given twice is
+ * kept once. Without any, every service of dir is. The matched names are
+ * allocated in a, the others point in argv.
+ *
+ * Returns NULL on error.
+ */
+static arr_of(char *) resolve_targets(char const *dir,
+                                      int argc,
+                                      char **argv,
+                                      arena *a,
+                                      size_t *unmatched)
+{
+    arr_of(char *) entries = NULL;
+    if (argc <= 2) {
+        if ((entries = io_list_dirs(dir, a)) == NULL) {
+            print_last_error("failed to list dirs in '%s'", dir);
+        }
+        return entries;
+    }
+
+    arr_of(char *) targets = (arr_of(char *))arr_alloc(NULL, argc);
+    if (targets == NULL) {
+        print_last_error("failed to allocate array: %s", strerror(errno));
+        return NULL;
+    }
+
+    for (int i = 2; i < argc; ++i) {
+        if (!isglob(argv[i])) {
+            if (add_target(&targets, argv[i]) < 0) {
+                goto err;
+            }
+            continue;
+        }
+
+        if (entries == NULL && (entries = io_list_dirs(dir, a)) == NULL) {
+            print_last_error("failed to list dirs in '%s'", dir);
+            goto err;
+        }
+
+        int matched = 0;
+        for (size_t j = 0; j < arr_len(entries); ++j) {
+            if (fnmatch(argv[i], entries[j], 0) == 0) {
+                if (add_target(&targets, entries[j]) < 0) {
+                    goto err;
+                }
+                matched = 1;
+            }
+        }
+
+        if (!matched) {
+            print_last_error("no service matches %s", argv[i]);
+            ++*unmatched;
+        }
+    }
+
+    if (dedup_targets(targets) < 0) {
+        goto err;
+    }
+
+    arr_free((arr_ptr)entries);
+    return targets;
+
+err:
+    arr_free((arr_ptr)entries);
+    arr_free((arr_ptr)targets);
+    return NULL;
+}
+
+/**
+ * Returns the status the services end up in after c, SVC_UNKNOWN if c can't
+ * be waited on.
+ */
+static svc_status
+wait_status(cmd c)
+{
+    if (c == cmd_start || c == cmd_once || c == cmd_restart) {
+        return SVC_RUNNING;
+    } else if (c == cmd_stop) {
+        return SVC_STOPPED;
+    }
+
+    return SVC_UNKNOWN;
+}
+
+/**
+ * Wait for the given services and report how long each of them took.
+ *
+ * Returns the number of services that didn't make it in time.
+ */
+static size_t
+wait_targets(cfg *config, int ifd, waiter *ws, size_t n)
+{
+    clear_last_error();
+    if (waiter_run(config, ifd, ws, n, config->wait) == -1) {
+        print_last_error("failed to wait for services");
+        return n;
+    }
+
+    size_t failed = 0;
+    for (size_t i = 0; i < n; ++i) {
+        char const *status = svc_status_str(ws[i].status);
+        if (ws[i].reached) {
+            printf("%s %s after %.3fs\n", ws[i].name, status, ws[i].latency);
+        } else {
+            print_last_error("timed out waiting for %s to be %s",
+                             ws[i].name,
+                             status);
+            ++failed;
+        }
+    }
+
+    return failed;
+}
+
+/**
+ * Check the requirements of c and run it on every target of argv, commands
+ * act on argv[2] so they are handed one target at a time. With --wait, the
+ * targets are then waited for all together, with --timing their latencies
+ * are recorded.
+ *
+ * Returns 0 if every target succeeded, 2 if only some did, otherwise 1.
+ */
+static int
+run_targets(cmd c, cmd_req reqs, cfg *config, int argc, char **argv)
+{
+    char const *dir = reqs & CMD_REQ_AVAILABLE_EXISTS ? config->available
+                                                      : config->svdir;
+
+    arena a                = {0};
+    size_t unmatched       = 0;
+    arr_of(char *) targets = resolve_targets(dir, argc, argv, &a, &unmatched);
+    if (targets == NULL) {
+        arena_free(&a);
+        return 1;
+    }
+
+    size_t total  = arr_len(targets) + unmatched;
+    size_t failed = unmatched;
+
+    waiter *ws        = NULL;
+    size_t nws        = 0;
+    int ifd           = -1;
+    svc_status status =
+        config->wait > 0 || config->timing ? wait_status(c) : SVC_UNKNOWN;
+    if (status != SVC_UNKNOWN &&
+        (ws = calloc(arr_len(targets) + 1, sizeof(*ws))) == NULL) {
+        print_last_error("calloc failed: %s", strerror(errno));
+        arr_free((arr_ptr)targets);
+        arena_free(&a);
+        return 1;
+    } else if (status != SVC_UNKNOWN && config->wait > 0 &&
+               (ifd = waiter_init()) == -1) {
+        print_last_error("failed to wait for services");
+        free(ws);
+        arr_free((arr_ptr)targets);
+        arena_free(&a);
+        return 1;
+    }
+
+    char *targv[] = {argv[0], argv[1], NULL, NULL};
+    for (size_t i = 0; i < arr_len(targets); ++i) {
+        clear_last_error();
+
+        svc_handle *h = NULL;
+        targv[2]      = targets[i];
+        if (do_requirements(reqs, config, &h, 3, targv) < 0) {
+            svc_close(h);
+            ++failed;
+            continue;
+        }
+
+        waiter *w = ws != NULL ? &ws[nws] : NULL;
+        if (w != NULL) {
+            *w = (waiter){.name = targets[i], .status = status};
+            if (waiter_prepare(config, ifd, w) == -1) {
+                print_last_error("failed to read %s", targets[i]);
+                svc_close(h);
+                ++failed;
+                continue;
+            }
+            clock_gettime(CLOCK_REALTIME, &w->written);
+        }
+
+        int r = c(config, h, 3, targv);
+        svc_close(h);
+        if (r != 0) {
+            ++failed;
+            continue;
+        }
+
+        if (w != NULL) {
+            ++nws;
+        }
+    }
+
+    if (nws > 0 && config->wait > 0) {
+        failed += wait_targets(config, ifd, ws, nws);
+    }
+    clear_last_error();
+    if (nws > 0 && config->timing && lat_save(config, ws, nws) == -1) {
+        print_last_error("failed to record latencies");
+    }
+
+    // the results are out before closing ifd waits for the watches to go
+    if (ifd != -1) {
+        fflush(stdout);
+        close(ifd);
+    }
+    free(ws);
+    arr_free((arr_ptr)targets);
+    arena_free(&a);
+
+    if (total > 1 && failed > 0) {
+        fprintf(stderr, "%zu of %zu targets failed\n", failed, total);
+    }
+
+    return failed == 0 ? 0 : failed == total ? 1 : 2;
+}
+
+static int
+isnumber(char const *s)
+{
+    if (*s == '\0') {
+        return 0;
+    }
+
+    for (; *s != '\0'; ++s) {
+        if (!isdigit((unsigned char)*s)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * Parse the comma separated key=value criteria of --filter into filter, arg
+ * is kept for the name pattern.
+ *
+ * Returns -1 on error.
+ */
+static int
+parse_filter(cfg_filter *filter, char *arg)
+{
+    char *kv = NULL;
+    while ((kv = strsep(&arg, ",")) != NULL) {
+        char *v = strchr(kv, '=');
+        if (v == NULL) {
+            print_last_error("invalid filter %s, expected key=value", kv);
+            return -1;
+        }
+        *v++ = '\0';
+
+        int *flag = NULL;
+        if (strcmp(kv, "name") == 0) {
+            filter->pattern = v;
+            continue;
+        } else if (strcmp(kv, "status") == 0) {
+            filter->status = -1;
+            for (int st = SVC_RUNNING; st < SVC_UNKNOWN; ++st) {
+                if (strcmp(v, svc_status_str(st)) == 0) {
+                    filter->status = st;
+                }
+            }
+
+            if (filter->status == -1) {
+                print_last_error("invalid status %s", v);
+                return -1;
+            }
+            continue;
+        } else if (strcmp(kv, "down") == 0) {
+            flag = &filter->down;
+        } else if (strcmp(kv, "log") == 0) {
+            flag = &filter->log;
+        } else {
+            print_last_error("unknown filter %s", kv);
+            return -1;
+        }
+
+        if (strcmp(v, "yes") == 0) {
+            *flag = 1;
+        } else if (strcmp(v, "no") == 0) {
+            *flag = 0;
+        } else {
+            print_last_error("invalid %s %s, expected yes or no", kv, v);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Parse the comma separated column names of --columns into config.
+ *
+ * Returns -1 on error.
+ */
+static int
+parse_columns(cfg *config, char *arg)
+{
+    config->columns_len = 0;
+
+    char *name = NULL;
+    while ((name = strsep(&arg, ",")) != NULL) {
+        int c = view_column(name);
+        if (c == -1) {
+            print_last_error("unknown column %s", name);
+            return -1;
+        }
+
+        for (int i = 0; i < config->columns_len; ++i) {
+            if (config->columns[i] == (cfg_col)c) {
+                print_last_error("column %s given twice", name);
+                return -1;
+            }
+        }
+        config->columns[config->columns_len++] = c;
+    }
+
+    return 0;
+}
+
+/**
+ * Parse the options found anywhere in argv into config, then shift the
+ * remaining arguments so that argv[1] is the command and argv[2] its service.
+ *
+ * Returns -1 on error.
+ */
+static int
+parse_opts(cfg *config, int *argc, char **argv)
+{
+    static struct option const opts[] = {
+        {"jobs", optional_argument, NULL, 'j'},
+        {"wait", required_argument, NULL, 'w'},
+        {"format", required_argument, NULL, 'F'},
+        {"stats", no_argument, NULL, 'S'},
+        {"filter", required_argument, NULL, 'I'},
+        {"columns", required_argument, NULL, 'C'},
+        {"sort", required_argument, NULL, 'O'},
+        {"auto-down", required_argument, NULL, 'A'},
+        {"lines", required_argument, NULL, 'n'},
+        {"follow", no_argument, NULL, 'f'},
+        {"since", required_argument, NULL, 'B'},
+        {"until", required_argument, NULL, 'U'},
+        {"batch", required_argument, NULL, 'N'},
+        {"settle", required_argument, NULL, 'T'},
+        {"timing", no_argument, NULL, 'M'},
+        {0},
+    };
+
+    opterr = 0;
+
+    int c = 0;
+    while ((c = getopt_long(*argc, argv, ":j::w:n:f", opts, NULL)) != -1) {
+        switch (c) {
+        case 'j': {
+            // the count is only taken attached, -j4 or --jobs=4, so that a
+            // lone -j, every online CPU, never eats a numeric service name
+            char const *arg = optarg;
+            if (arg == NULL) {
+                config->jobs = pool_cpus();
+            } else if (!isnumber(arg) || (config->jobs = atol(arg)) < 1) {
+                print_last_error("invalid number of jobs %s", arg);
+                return -1;
+            }
+            break;
+        }
+        case 'w': {
+            char *end    = NULL;
+            config->wait = strtod(optarg, &end);
+            if (*end != '\0' || !(config->wait > 0)) {
+                print_last_error("invalid number of seconds %s", optarg);
+                return -1;
+            }
+            break;
+        }
+        case 'F':
+            if (strcmp(optarg, "json") == 0) {
+                config->format = CFG_FORMAT_JSON;
+            } else if (strcmp(optarg, "tsv") == 0) {
+                config->format = CFG_FORMAT_TSV;
+            } else if (strcmp(optarg, "nul") == 0) {
+                config->format = CFG_FORMAT_NUL;
+            } else if (strcmp(optarg, "table") == 0) {
+                config->format = CFG_FORMAT_TABLE;
+            } else {
+                print_last_error("invalid format %s", optarg);
+                return -1;
+            }
+            break;
+        case 'S':
+            stats_enabled = 1;
+            break;
+        case 'I':
+            if (parse_filter(&config->filter, optarg) == -1) {
+                return -1;
+            }
+            break;
+        case 'C':
+            if (parse_columns(config, optarg) == -1) {
+                return -1;
+            }
+            break;
+        case 'O':
+            // a leading - sorts in descending order
+            config->sort_desc = optarg[0] == '-';
+            config->sort      = view_column(optarg + config->sort_desc);
+            if (config->sort == -1) {
+                print_last_error("unknown column %s", optarg);
+                return -1;
+            }
+            break;
+        case 'n':
+            if (!isnumber(optarg)) {
+                print_last_error("invalid number of lines %s", optarg);
+                return -1;
+            }
+            config->lines = atol(optarg);
+            break;
+        case 'f':
+            config->follow = 1;
+            break;
+        case 'M':
+            config->timing = 1;
+            break;
+        case 'B':
+            if (svlog_parse_time(optarg, &config->since) == -1) {
+                print_last_error("invalid --since");
+                return -1;
+            }
+            break;
+        case 'U':
+            if (svlog_parse_time(optarg, &config->until) == -1) {
+                print_last_error("invalid --until");
+                return -1;
+            }
+            break;
+        case 'N':
+            if (!isnumber(optarg) || (config->batch = atol(optarg)) < 1) {
+                print_last_error("invalid batch size %s", optarg);
+                return -1;
+            }
+            break;
+        case 'T': {
+            char *end      = NULL;
+            config->settle = strtod(optarg, &end);
+            if (*end != '\0' || !(config->settle >= 0)) {
+                print_last_error("invalid number of seconds %s", optarg);
+                return -1;
+            }
+            break;
+        }
+        case 'A':
+            if (!isnumber(optarg) || (config->auto_down = atol(optarg)) < 1) {
+                print_last_error("invalid number of starts %s", optarg);
+                return -1;
+            }
+            break;
+        case ':':
+            print_last_error("option %s expects an argument",
+                             argv[optind - 1]);
+            return -1;
+        default:
+            print_last_error("unknown option %s", argv[optind - 1]);
+            return -1;
+        }
+    }
+
+    int n = *argc - optind;
+    memmove(argv + 1, argv + optind, sizeof(*argv) * n);
+    *argc       = n + 1;
+    argv[*argc] = NULL;
+    return 0;
+}
+
 int
 main(int argc, char **argv)
 {
+    cfg config = {0};
+    if (cfg_get(&config) == -1) {
+        print_last_error("invalid config");
+        return 1;
+    } else if (parse_opts(&config, &argc, argv) < 0) {
+        return 1;
+    }
+
     cmd c = find_cmd(argc, argv);
     if (c == NULL) {
         return 1;
@@ -468,6 +1712,28 @@ main(int argc, char **argv)
         reqs = CMD_REQ_SVC | CMD_REQ_SVC_LINKED;
     } else if (c == cmd_view) {
         reqs = 0;
+    } else if (c == cmd_watch) {
+        reqs = 0;
+    } else if (c == cmd_top) {
+        reqs = 0;
+    } else if (c == cmd_history) {
+        reqs = 0;
+    } else if (c == cmd_latency) {
+        reqs = 0;
+    } else if (c == cmd_log) {
+        reqs = 0;
+    } else if (c == cmd_logsearch) {
+        reqs = 0;
+    } else if (c == cmd_logmerge) {
+        reqs = 0;
+    } else if (c == cmd_tai64n) {
+        reqs = 0;
+    } else if (c == cmd_rolling_restart) {
+        reqs = 0;
+    } else if (c == cmd_daemon) {
+        reqs = 0;
+    } else if (c == cmd_metrics) {
+        reqs = 0;
     } else if (c == cmd_help) {
         reqs = 0;
     } else if (c == cmd_sig_stop) {
@@ -492,10 +1758,22 @@ main(int argc, char **argv)
         reqs = CMD_REQ_SVC | CMD_REQ_SVC_LINKED | CMD_REQ_SVC_RUNNING;
     }
 
-    cfg config = cfg_get();
-    if (do_requirements(reqs, &config, argc, argv) < 0) {
-        return 1;
+    if (reqs & CMD_REQ_SVC) {
+        if (argc < 3) {
+            print_last_error("[service] expected");
+            return 1;
+        }
+
+        return run_targets(c, reqs, &config, argc, argv);
     }
 
-    return c(&config, argc, argv);
+    svc_handle *h = NULL;
+    int r         = 1;
+    if (do_requirements(reqs, &config, &h, argc, argv) == 0) {
+        r = c(&config, h, argc, argv);
+    }
+
+    svc_close(h);
+    stats_print(stderr);
+    return r;
 }
@@ -0,0 +1,563 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#include "metrics.h"
+#include "buf.h"
+#include "err.h"
+#include "io.h"
+#include "monitor.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// the uptimes of a textfile go stale in between changes, it's rewritten at
+// least this often
+#define METRICS_REFRESH_SEC 10
+
+typedef enum {
+    FAM_UP,
+    FAM_WANT,
+    FAM_PID,
+    FAM_UPTIME,
+    FAM_TRANSITIONS,
+    FAMS,
+} family;
+
+/**
+ * Formats of the metrics: the textfile collector of node_exporter parses the
+ * Prometheus text format, which has no stateset, no unit and no EOF.
+ */
+typedef enum {
+    FORMAT_OPENMETRICS,
+    FORMAT_PROMETHEUS,
+} format;
+
+static char const *const headers[][FAMS] = {
+    [FORMAT_OPENMETRICS] = {
+        "# TYPE svc_up gauge\n"
+        "# HELP svc_up Whether the service is running.\n",
+        "# TYPE svc_want stateset\n"
+        "# HELP svc_want State the service is asked to reach, if any.\n",
+        "# TYPE svc_pid gauge\n"
+        "# HELP svc_pid Pid of the service, 0 when it is not running.\n",
+        "# TYPE svc_uptime_seconds gauge\n"
+        "# UNIT svc_uptime_seconds seconds\n"
+        "# HELP svc_uptime_seconds Seconds the service has been running, 0 "
+        "when it is not running.\n",
+        "# TYPE svc_transitions counter\n"
+        "# HELP svc_transitions Status changes seen since the export "
+        "started.\n",
+    },
+    [FORMAT_PROMETHEUS] = {
+        "# TYPE svc_up gauge\n"
+        "# HELP svc_up Whether the service is running.\n",
+        "# TYPE svc_want gauge\n"
+        "# HELP svc_want Whether the service is asked to reach state.\n",
+        "# TYPE svc_pid gauge\n"
+        "# HELP svc_pid Pid of the service, 0 when it is not running.\n",
+        "# TYPE svc_uptime_seconds gauge\n"
+        "# HELP svc_uptime_seconds Seconds the service has been running, 0 "
+        "when it is not running.\n",
+        "# TYPE svc_transitions_total counter\n"
+        "# HELP svc_transitions_total Status changes seen since the export "
+        "started.\n",
+    },
+};
+
+static volatile sig_atomic_t stopped;
+
+static void
+on_signal(int sig)
+{
+    (void)sig;
+    stopped = 1;
+}
+
+/**
+ * The series of a single service.
+ */
+typedef struct {
+    char *name;
+    svc_status status;
+    struct timespec since;
+    unsigned long transitions;
+
+    /**
+     * The serialized samples of every family, from off[f] to off[f + 1]. The
+     * uptime only holds the sample name and labels, its value is appended on
+     * every export.
+     */
+    buf lines;
+    size_t off[FAMS + 1];
+} series;
+
+typedef struct {
+    monitor m;
+    format fmt;
+
+    /**
+     * The series of every service in m.list, at the same index.
+     */
+    series *series;
+    size_t len;
+    buf out;
+} exporter;
+
+/**
+ * Append the name and labels of a sample of the service name, extra holds
+ * more labels, if any.
+ */
+static int
+put_sample(buf *b, char const *metric, char const *name, char const *extra)
+{
+    if (buf_printf(b, "%s{service=\"", metric) < 0) {
+        return -1;
+    }
+
+    for (char const *c = name; *c != '\0'; ++c) {
+        char const *esc = *c == '\\' ? "\\\\"
+                          : *c == '"' ? "\\\""
+                          : *c == '\n' ? "\\n"
+                                       : NULL;
+        int r = esc != NULL ? buf_append(b, esc, 2) : buf_append(b, c, 1);
+        if (r < 0) {
+            return -1;
+        }
+    }
+
+    return buf_printf(b, "\"%s} ", extra);
+}
+
+static int
+put_ulong(buf *b, unsigned long v, char end)
+{
+    char digits[24];
+    char *p = digits + sizeof(digits);
+
+    *--p = end;
+    do {
+        *--p = '0' + v % 10;
+        v /= 10;
+    } while (v > 0);
+
+    return buf_append(b, p, digits + sizeof(digits) - p);
+}
+
+/**
+ * Serialize the series of se from s again in fmt.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+render(series *se, svc const *s, format fmt)
+{
+    // a stateset has a label named after the metric, a gauge a state
+    char const *up   = fmt == FORMAT_OPENMETRICS ? ",svc_want=\"up\""
+                                                 : ",state=\"up\"";
+    char const *down = fmt == FORMAT_OPENMETRICS ? ",svc_want=\"down\""
+                                                 : ",state=\"down\"";
+
+    buf *b = &se->lines;
+    b->len = 0;
+
+    se->off[FAM_UP] = b->len;
+    if (put_sample(b, "svc_up", s->name, "") < 0 ||
+        put_ulong(b, s->status == SVC_RUNNING, '\n') < 0) {
+        goto err;
+    }
+
+    se->off[FAM_WANT] = b->len;
+    if (put_sample(b, "svc_want", s->name, up) < 0 ||
+        put_ulong(b, s->want == SVC_WANT_UP, '\n') < 0 ||
+        put_sample(b, "svc_want", s->name, down) < 0 ||
+        put_ulong(b, s->want == SVC_WANT_DOWN, '\n') < 0) {
+        goto err;
+    }
+
+    se->off[FAM_PID] = b->len;
+    if (put_sample(b, "svc_pid", s->name, "") < 0 ||
+        put_ulong(b, s->status == SVC_RUNNING ? s->pid : 0, '\n') < 0) {
+        goto err;
+    }
+
+    // the value is appended on export
+    se->off[FAM_UPTIME] = b->len;
+    if (put_sample(b, "svc_uptime_seconds", s->name, "") < 0) {
+        goto err;
+    }
+
+    se->off[FAM_TRANSITIONS] = b->len;
+    if (put_sample(b, "svc_transitions_total", s->name, "") < 0 ||
+        put_ulong(b, se->transitions, '\n') < 0) {
+        goto err;
+    }
+
+    se->off[FAMS] = b->len;
+    return 0;
+
+err:
+    set_last_error("failed to serialize %s: %s", s->name, strerror(errno));
+    return -1;
+}
+
+/**
+ * Serialize the series of list, rendered in fmt, into out, only the uptimes
+ * are computed.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+export(series *ss, arr_of(svc *) list, format fmt, buf *out)
+{
+    struct timespec now = {0};
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    out->len = 0;
+    for (family f = FAM_UP; f < FAMS; ++f) {
+        char const *h = headers[fmt][f];
+        if (buf_append(out, h, strlen(h)) < 0) {
+            goto err;
+        }
+
+        for (size_t i = 0; i < arr_len(list); ++i) {
+            series const *se = &ss[i];
+            if (buf_append(out,
+                           se->lines.data + se->off[f],
+                           se->off[f + 1] - se->off[f]) < 0) {
+                goto err;
+            }
+
+            if (f != FAM_UPTIME) {
+                continue;
+            }
+
+            svc const *s       = list[i];
+            unsigned long secs = 0;
+            if (s->status == SVC_RUNNING && now.tv_sec > s->since.tv_sec) {
+                secs = now.tv_sec - s->since.tv_sec;
+            }
+            if (put_ulong(out, secs, '\n') < 0) {
+                goto err;
+            }
+        }
+    }
+
+    if (fmt == FORMAT_OPENMETRICS && buf_append(out, "# EOF\n", 6) < 0) {
+        goto err;
+    }
+
+    return 0;
+
+err:
+    set_last_error("failed to serialize metrics: %s", strerror(errno));
+    return -1;
+}
+
+static void
+series_free(series *ss, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        free(ss[i].name);
+        buf_free(&ss[i].lines);
+    }
+    free(ss);
+}
+
+static int
+by_name(void const *a, void const *b)
+{
+    return strcmp(((series const *)a)->name, ((series const *)b)->name);
+}
+
+/**
+ * Build the series of list in fmt, carrying the transitions of the old series
+ * ss of the same services over, ss gets sorted by name.
+ *
+ * Returns NULL on error and set last_error.
+ */
+static series *
+series_new(arr_of(svc *) list, series *ss, size_t n, format fmt)
+{
+    series *fresh = calloc(arr_len(list) + 1, sizeof(*fresh));
+    if (fresh == NULL) {
+        set_last_error("calloc failed: %s", strerror(errno));
+        return NULL;
+    }
+
+    if (n > 0) {
+        qsort(ss, n, sizeof(*ss), by_name);
+    }
+
+    for (size_t i = 0; i < arr_len(list); ++i) {
+        svc const *s = list[i];
+        series *se   = &fresh[i];
+
+        series key   = {.name = (char *)s->name};
+        series *prev = n > 0 ? bsearch(&key, ss, n, sizeof(*ss), by_name)
+                             : NULL;
+        if (prev != NULL) {
+            se->transitions = prev->transitions;
+            if (prev->status != s->status ||
+                prev->since.tv_sec != s->since.tv_sec ||
+                prev->since.tv_nsec != s->since.tv_nsec) {
+                ++se->transitions;
+            }
+        }
+
+        se->name   = strdup(s->name);
+        se->status = s->status;
+        se->since  = s->since;
+        if (se->name == NULL) {
+            set_last_error("strdup failed: %s", strerror(errno));
+            goto err;
+        }
+
+        if (render(se, s, fmt) == -1) {
+            goto err;
+        }
+    }
+
+    return fresh;
+
+err:
+    series_free(fresh, arr_len(list));
+    return NULL;
+}
+
+/**
+ * Bring the series up to date after monitor_read() returned r, counting the
+ * transitions of the services that changed.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+sync_series(exporter *e, int r)
+{
+    if (r == 1) {
+        series *ss = series_new(e->m.list, e->series, e->len, e->fmt);
+        if (ss == NULL) {
+            return -1;
+        }
+        series_free(e->series, e->len);
+        e->series = ss;
+        e->len    = arr_len(e->m.list);
+        return 0;
+    }
+
+    for (size_t i = 0; i < arr_len(e->m.list); ++i) {
+        if (!e->m.dirty[i]) {
+            continue;
+        }
+
+        svc const *s = e->m.list[i];
+        series *se   = &e->series[i];
+        if (se->status != s->status || se->since.tv_sec != s->since.tv_sec ||
+            se->since.tv_nsec != s->since.tv_nsec) {
+            ++se->transitions;
+        }
+        se->status = s->status;
+        se->since  = s->since;
+
+        if (render(se, s, e->fmt) == -1) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int
+metrics_print(cfg *config, int fd)
+{
+    arena a            = {0};
+    arr_of(svc *) list = svc_list(config, &a);
+    if (list == NULL) {
+        arena_free(&a);
+        return -1;
+    }
+
+    int r      = -1;
+    buf out    = {0};
+    series *ss = series_new(list, NULL, 0, FORMAT_OPENMETRICS);
+    if (ss == NULL) {
+        goto end;
+    }
+
+    if (export(ss, list, FORMAT_OPENMETRICS, &out) == 0) {
+        r = io_write_all(fd, out.data, out.len);
+    }
+
+    series_free(ss, arr_len(list));
+
+end:
+    buf_free(&out);
+    arr_free((arr_ptr)list);
+    arena_free(&a);
+    return r;
+}
+
+/**
+ * Replace the textfile at path with the current metrics.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+write_file(exporter *e, char const *path)
+{
+    char tmp[512] = {0};
+    if (io_snprintf(tmp, 512, "%s.tmp", path) == -1) {
+        wrap_last_error("io_snprintf failed");
+        return -1;
+    }
+
+    if (export(e->series, e->m.list, e->fmt, &e->out) == -1) {
+        return -1;
+    }
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        set_last_error("failed to open %s: %s", tmp, strerror(errno));
+        return -1;
+    }
+
+    int r = io_write_all(fd, e->out.data, e->out.len);
+    close(fd);
+
+    // scrapers never see a partial file
+    if (r == 0 && rename(tmp, path) == -1) {
+        set_last_error("failed to rename %s: %s", tmp, strerror(errno));
+        r = -1;
+    }
+    if (r == -1) {
+        unlink(tmp);
+    }
+
+    return r;
+}
+
+static int
+serve(exporter *e, int fd)
+{
+    int c = accept4(fd, NULL, NULL, SOCK_CLOEXEC);
+    if (c == -1) {
+        return 0;
+    }
+
+    struct timeval tv = {.tv_sec = 1};
+    setsockopt(c, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    int r = export(e->series, e->m.list, e->fmt, &e->out);
+    if (r == 0 && io_write_all(c, e->out.data, e->out.len) == -1) {
+        // a scraper going away only costs its own connection, one closing
+        // right away is an exporter checking the socket is alive
+        if (errno != EPIPE && errno != ECONNRESET) {
+            print_last_error("failed to serve metrics");
+        }
+        clear_last_error();
+    }
+
+    close(c);
+    return r;
+}
+
+static int
+loop(exporter *e, metrics_sink sink, char const *path, int fd)
+{
+    if (sink == METRICS_FILE && write_file(e, path) == -1) {
+        return -1;
+    }
+
+    while (!stopped) {
+        struct pollfd pfds[2] = {
+            {.fd = e->m.inotify_fd, .events = POLLIN},
+            {.fd = fd, .events = POLLIN},
+        };
+
+        int timeout = sink == METRICS_FILE ? METRICS_REFRESH_SEC * 1000 : -1;
+        int n       = poll(pfds, 2, timeout);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            set_last_error("poll failed: %s", strerror(errno));
+            return -1;
+        }
+
+        int changed = 0;
+        if (pfds[0].revents & POLLIN) {
+            int r = monitor_read(&e->m);
+            if (r == -1 || sync_series(e, r) == -1) {
+                return -1;
+            }
+
+            changed = r;
+            for (size_t i = 0; !changed && i < arr_len(e->m.list); ++i) {
+                changed = e->m.dirty[i];
+            }
+        }
+
+        if (sink == METRICS_FILE && (n == 0 || changed) &&
+            write_file(e, path) == -1) {
+            return -1;
+        }
+
+        if ((pfds[1].revents & POLLIN) && serve(e, fd) == -1) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int
+metrics_run(cfg *config, metrics_sink sink, char const *path)
+{
+    struct sigaction sa = {.sa_handler = on_signal};
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    exporter e = {
+        .fmt = sink == METRICS_FILE ? FORMAT_PROMETHEUS : FORMAT_OPENMETRICS,
+    };
+    if (monitor_init(&e.m, config) == -1) {
+        return -1;
+    }
+
+    int r  = -1;
+    int fd = -1;
+
+    e.series = series_new(e.m.list, NULL, 0, e.fmt);
+    if (e.series == NULL) {
+        goto end;
+    }
+    e.len = arr_len(e.m.list);
+
+    if (sink == METRICS_SOCKET && (fd = io_listen(path)) == -1) {
+        goto end;
+    }
+
+    r = loop(&e, sink, path, fd);
+
+    if (fd != -1) {
+        close(fd);
+        unlink(path);
+    }
+
+end:
+    if (e.series != NULL) {
+        series_free(e.series, e.len);
+    }
+    buf_free(&e.out);
+    monitor_free(&e.m);
+    return r;
+}
@@ -0,0 +1,43 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#ifndef SVC_METRICS_H
+#define SVC_METRICS_H
+
+#include "config.h"
+
+/**
+ * Where metrics_run() exports the metrics.
+ */
+typedef enum {
+    /**
+     * Rewrite a textfile in the Prometheus text format, as read by
+     * node_exporter's textfile collector.
+     */
+    METRICS_FILE,
+
+    /**
+     * Answer every connection on a Unix socket with the current metrics, in
+     * the OpenMetrics text format.
+     */
+    METRICS_SOCKET,
+} metrics_sink;
+
+/**
+ * Write the services' metrics once to fd, in the OpenMetrics text format.
+ *
+ * Returns -1 on error and set last_error.
+ */
+int metrics_print(cfg *config, int fd);
+
+/**
+ * Keep the services' metrics current with inotify and export them to path
+ * until interrupted. Only the series of services that changed are serialized
+ * again.
+ *
+ * Returns -1 on error and set last_error.
+ */
+int metrics_run(cfg *config, metrics_sink sink, char const *path);
+
+#endif
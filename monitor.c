@@ -0,0 +1,380 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#include "monitor.h"
+#include "err.h"
+#include "io.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+// runsv renames status, stat and pid into place, and down is created or
+// removed by hand in the service dir
+#define SUPERVISE_MASK (IN_MOVED_TO | IN_CLOSE_WRITE)
+#define SERVICE_MASK   (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)
+#define SVDIR_MASK     (SERVICE_MASK | IN_ONLYDIR)
+
+static int
+interesting(char const *name)
+{
+    return strcmp(name, "status") == 0 || strcmp(name, "stat") == 0 ||
+           strcmp(name, "pid") == 0 || strcmp(name, "down") == 0;
+}
+
+static int
+same(svc const *a, svc const *b)
+{
+    return a->status == b->status && a->want == b->want &&
+           a->is_down == b->is_down && a->is_paused == b->is_paused &&
+           a->pid == b->pid && a->since.tv_sec == b->since.tv_sec &&
+           a->since.tv_nsec == b->since.tv_nsec;
+}
+
+/**
+ * Copy the status of src into dst, both are the same service.
+ */
+static void
+update(svc *dst, svc const *src)
+{
+    dst->status    = src->status;
+    dst->want      = src->want;
+    dst->is_down   = src->is_down;
+    dst->is_paused = src->is_paused;
+    dst->pid       = src->pid;
+    dst->since     = src->since;
+}
+
+/**
+ * Record the transitions of the n services of list, then down the ones that
+ * started more than config allows. A failure is reported but doesn't stop
+ * the monitor.
+ */
+static void
+observe(monitor *m, svc **list, size_t n)
+{
+    if (m->hist == NULL) {
+        return;
+    } else if (hist_observe(m->hist, list, n) == -1) {
+        print_last_error("failed to record history");
+        return;
+    }
+
+    long limit = m->config->auto_down;
+    for (size_t i = 0; i < n && limit > 0; ++i) {
+        svc const *s = list[i];
+        // a service already down is left alone, downing it twice would
+        // only report it twice
+        if (s->restarts <= limit || s->want == SVC_WANT_DOWN ||
+            s->is_down == 1) {
+            continue;
+        }
+
+        svc_handle *h = svc_open(m->config, s->name);
+        if (h == NULL || svc_control(h, 'd') == -1 || svc_down(h) == -1) {
+            print_last_error("failed to down %s", s->name);
+        } else {
+            fprintf(stderr,
+                    "downed %s, it started %d times within an hour\n",
+                    s->name,
+                    s->restarts);
+        }
+        svc_close(h);
+    }
+}
+
+static int
+add_watch(monitor *m,
+          char const *name,
+          char const *sub,
+          uint32_t mask,
+          long i)
+{
+    char path[512] = {0};
+    if (io_snprintf(path, 512, "%s/%s%s", m->config->svdir, name, sub) ==
+        -1) {
+        wrap_last_error("io_snprintf failed");
+        return -1;
+    }
+
+    int wd = inotify_add_watch(m->inotify_fd, path, mask);
+    if (wd == -1) {
+        if (errno == ENOSPC) {
+            set_last_error("cannot watch %s: too many watches, see "
+                           "fs.inotify.max_user_watches",
+                           path);
+        } else {
+            set_last_error("cannot watch %s: %s", path, strerror(errno));
+        }
+        return -1;
+    }
+
+    if (wd >= m->wds_len) {
+        int len   = wd + 1 > m->wds_len * 2 ? wd + 1 : m->wds_len * 2;
+        long *wds = realloc(m->wds, sizeof(*wds) * len);
+        if (wds == NULL) {
+            set_last_error("realloc failed: %s", strerror(errno));
+            return -1;
+        }
+
+        for (int j = m->wds_len; j < len; ++j) {
+            wds[j] = -1;
+        }
+        m->wds     = wds;
+        m->wds_len = len;
+    }
+
+    m->wds[wd] = i;
+    return 0;
+}
+
+/**
+ * Release what a scan of m built, the svdir fd and history are kept.
+ */
+static void
+drop(monitor *m)
+{
+    if (m->inotify_fd != -1) {
+        close(m->inotify_fd);
+    }
+    if (m->list != NULL) {
+        arr_free((arr_ptr)m->list);
+    }
+    arena_free(&m->arena);
+    free(m->dirty);
+    free(m->wds);
+}
+
+/**
+ * Returns 1 if runsv created the supervise dir of the service name, a service
+ * just linked has none yet.
+ */
+static int
+supervised(monitor const *m, char const *name)
+{
+    char path[512] = {0};
+    return io_snprintf(path, sizeof(path), "%s/supervise", name) != -1 &&
+           io_existsat(m->svdir_fd, path) == 1;
+}
+
+/**
+ * Scan every service into next and watch them.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+build(monitor *next)
+{
+    next->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (next->inotify_fd == -1) {
+        set_last_error("inotify_init1 failed: %s", strerror(errno));
+        return -1;
+    }
+
+    // watch first, a change happening during the scan is then seen twice
+    // rather than never
+    char const *svdir = next->config->svdir;
+    next->svdir_wd = inotify_add_watch(next->inotify_fd, svdir, SVDIR_MASK);
+    if (next->svdir_wd == -1) {
+        set_last_error("cannot watch %s: %s", svdir, strerror(errno));
+        return -1;
+    }
+
+    if ((next->list = svc_list(next->config, &next->arena)) == NULL) {
+        return -1;
+    }
+
+    size_t n = arr_len(next->list);
+    if ((next->dirty = malloc(n + 1)) == NULL) {
+        set_last_error("malloc failed: %s", strerror(errno));
+        return -1;
+    }
+    memset(next->dirty, 1, n);
+
+    for (size_t i = 0; i < n; ++i) {
+        svc const *s = next->list[i];
+        if (add_watch(next, s->name, "", SERVICE_MASK, i) == -1) {
+            return -1;
+        } else if (s->status == SVC_UNKNOWN && !supervised(next, s->name)) {
+            // its creation in the service dir brings the service in with the
+            // next scan
+            continue;
+        } else if (add_watch(
+                       next, s->name, "/supervise", SUPERVISE_MASK, i) ==
+                   -1) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Scan everything again and watch the result. On error the current watches
+ * and services are kept, to be scanned again on the next event.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+scan(monitor *m)
+{
+    monitor next = {
+        .config     = m->config,
+        .svdir_fd   = m->svdir_fd,
+        .inotify_fd = -1,
+        .svdir_wd   = -1,
+        .hist       = m->hist,
+    };
+
+    if (build(&next) == -1) {
+        drop(&next);
+        m->rescan = 1;
+        return -1;
+    }
+
+    drop(m);
+    *m = next;
+    observe(m, m->list, arr_len(m->list));
+    return 0;
+}
+
+int
+monitor_init(monitor *m, cfg *config)
+{
+    *m = (monitor){
+        .config     = config,
+        .inotify_fd = -1,
+        .svdir_wd   = -1,
+    };
+
+    m->svdir_fd = open(config->svdir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (m->svdir_fd == -1) {
+        set_last_error(
+            "failed to open dir '%s': %s", config->svdir, strerror(errno));
+        return -1;
+    }
+
+    // the services are watched even without a history
+    if ((m->hist = hist_open(config, 1)) == NULL) {
+        clear_last_error();
+    }
+
+    if (scan(m) == -1) {
+        monitor_free(m);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Scan the services again, a failure is reported and the last services are
+ * kept until the next event.
+ *
+ * Returns 1 if the list was scanned again, otherwise 0.
+ */
+static int
+rescan_or_keep(monitor *m)
+{
+    if (scan(m) == -1) {
+        print_last_error("failed to scan the services again, keeping the "
+                         "last ones");
+        clear_last_error();
+        return 0;
+    }
+
+    return 1;
+}
+
+int
+monitor_read(monitor *m)
+{
+    size_t n = arr_len(m->list);
+    memset(m->dirty, 0, n);
+
+    int rescan = 0;
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    while (1) {
+        ssize_t len = read(m->inotify_fd, buf, sizeof(buf));
+        if (len == -1) {
+            if (errno == EAGAIN) {
+                break;
+            } else if (errno == EINTR) {
+                continue;
+            }
+            set_last_error("failed to read inotify: %s", strerror(errno));
+            return -1;
+        }
+
+        struct inotify_event const *e = NULL;
+        for (char *p = buf; p < buf + len; p += sizeof(*e) + e->len) {
+            e = (struct inotify_event const *)p;
+
+            if (e->mask & IN_Q_OVERFLOW) {
+                rescan = 1;
+            } else if (e->wd == m->svdir_wd) {
+                // dot entries are never listed, our own files live there
+                rescan |= e->len > 0 && e->name[0] != '.';
+            } else if (e->wd < m->wds_len && m->wds[e->wd] != -1) {
+                if (e->mask & IN_IGNORED) {
+                    // a watched dir went away
+                    rescan = 1;
+                } else if (e->len > 0 && strcmp(e->name, "supervise") == 0) {
+                    // runsv started a service just linked
+                    rescan = 1;
+                } else if (e->len > 0 && interesting(e->name)) {
+                    m->dirty[m->wds[e->wd]] = 1;
+                }
+            }
+        }
+    }
+
+    // the services changed meanwhile are still read when the scan fails
+    if ((rescan || m->rescan) && rescan_or_keep(m) == 1) {
+        return 1;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        if (!m->dirty[i]) {
+            continue;
+        }
+
+        svc *s = svc_read(m->svdir_fd, m->list[i]->name);
+        if (s == NULL) {
+            // most likely removed under our feet, the svdir event follows
+            if (rescan_or_keep(m) == 1) {
+                return 1;
+            }
+            m->dirty[i] = 0;
+            continue;
+        }
+
+        if (same(s, m->list[i])) {
+            m->dirty[i] = 0;
+        } else {
+            update(m->list[i], s);
+            observe(m, &m->list[i], 1);
+        }
+        free(s);
+    }
+
+    return 0;
+}
+
+void
+monitor_free(monitor *m)
+{
+    drop(m);
+    if (m->svdir_fd != -1) {
+        close(m->svdir_fd);
+    }
+    hist_close(m->hist);
+
+    *m = (monitor){.inotify_fd = -1, .svdir_fd = -1};
+}
@@ -0,0 +1,78 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#ifndef SVC_MONITOR_H
+#define SVC_MONITOR_H
+
+#include "arr.h"
+#include "config.h"
+#include "history.h"
+#include "service.h"
+
+/**
+ * Keeps the list of services current using inotify, only the services whose
+ * supervise dir or down file changed are read again.
+ */
+typedef struct {
+    cfg *config;
+    int svdir_fd;
+    int inotify_fd;
+    int svdir_wd;
+
+    /**
+     * The current services, sorted like svc_list() and allocated in arena.
+     * Changed services are updated in place.
+     */
+    arr_of(svc *) list;
+    arena arena;
+
+    /**
+     * Set for every service of list that changed during the last
+     * monitor_read().
+     */
+    char *dirty;
+
+    /**
+     * Index in list of every watch descriptor, -1 if unknown.
+     */
+    long *wds;
+    int wds_len;
+
+    /**
+     * Set when the last scan failed, the next monitor_read() scans again.
+     */
+    int rescan;
+
+    /**
+     * Fed with every status read, NULL when it can't be opened. The services
+     * starting too often are downed when config asks for it.
+     */
+    hist *hist;
+} monitor;
+
+/**
+ * Scan the services and start watching them.
+ *
+ * Returns -1 on error and set last_error.
+ */
+int monitor_init(monitor *m, cfg *config);
+
+/**
+ * Read the pending inotify events, meant to be called when m->inotify_fd is
+ * readable. Services which really changed are read again, recorded into the
+ * history and flagged in m->dirty. If the services dir itself changed, the
+ * whole list is scanned again: a service runsv didn't start yet is listed
+ * unknown, and a scan failing is reported while the last list is kept.
+ *
+ * Returns 1 if the list was scanned again, otherwise 0, returns -1 on error
+ * and set last_error.
+ */
+int monitor_read(monitor *m);
+
+/**
+ * Stop watching and release the services.
+ */
+void monitor_free(monitor *m);
+
+#endif
@@ -0,0 +1,106 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#include "pool.h"
+#include "err.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+typedef struct {
+    pthread_mutex_t lock;
+    pool_fn fn;
+    void *ctx;
+    size_t n;
+    size_t next;
+    int failed;
+    char err[512];
+} pool;
+
+static void *
+work(void *arg)
+{
+    pool *p = arg;
+
+    while (1) {
+        pthread_mutex_lock(&p->lock);
+        if (p->failed || p->next >= p->n) {
+            pthread_mutex_unlock(&p->lock);
+            break;
+        }
+        size_t i = p->next++;
+        pthread_mutex_unlock(&p->lock);
+
+        if (p->fn(p->ctx, i) < 0) {
+            pthread_mutex_lock(&p->lock);
+            if (!p->failed) {
+                p->failed = 1;
+                snprintf(p->err, sizeof(p->err), "%s", get_last_error());
+            }
+            pthread_mutex_unlock(&p->lock);
+        }
+    }
+
+    return NULL;
+}
+
+long
+pool_cpus(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n < 1 ? 1 : n;
+}
+
+int
+pool_run(long jobs, size_t n, pool_fn fn, void *ctx)
+{
+    if (jobs <= 1 || n <= 1) {
+        for (size_t i = 0; i < n; ++i) {
+            if (fn(ctx, i) < 0) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    if ((size_t)jobs > n) {
+        jobs = n;
+    }
+
+    pool p = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .fn   = fn,
+        .ctx  = ctx,
+        .n    = n,
+    };
+
+    pthread_t *threads = calloc(jobs - 1, sizeof(*threads));
+    long started       = 0;
+
+    // a failed pthread_create only means less workers, the calling thread
+    // always takes part
+    if (threads != NULL) {
+        while (started < jobs - 1 &&
+               pthread_create(&threads[started], NULL, work, &p) == 0) {
+            ++started;
+        }
+    }
+
+    work(&p);
+
+    for (long i = 0; i < started; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    free(threads);
+    pthread_mutex_destroy(&p.lock);
+
+    if (p.failed) {
+        set_last_error("%s", p.err);
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,33 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#ifndef SVC_POOL_H
+#define SVC_POOL_H
+
+#include <stddef.h>
+
+/**
+ * Function run by the pool for the item at index i.
+ *
+ * Returns -1 on error and set last_error.
+ */
+typedef int (*pool_fn)(void *ctx, size_t i);
+
+/**
+ * Returns the number of online CPUs, at least 1.
+ */
+long pool_cpus(void);
+
+/**
+ * Call fn on every index in [0, n) using at most jobs threads, the calling
+ * thread included. Indexes are handed out in increasing order, so callers can
+ * fill preallocated slots and keep their order. When jobs is 1 or less
+ * everything runs on the calling thread. No more indexes are handed out once
+ * a call failed.
+ *
+ * Returns -1 if any call failed and set last_error to the first error.
+ */
+int pool_run(long jobs, size_t n, pool_fn fn, void *ctx);
+
+#endif
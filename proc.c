@@ -0,0 +1,325 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#include "proc.h"
+#include "err.h"
+#include "io.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// the stat fields svc needs end with rss, the 24th, well within this
+#define PROC_STAT_LEN 512
+
+// processes read per io_uring batch, each keeps a fd open until it's read
+#define PROC_CHUNK 256
+
+// room for "<pid>/stat" and its NUL
+#define PROC_PATH_LEN 24
+
+int
+proc_table_init(proc_table *t)
+{
+    *t = (proc_table){0};
+
+    t->fd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (t->fd == -1) {
+        set_last_error("failed to open /proc: %s", strerror(errno));
+        return -1;
+    }
+
+    t->bufs  = malloc(PROC_CHUNK * (PROC_STAT_LEN + 1));
+    t->paths = malloc(PROC_CHUNK * PROC_PATH_LEN);
+    if (t->bufs == NULL || t->paths == NULL) {
+        set_last_error("malloc failed: %s", strerror(errno));
+        proc_table_free(t);
+        return -1;
+    }
+
+    // read sequentially without io_uring
+    t->u = uring_open();
+    return 0;
+}
+
+void
+proc_table_free(proc_table *t)
+{
+    if (t->u != NULL) {
+        uring_close(t->u);
+    }
+    if (t->fd > 0) {
+        close(t->fd);
+    }
+    free(t->procs);
+    free(t->slots);
+    free(t->path);
+    free(t->bufs);
+    free(t->paths);
+    *t = (proc_table){0};
+}
+
+/**
+ * Parse the first len bytes of a stat line into p, the comm between
+ * parentheses may hold anything so the fields are found after its last one.
+ *
+ * Returns -1 if buf isn't a stat line holding every field needed.
+ */
+static int
+parse_stat(char *buf, size_t len, proc_entry *p)
+{
+    buf[len]      = '\0';
+    char const *s = strrchr(buf, ')');
+    if (s == NULL || s[1] != ' ' || s[2] == '\0') {
+        return -1;
+    }
+
+    // skip the state, the 3rd field
+    s += 3;
+
+    unsigned long long f[25] = {0};
+    for (int i = 4; i <= 24; ++i) {
+        char *end = NULL;
+        f[i]      = strtoull(s, &end, 10);
+        // a number cut by the end of buf isn't complete
+        if (end == s || *end != ' ') {
+            return -1;
+        }
+        s = end;
+    }
+
+    p->ppid    = (pid_t)f[4];
+    p->ticks   = f[14] + f[15] + f[16] + f[17];
+    p->threads = (long)f[20];
+    p->rss     = f[24];
+    return 0;
+}
+
+/**
+ * Add the stat line of pid read into buf, res being what the read returned, to
+ * t. Processes gone since the listing are skipped.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+add_proc(proc_table *t, pid_t pid, char *buf, int res)
+{
+    proc_entry p = {.pid = pid, .owner = -2};
+    if (res <= 0 || parse_stat(buf, res, &p) == -1) {
+        return 0;
+    }
+
+    if (t->procs_len == t->procs_cap) {
+        size_t cap      = t->procs_cap == 0 ? 512 : t->procs_cap * 2;
+        proc_entry *ps  = realloc(t->procs, sizeof(*ps) * cap);
+        size_t *path    = realloc(t->path, sizeof(*path) * cap);
+        if (ps != NULL) {
+            t->procs = ps;
+        }
+        if (path != NULL) {
+            t->path = path;
+        }
+        if (ps == NULL || path == NULL) {
+            set_last_error("realloc failed: %s", strerror(errno));
+            return -1;
+        }
+        t->procs_cap = cap;
+    }
+
+    t->procs[t->procs_len++] = p;
+    return 0;
+}
+
+/**
+ * Read the stat lines of the pids of names, from b to e, into t.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+read_chunk(proc_table *t, arr_of(char *) names, size_t b, size_t e)
+{
+    uring_req reqs[PROC_CHUNK] = {{0}};
+    for (size_t i = b; i < e; ++i) {
+        char *path = t->paths + (i - b) * PROC_PATH_LEN;
+        char *buf  = t->bufs + (i - b) * (PROC_STAT_LEN + 1);
+        if (io_snprintf(path, PROC_PATH_LEN, "%s/stat", names[i]) == -1) {
+            return -1;
+        }
+
+        if (t->u == NULL) {
+            int n = io_readat(t->fd, path, buf, PROC_STAT_LEN);
+            // gone since the listing
+            reqs[i - b].res = n == -1 ? -errno : n;
+            clear_last_error();
+            continue;
+        }
+
+        reqs[i - b] = (uring_req){
+            .path = path,
+            .buf  = buf,
+            .len  = PROC_STAT_LEN,
+        };
+    }
+
+    if (t->u != NULL && uring_batch(t->u, t->fd, reqs, e - b) == -1) {
+        wrap_last_error("io_uring batch failed");
+        return -1;
+    }
+
+    for (size_t i = b; i < e; ++i) {
+        char *buf = t->bufs + (i - b) * (PROC_STAT_LEN + 1);
+        if (add_proc(t, atoi(names[i]), buf, reqs[i - b].res) == -1) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static size_t
+slot_of(proc_table const *t, pid_t pid)
+{
+    // Fibonacci hashing spreads the mostly consecutive pids
+    return ((uint32_t)pid * 2654435769u) & (t->slots_cap - 1);
+}
+
+/**
+ * Index the pids of t->procs.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+index_procs(proc_table *t)
+{
+    size_t cap = 1024;
+    while (cap < t->procs_len * 2) {
+        cap *= 2;
+    }
+
+    if (cap != t->slots_cap) {
+        uint32_t *slots = realloc(t->slots, sizeof(*slots) * cap);
+        if (slots == NULL) {
+            set_last_error("realloc failed: %s", strerror(errno));
+            return -1;
+        }
+        t->slots     = slots;
+        t->slots_cap = cap;
+    }
+    memset(t->slots, 0, sizeof(*t->slots) * t->slots_cap);
+
+    for (size_t i = 0; i < t->procs_len; ++i) {
+        size_t s = slot_of(t, t->procs[i].pid);
+        while (t->slots[s] != 0) {
+            s = (s + 1) & (t->slots_cap - 1);
+        }
+        t->slots[s] = i + 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Returns the index of pid in t->procs, or -1 if it isn't there.
+ */
+static long
+find(proc_table const *t, pid_t pid)
+{
+    for (size_t s = slot_of(t, pid); t->slots[s] != 0;
+         s     = (s + 1) & (t->slots_cap - 1)) {
+        if (t->procs[t->slots[s] - 1].pid == pid) {
+            return t->slots[s] - 1;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Returns the owner of the process i, climbing its ancestors until one whose
+ * owner is known. Every process on the way is handed the owner found, so that
+ * each process is climbed through once per sample.
+ */
+static long
+owner_of(proc_table *t, size_t i)
+{
+    long owner   = -1;
+    size_t depth = 0;
+    for (long j = i; j != -1 && depth < t->procs_len;
+         j      = find(t, t->procs[j].ppid)) {
+        if (t->procs[j].owner != -2) {
+            owner = t->procs[j].owner;
+            break;
+        }
+        t->path[depth++] = j;
+    }
+
+    for (size_t d = 0; d < depth; ++d) {
+        t->procs[t->path[d]].owner = owner;
+    }
+
+    return owner;
+}
+
+int
+proc_sample(proc_table *t, pid_t const *roots, size_t n, proc_usage *usage)
+{
+    arena a              = {0};
+    arr_of(char *) names = io_list_dirs("/proc", &a);
+    if (names == NULL) {
+        wrap_last_error("failed to list /proc");
+        arena_free(&a);
+        return -1;
+    }
+
+    int r        = -1;
+    t->procs_len = 0;
+    for (size_t b = 0; b < arr_len(names);) {
+        // the other dirs of /proc sort after the pids
+        size_t e = b;
+        while (e < arr_len(names) && e - b < PROC_CHUNK &&
+               names[e][0] >= '0' && names[e][0] <= '9') {
+            ++e;
+        }
+        if (e == b) {
+            break;
+        } else if (read_chunk(t, names, b, e) == -1) {
+            goto end;
+        }
+        b = e;
+    }
+
+    if (t->procs_len > 0 && index_procs(t) == -1) {
+        goto end;
+    }
+
+    for (size_t k = 0; k < n; ++k) {
+        usage[k] = (proc_usage){0};
+        long i   = roots[k] > 0 && t->procs_len > 0 ? find(t, roots[k]) : -1;
+        if (i != -1) {
+            t->procs[i].owner = k;
+        }
+    }
+
+    long page = sysconf(_SC_PAGESIZE);
+    for (size_t i = 0; i < t->procs_len; ++i) {
+        long k = owner_of(t, i);
+        if (k == -1) {
+            continue;
+        }
+
+        proc_entry const *p = &t->procs[i];
+        usage[k].ticks += p->ticks;
+        usage[k].rss += p->rss * page;
+        usage[k].threads += p->threads;
+        ++usage[k].procs;
+    }
+    r = 0;
+
+end:
+    arr_free((arr_ptr)names);
+    arena_free(&a);
+    return r;
+}
@@ -0,0 +1,103 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#ifndef SVC_PROC_H
+#define SVC_PROC_H
+
+#include "uring.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * Resources used by a process tree.
+ */
+typedef struct {
+    /**
+     * CPU time in clock ticks, user and system, the children the tree already
+     * waited for included so that it only grows while the tree lives.
+     */
+    unsigned long long ticks;
+
+    /**
+     * Resident memory in bytes.
+     */
+    unsigned long long rss;
+
+    long procs;
+    long threads;
+} proc_usage;
+
+/**
+ * A process read from /proc/<pid>/stat.
+ */
+typedef struct {
+    pid_t pid;
+    pid_t ppid;
+    unsigned long long ticks;
+    unsigned long long rss;
+    long threads;
+
+    /**
+     * Index of the root the process belongs to, -1 for none and -2 until
+     * it's known.
+     */
+    long owner;
+} proc_entry;
+
+/**
+ * The processes of the last sample, its buffers are reused by the next one.
+ */
+typedef struct {
+    /**
+     * /proc and the io_uring reading it, NULL when not available.
+     */
+    int fd;
+    uring *u;
+
+    proc_entry *procs;
+    size_t procs_len;
+    size_t procs_cap;
+
+    /**
+     * Index of every pid of procs plus 1, 0 for an empty slot, slots_cap is a
+     * power of 2.
+     */
+    uint32_t *slots;
+    size_t slots_cap;
+
+    /**
+     * Processes met while climbing to an owner, and the stat lines of a chunk.
+     */
+    size_t *path;
+    char *bufs;
+    char *paths;
+} proc_table;
+
+/**
+ * Open /proc for sampling, t must be freed upon usage with proc_table_free().
+ *
+ * Returns -1 on error and set last_error.
+ */
+int proc_table_init(proc_table *t);
+
+/**
+ * Walk /proc once and sum into usage[i] the resources of the process tree
+ * rooted at roots[i], for the n roots. A process belongs to its closest
+ * ancestor that is a root, roots of 0 or less and the ones that aren't
+ * running get a zeroed usage.
+ *
+ * Returns -1 on error and set last_error.
+ */
+int proc_sample(proc_table *t,
+                pid_t const *roots,
+                size_t n,
+                proc_usage *usage);
+
+/**
+ * Release what t holds.
+ */
+void proc_table_free(proc_table *t);
+
+#endif
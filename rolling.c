@@ -0,0 +1,375 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#include "rolling.h"
+#include "err.h"
+#include "io.h"
+#include "latency.h"
+#include "service.h"
+#include "waiter.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// a check script failing is run again after this many seconds
+#define ROLLING_CHECK_EVERY 0.1
+
+// a check script running is polled that often for its exit
+#define ROLLING_CHECK_POLL 0.01
+
+/**
+ * A service of the wave being restarted.
+ */
+typedef struct {
+    /**
+     * 1 once its check script passed.
+     */
+    int checked;
+
+    /**
+     * When it started running, it mustn't change while the wave settles.
+     */
+    struct timespec since;
+} rolling_svc;
+
+static double
+elapsed(struct timespec const *start)
+{
+    struct timespec now = {0};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) +
+           (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void
+sleep_for(double seconds)
+{
+    struct timespec ts = {
+        .tv_sec  = (time_t)seconds,
+        .tv_nsec = (long)((seconds - (time_t)seconds) * 1e9),
+    };
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+    }
+}
+
+/**
+ * Run the check script of the service name from its dir, like runit's sv
+ * does, its output is discarded. A script still running after timeout
+ * seconds is killed, with what it started, and fails.
+ *
+ * Returns 1 if it passed or if there's none, 0 if it failed, -1 on error and
+ * set last_error.
+ */
+static int
+check(cfg *config, char const *name, double timeout)
+{
+    char dir[PATH_MAX]  = {0};
+    char path[PATH_MAX] = {0};
+    if (io_snprintf(dir, sizeof(dir), "%s/%s", config->svdir, name) == -1 ||
+        io_snprintf(path, sizeof(path), "%s/check", dir) == -1) {
+        wrap_last_error("io_snprintf failed");
+        return -1;
+    } else if (access(path, X_OK) == -1) {
+        return 1;
+    }
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        set_last_error("fork failed: %s", strerror(errno));
+        return -1;
+    } else if (pid == 0) {
+        // its own group, so that a timeout kills what it started too
+        int null = open("/dev/null", O_WRONLY);
+        if (setpgid(0, 0) == -1 || null == -1 ||
+            dup2(null, STDOUT_FILENO) == -1 || chdir(dir) == -1) {
+            _exit(127);
+        }
+        execl("./check", "./check", (char *)NULL);
+        _exit(127);
+    }
+
+    struct timespec start = {0};
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int status = 0;
+    pid_t r    = 0;
+    while ((r = waitpid(pid, &status, WNOHANG)) == 0 &&
+           elapsed(&start) < timeout) {
+        sleep_for(ROLLING_CHECK_POLL);
+    }
+
+    if (r == 0) {
+        kill(-pid, SIGKILL);
+        kill(pid, SIGKILL);
+        print_last_error("%s check still running after %.3fs, killed",
+                         name,
+                         elapsed(&start));
+    }
+    while (r <= 0 && (r = waitpid(pid, &status, 0)) == -1) {
+        if (errno != EINTR) {
+            set_last_error("waitpid failed: %s", strerror(errno));
+            return -1;
+        }
+    }
+
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/**
+ * Write d then u to the control of the services of ws, like restart does,
+ * once they're watched on ifd, the ones failing are reported and left out of
+ * ws.
+ *
+ * Returns the number of services restarted, the first ones of ws.
+ */
+static size_t
+restart(cfg *config, int ifd, char *const *names, size_t k, waiter *ws)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < k; ++i) {
+        clear_last_error();
+        ws[n]         = (waiter){.name = names[i], .status = SVC_RUNNING};
+        svc_handle *h = svc_open(config, names[i]);
+        if (h == NULL || waiter_prepare(config, ifd, &ws[n]) == -1 ||
+            clock_gettime(CLOCK_REALTIME, &ws[n].written) == -1 ||
+            svc_control(h, 'd') == -1 || svc_control(h, 'u') == -1) {
+            print_last_error("failed to restart %s", names[i]);
+            svc_close(h);
+            continue;
+        }
+
+        svc_close(h);
+        ++n;
+    }
+
+    return n;
+}
+
+/**
+ * Run the check scripts of the services of ws that reached their status until
+ * they all pass, or until timeout seconds elapsed since start, a script is
+ * given the time left.
+ *
+ * Returns the number of services that failed, -1 on error and set
+ * last_error.
+ */
+static long
+check_all(cfg *config,
+          waiter *ws,
+          rolling_svc *rs,
+          size_t n,
+          struct timespec const *start,
+          double timeout)
+{
+    for (;;) {
+        size_t pending = 0;
+        for (size_t i = 0; i < n; ++i) {
+            double left = timeout - elapsed(start);
+            if (ws[i].reached && !rs[i].checked &&
+                (rs[i].checked = check(config, ws[i].name, left)) == -1) {
+                return -1;
+            }
+            pending += ws[i].reached && !rs[i].checked;
+        }
+
+        if (pending == 0 || elapsed(start) >= timeout) {
+            break;
+        }
+        sleep_for(ROLLING_CHECK_EVERY);
+    }
+
+    long failed = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (ws[i].reached && !rs[i].checked) {
+            print_last_error("%s failed its check", ws[i].name);
+            ++failed;
+        }
+    }
+
+    return failed;
+}
+
+/**
+ * Read the start time of the services of ws into rs, or check they still
+ * have the one read before when again is 1.
+ *
+ * Returns the number of services that aren't running, or not since the
+ * same time, -1 on error and set last_error.
+ */
+static long
+still_running(cfg *config, waiter *ws, rolling_svc *rs, size_t n, int again)
+{
+    int fd = cfg_svdir_fd(config);
+    if (fd == -1) {
+        return -1;
+    }
+
+    long failed = 0;
+    for (size_t i = 0; i < n; ++i) {
+        svc *s = svc_read(fd, ws[i].name);
+        if (s == NULL) {
+            return -1;
+        }
+
+        int same = s->since.tv_sec == rs[i].since.tv_sec &&
+                   s->since.tv_nsec == rs[i].since.tv_nsec;
+        if (s->status != SVC_RUNNING) {
+            print_last_error("%s didn't stay running, it's %s",
+                             ws[i].name,
+                             svc_status_str(s->status));
+            ++failed;
+        } else if (again && !same) {
+            print_last_error("%s restarted while settling", ws[i].name);
+            ++failed;
+        }
+        rs[i].since = s->since;
+        free(s);
+    }
+
+    return failed;
+}
+
+/**
+ * Restart the k services of names and wait for them to be healthy, watching
+ * them on ifd.
+ *
+ * Returns the number of services that failed, -1 on error and set
+ * last_error.
+ */
+static long
+wave(cfg *config,
+     char *const *names,
+     size_t k,
+     int ifd,
+     waiter *ws,
+     rolling_svc *rs,
+     struct timespec const *start)
+{
+    double timeout = config->wait > 0 ? config->wait : ROLLING_WAIT;
+    size_t n       = restart(config, ifd, names, k, ws);
+    long failed    = k - n;
+    memset(rs, 0, sizeof(*rs) * k);
+
+    clear_last_error();
+    if (n > 0 && waiter_run(config, ifd, ws, n, timeout) == -1) {
+        return -1;
+    }
+    if (config->timing && lat_save(config, ws, n) == -1) {
+        print_last_error("failed to record latencies");
+    }
+    for (size_t i = 0; i < n; ++i) {
+        if (ws[i].reached) {
+            printf("%s running after %.3fs\n", ws[i].name, ws[i].latency);
+        } else {
+            print_last_error("timed out waiting for %s to be running",
+                             ws[i].name);
+            ++failed;
+        }
+    }
+    fflush(stdout);
+
+    long r = check_all(config, ws, rs, n, start, timeout);
+    if (r == -1) {
+        return -1;
+    } else if (failed + r > 0) {
+        return failed + r;
+    }
+
+    // the services must keep running from the same start through the
+    // settle time, a crash restarted by runsv meanwhile changes it
+    if ((r = still_running(config, ws, rs, n, 0)) != 0) {
+        return r;
+    } else if (config->settle > 0) {
+        sleep_for(config->settle);
+        if ((r = still_running(config, ws, rs, n, 1)) != 0) {
+            return r;
+        }
+
+        // the checks get the wave's time again once settled
+        struct timespec settled = {0};
+        clock_gettime(CLOCK_MONOTONIC, &settled);
+        for (size_t i = 0; i < n; ++i) {
+            double left = timeout - elapsed(&settled);
+            if ((r = check(config, ws[i].name, left)) == -1) {
+                return -1;
+            } else if (r == 0) {
+                print_last_error("%s failed its check after settling",
+                                 ws[i].name);
+                ++failed;
+            }
+        }
+    }
+
+    return failed;
+}
+
+long
+rolling_run(cfg *config, char *const *names, size_t n)
+{
+    size_t batch    = config->batch > 0 ? config->batch : 1;
+    size_t waves    = (n + batch - 1) / batch;
+    waiter *ws      = calloc(batch, sizeof(*ws));
+    rolling_svc *rs = calloc(batch, sizeof(*rs));
+    if (ws == NULL || rs == NULL) {
+        set_last_error("calloc failed: %s", strerror(errno));
+        free(ws);
+        free(rs);
+        return -1;
+    }
+
+    // a single instance for every wave, closing it is slow
+    int ifd = waiter_init();
+    if (ifd == -1) {
+        free(ws);
+        free(rs);
+        return -1;
+    }
+
+    struct timespec all = {0};
+    clock_gettime(CLOCK_MONOTONIC, &all);
+
+    long failed = 0;
+    for (size_t w = 0, i = 0; i < n; ++w, i += batch) {
+        size_t k              = n - i < batch ? n - i : batch;
+        struct timespec start = {0};
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        long r = wave(config, names + i, k, ifd, ws, rs, &start);
+        if (r == -1) {
+            failed = -1;
+            break;
+        } else if (r > 0) {
+            // the services left are as they were, capacity stays
+            failed = r + (n - i - k);
+            print_last_error("wave %zu of %zu failed after %.3fs, stopped "
+                             "with %zu services not restarted",
+                             w + 1,
+                             waves,
+                             elapsed(&start),
+                             n - i - k);
+            break;
+        }
+
+        printf(
+            "wave %zu of %zu done in %.3fs\n", w + 1, waves, elapsed(&start));
+        fflush(stdout);
+    }
+
+    if (failed == 0) {
+        printf("restarted %zu services in %.3fs\n", n, elapsed(&all));
+    }
+
+    fflush(stdout);
+    close(ifd);
+    free(ws);
+    free(rs);
+    return failed;
+}
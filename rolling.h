@@ -0,0 +1,29 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#ifndef SVC_ROLLING_H
+#define SVC_ROLLING_H
+
+#include "config.h"
+#include <stddef.h>
+
+/**
+ * Seconds a wave waits for its services to run and pass their check when
+ * config->wait isn't set.
+ */
+#define ROLLING_WAIT 60
+
+/**
+ * Restart the n services of names in waves of config->batch services: a wave
+ * is restarted, then each of its services has to be seen running and pass
+ * its check script when it has one within config->wait seconds, and still be
+ * so config->settle seconds later before the next wave starts. The waves are
+ * timed on stdout, the first one failing stops the restart.
+ *
+ * Returns the number of services that failed or weren't restarted because of
+ * them, returns -1 on error and set last_error.
+ */
+long rolling_run(cfg *config, char *const *names, size_t n);
+
+#endif
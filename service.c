@@ -5,16 +5,27 @@
 #include "service.h"
 #include "err.h"
 #include "io.h"
+#include "pool.h"
+#include "stats.h"
+#include "tai.h"
+#include "uring.h"
 #include <errno.h>
 #include <fcntl.h>
+#include <fnmatch.h>
 #include <inttypes.h>
+#include <linux/openat2.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <time.h>
 #include <unistd.h>
 
+#define SVC_STATUS_LEN 20
+
 char const *
 svc_status_str(svc_status status)
 {
@@ -26,6 +37,61 @@ svc_status_str(svc_status status)
     }
 }
 
+char const *
+svc_want_str(svc_want want)
+{
+    switch (want) {
+    case SVC_WANT_UP:   return "up";
+    case SVC_WANT_DOWN: return "down";
+    default:            return "none";
+    }
+}
+
+int
+svc_time_fmt(svc_time *t,
+             struct timespec const *since,
+             struct timespec const *now)
+{
+    // a service runsv didn't start yet has no change time
+    if (since->tv_sec == 0 && since->tv_nsec == 0) {
+        strcpy(*t, "-");
+        return 0;
+    }
+
+    unsigned long long elapsed = 0;
+    if (now->tv_sec > since->tv_sec) {
+        elapsed = now->tv_sec - since->tv_sec;
+    }
+
+    unsigned long long d = elapsed / 86400;
+    elapsed %= 86400;
+    unsigned int h = elapsed / 3600;
+    elapsed %= 3600;
+    unsigned int m = elapsed / 60;
+    unsigned int s = elapsed % 60;
+
+    int r = 0;
+    if (d > 0) {
+        r = io_snprintf(*t,
+                        sizeof(*t) / sizeof(**t),
+                        "%llud %02u:%02u:%02u",
+                        d,
+                        h,
+                        m,
+                        s);
+    } else {
+        r = io_snprintf(
+            *t, sizeof(*t) / sizeof(**t), "%02u:%02u:%02u", h, m, s);
+    }
+
+    if (r == -1) {
+        wrap_last_error("io_snprintf failed");
+        return -1;
+    }
+
+    return 0;
+}
+
 static svc_status
 svc_status_from_str(char const *s)
 {
@@ -74,185 +140,1116 @@ get_pid(int fd)
 }
 
 static int
-get_time(int fd, svc_time *t)
+get_since(int fd, struct timespec *since)
 {
     struct stat sb = {0};
+    stats_io(1, 0, 0);
     if (fstatat(fd, "supervise/stat", &sb, 0) == -1) {
         set_last_error("stat failed: %s", strerror(errno));
         return -1;
     }
 
-    time_t now = time(NULL);
-    if (now == ((time_t)-1)) {
-        set_last_error("failed to get time: %s", strerror(errno));
+    *since = sb.st_mtim;
+    return 0;
+}
+
+/**
+ * Fill s from the text files runsv maintains next to supervise/status, this is
+ * what we fall back to when the binary record is missing.
+ */
+static int
+get_text(int fd, svc *s)
+{
+    int status = get_status(fd);
+    if (status == -1) {
+        wrap_last_error("failed to get status");
         return -1;
     }
 
-    unsigned long mtime = difftime(now, sb.st_mtime);
-    unsigned int h      = mtime / 3600;
-    mtime %= 3600;
-    unsigned int m = mtime / 60;
-    unsigned int s = mtime % 60;
+    pid_t pid = get_pid(fd);
+    if (pid == -1) {
+        wrap_last_error("failed to get pid");
+        return -1;
+    }
 
-    if (io_snprintf(*t, sizeof(*t) / sizeof(**t), "%02d:%02d:%02d", h, m, s) ==
-        -1) {
-        wrap_last_error("io_snprintf failed");
+    if (get_since(fd, &s->since) == -1) {
+        wrap_last_error("failed to get time");
         return -1;
     }
 
+    s->status = status;
+    s->pid    = pid;
     return 0;
 }
 
-static svc *
-svc_new(int fd, char const *name)
+/**
+ * Decode runit's 20 bytes supervise/status record into s:
+ *
+ * 0-11: tai64n of the last change
+ * 12-15: pid, little endian
+ * 16: paused
+ * 17: want, 'u' or 'd'
+ * 18: term sent
+ * 19: state, 0 down, 1 run, 2 finish
+ */
+static void
+decode_record(unsigned char const *buf, svc *s)
 {
-    int f = openat(fd, name, O_RDONLY);
-    if (f == -1) {
-        set_last_error("failed to open %s: %s", name, strerror(errno));
-        return NULL;
+    tai_unpack(buf, &s->since);
+
+    s->pid = (pid_t)((uint32_t)buf[12] | (uint32_t)buf[13] << 8 |
+                     (uint32_t)buf[14] << 16 | (uint32_t)buf[15] << 24);
+    s->is_paused = buf[16] != 0;
+
+    switch (buf[17]) {
+    case 'u': s->want = SVC_WANT_UP; break;
+    case 'd': s->want = SVC_WANT_DOWN; break;
+    default:  s->want = SVC_WANT_NONE; break;
     }
 
-    svc *s = NULL;
+    switch (buf[19]) {
+    case 0:  s->status = SVC_STOPPED; break;
+    case 1:  s->status = SVC_RUNNING; break;
+    case 2:  s->status = SVC_FINISHING; break;
+    default: s->status = SVC_UNKNOWN; break;
+    }
+}
 
-    int status = get_status(f);
-    if (status == -1) {
-        wrap_last_error("failed to get status of %s", name);
-        goto end;
+/**
+ * Read and decode supervise/status into s.
+ *
+ * Returns 0 when decoded, 1 if the record doesn't exist and -1 on error and
+ * set last_error.
+ */
+static int
+get_record(int fd, svc *s)
+{
+    unsigned char buf[SVC_STATUS_LEN] = {0};
+
+    int n = io_readat(fd, "supervise/status", (char *)buf, sizeof(buf));
+    if (n == -1) {
+        if (errno == ENOENT) {
+            clear_last_error();
+            return 1;
+        }
+        return -1;
+    } else if (n != SVC_STATUS_LEN) {
+        // runsv replaces the record atomically, a short read means it's not
+        // a runit status record
+        return 1;
     }
 
-    int is_down = io_existsat(f, "down");
-    if (is_down == -1) {
-        wrap_last_error("failed to check if %s is down", name);
-        goto end;
+    decode_record(buf, s);
+    return 0;
+}
+
+svc *
+svc_new(arena *a, char const *name)
+{
+    size_t l = sizeof(svc) + sizeof(*((svc *)0)->name) * (strlen(name) + 1);
+    svc *s   = a != NULL ? arena_alloc(a, l) : calloc(1, l);
+    if (s == NULL) {
+        set_last_error("failed to allocate svc: %s", strerror(errno));
+        return NULL;
     }
 
-    pid_t pid = get_pid(f);
-    if (pid == -1) {
-        wrap_last_error("failed to get pid of %s", name);
-        goto end;
+    strcpy(s->name, name);
+    s->restarts = -1;
+    return s;
+}
+
+/**
+ * Returns 1 if the name of a service may be kept by filter, NULL keeps all.
+ */
+static int
+name_match(cfg_filter const *filter, char const *name)
+{
+    return filter == NULL || filter->pattern == NULL ||
+           fnmatch(filter->pattern, name, 0) == 0;
+}
+
+int
+svc_filter_match(cfg_filter const *filter, svc const *s, int has_log)
+{
+    return name_match(filter, s->name) &&
+           (filter->status == -1 || (int)s->status == filter->status) &&
+           (filter->down == -1 || s->is_down == filter->down) &&
+           (filter->log == -1 || has_log == filter->log);
+}
+
+/**
+ * Read the fields of the service s->name relative to fd into s, the down file
+ * first since it's the cheapest way for filter, NULL for none, to drop s.
+ *
+ * Returns 1 if filter drops s, -1 on error and set last_error.
+ */
+static int
+read_into(int fd, svc *s, cfg_filter const *filter, unsigned fields)
+{
+    char const *name = s->name;
+    if (fields == 0) {
+        return 0;
     }
 
-    svc_time time = {0};
-    if (get_time(f, &time) == -1) {
-        wrap_last_error("failed to get pid of %s", name);
-        goto end;
+    int f = openat(fd, name, O_RDONLY);
+    stats_io(f == -1 ? 1 : 2, 0, 0);
+    if (f == -1) {
+        set_last_error("failed to open %s: %s", name, strerror(errno));
+        return -1;
     }
 
-    s = calloc(1, sizeof(*s) + (sizeof(*s->name) * strlen(name) + 1));
-    if (s == NULL) {
-        set_last_error("calloc failed: %s", strerror(errno));
-    } else {
-        s->status  = status;
+    int ret = -1;
+    if (fields & SVC_FIELD_DOWN) {
+        int is_down = io_existsat(f, "down");
+        if (is_down == -1) {
+            wrap_last_error("failed to check if %s is down", name);
+            goto end;
+        }
         s->is_down = is_down;
-        s->pid     = pid;
-        memcpy(s->time, time, sizeof(time));
-        strcpy(s->name, name);
+
+        if (filter != NULL && filter->down != -1 && is_down != filter->down) {
+            ret = 1;
+            goto end;
+        }
     }
 
+    if (fields & SVC_FIELD_STATUS) {
+        int r = get_record(f, s);
+        if (r == 1) {
+            // a service just linked has no supervise/ until runsv starts it,
+            // it's shown unknown rather than failing the others
+            int supervised = io_existsat(f, "supervise/stat");
+            r              = supervised == 1 ? get_text(f, s) : supervised;
+            if (supervised == 0) {
+                s->status = SVC_UNKNOWN;
+            }
+        }
+        if (r == -1) {
+            wrap_last_error("failed to read status of %s", name);
+            goto end;
+        }
+
+        if (filter != NULL && filter->status != -1 &&
+            (int)s->status != filter->status) {
+            ret = 1;
+            goto end;
+        }
+    }
+    ret = 0;
+
 end:
     close(f);
+    return ret;
+}
+
+svc *
+svc_read(int fd, char const *name)
+{
+    svc *s = svc_new(NULL, name);
+    if (s != NULL && read_into(fd, s, NULL, SVC_FIELDS_ALL) == -1) {
+        free(s);
+        s = NULL;
+    }
+
     return s;
 }
 
-int
-create_svc(arr_of(svc *) * list, int fd, char const *name)
+typedef struct {
+    int fd;
+    arr_of(char *) entries;
+
+    /**
+     * First entry left to the pool, the ones before were scanned by
+     * io_uring.
+     */
+    size_t first;
+
+    /**
+     * Which services are kept, and the fields read: the ones asked for plus
+     * the ones the filter needs.
+     */
+    cfg_filter const *filter;
+    unsigned fields;
+
+    /**
+     * Root of the services, see svc.root.
+     */
+    char const *root;
+
+    /**
+     * Two slots per entry, the service then its log, NULL when there's none
+     * or the filter dropped it.
+     */
+    svc **slots;
+
+    /**
+     * The services are handed to fn in the order of entries: an entry is
+     * marked done once its slots are filled, and every done entry from next
+     * on is emitted under lock.
+     */
+    svc_fn fn;
+    void *ctx;
+
+    /**
+     * Holds the services, shared by the workers under lock.
+     */
+    arena *arena;
+    pthread_mutex_t lock;
+    char *done;
+    size_t next;
+
+    /**
+     * Seconds spent in fn, with --stats.
+     */
+    double emitted;
+} scan;
+
+/**
+ * Hand the services of the done entries following sc->next to sc->fn.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+emit_ready(scan *sc)
+{
+    for (; sc->next < arr_len(sc->entries) && sc->done[sc->next]; ++sc->next) {
+        for (size_t j = sc->next * 2; j < sc->next * 2 + 2; ++j) {
+            svc const *s = sc->slots[j];
+            if (s == NULL) {
+                continue;
+            }
+
+            double t = stats_clock();
+            if (sc->fn(sc->ctx, s) == -1) {
+                return -1;
+            }
+            sc->emitted += stats_clock() - t;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Read the service name into an svc allocated in the arena of sc, *s is left
+ * NULL when the filter of sc drops it.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+scan_read(scan *sc, char const *name, svc **s)
+{
+    pthread_mutex_lock(&sc->lock);
+    svc *n = svc_new(sc->arena, name);
+    pthread_mutex_unlock(&sc->lock);
+
+    if (n == NULL) {
+        return -1;
+    }
+    n->root = sc->root;
+
+    int r = read_into(sc->fd, n, sc->filter, sc->fields);
+    if (r == -1) {
+        return -1;
+    }
+
+    *s = r == 0 ? n : NULL;
+    return 0;
+}
+
+/**
+ * Tell whether the service name and its log may be kept, knowing their names
+ * only, into keep.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+keep_names(scan const *sc, char const *name, char *log, int keep[2])
+{
+    if (io_snprintf(log, 512, "%s/log", name) == -1) {
+        wrap_last_error("io_snprintf failed");
+        return -1;
+    }
+
+    keep[0] = name_match(sc->filter, name);
+    keep[1] = name_match(sc->filter, log);
+    return 0;
+}
+
+/**
+ * Apply has_log, whether the log of a service exists, to keep.
+ */
+static void
+keep_log(scan const *sc, int has_log, int keep[2])
 {
-    svc *service = svc_new(fd, name);
-    if (service == NULL) {
+    if (sc->filter->log != -1 && has_log != sc->filter->log) {
+        keep[0] = 0;
+        keep[1] = 0;
+    }
+    keep[1] = keep[1] && has_log;
+}
+
+/**
+ * Fill the slots of the entry i of sc with synchronous reads.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+scan_sync(scan *sc, size_t i)
+{
+    char const *name = sc->entries[i];
+    double t         = stats_clock();
+
+    char log[512] = {0};
+    int keep[2]   = {0};
+    if (keep_names(sc, name, log, keep) == -1) {
+        return -1;
+    }
+
+    // the log dir is only looked up when it may be shown or filtered on
+    if (keep[1] || sc->filter->log != -1) {
+        int r = io_existsat(sc->fd, log);
+        if (r == -1) {
+            wrap_last_error("failed to check if %s exists", log);
+            return -1;
+        }
+        keep_log(sc, r, keep);
+    }
+
+    if (keep[0] && scan_read(sc, name, &sc->slots[i * 2]) == -1) {
         wrap_last_error("failed to create svc '%s'", name);
         return -1;
+    } else if (keep[1] && scan_read(sc, log, &sc->slots[i * 2 + 1]) == -1) {
+        wrap_last_error("failed to create svc '%s'", log);
+        return -1;
     }
+    stats_service(name, stats_clock() - t);
+    return 0;
+}
 
-    if (arr_append((arr_ptr *)list, service) < 0) {
-        set_last_error("append to array failed: %s", strerror(errno));
-        free(service);
+static int
+scan_entry(void *ctx, size_t i)
+{
+    scan *sc = ctx;
+    i += sc->first;
+    if (scan_sync(sc, i) == -1) {
         return -1;
     }
 
+    pthread_mutex_lock(&sc->lock);
+    sc->done[i] = 1;
+    int r       = emit_ready(sc);
+    pthread_mutex_unlock(&sc->lock);
+    return r;
+}
+
+/**
+ * Build a svc from the results of its io_uring requests into *s, left NULL
+ * when the filter of sc drops it. Services without a binary status record, or
+ * for which a request failed, are read again by scan_read() which falls back
+ * to the text files and reports errors.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+svc_from_reqs(scan *sc,
+              char const *name,
+              uring_req const *status,
+              uring_req const *down,
+              svc **s)
+{
+    int need_status = (sc->fields & SVC_FIELD_STATUS) != 0;
+    int need_down   = (sc->fields & SVC_FIELD_DOWN) != 0;
+    if ((need_status && status->res != SVC_STATUS_LEN) ||
+        (need_down && down->res < 0)) {
+        return scan_read(sc, name, s);
+    }
+
+    svc *n = svc_new(sc->arena, name);
+    if (n == NULL) {
+        return -1;
+    }
+    n->root = sc->root;
+
+    if (need_status) {
+        decode_record((unsigned char const *)status->buf, n);
+    }
+    if (need_down) {
+        n->is_down = down->res;
+    }
+
+    cfg_filter const *f = sc->filter;
+    if ((f->status != -1 && (int)n->status != f->status) ||
+        (f->down != -1 && n->is_down != f->down)) {
+        n = NULL;
+    }
+
+    *s = n;
     return 0;
 }
 
-arr_of(svc *) list_services(char const *svdir, arr_of(char *) entries)
+// entries per io_uring round, and the requests of each entry, the last ones
+// are about the log of the service. Every request of a round may hold a fd
+// until the round closes it, the rounds are kept under RLIMIT_NOFILE with
+// room for URING_FDS_SPARE fds opened elsewhere
+#define URING_CHUNK     512
+#define URING_FDS_SPARE 64
+enum {
+    REQ_STATUS,
+    REQ_DOWN,
+    REQ_LOG,
+    REQ_LOG_STATUS,
+    REQ_LOG_DOWN,
+    URING_REQS,
+};
+
+// what a round of requests is about: the existence checks go first on their
+// own when a down or log filter may spare reading the records
+#define ROUND_CHECKS 1
+#define ROUND_READS  2
+
+/**
+ * Set the requests of the entry name for round up, the ones that aren't
+ * needed get a NULL path so the batch skips them. Paths are written at p, rec
+ * holds the records of the service and its log and keep tells which of them
+ * may still be kept.
+ *
+ * Returns the end of the paths written at p.
+ */
+static char *
+prepare(scan const *sc,
+        char const *name,
+        uring_req *req,
+        unsigned char (*rec)[SVC_STATUS_LEN],
+        int const keep[2],
+        int round,
+        char *p)
 {
-    int fd = open(svdir, O_RDONLY | O_RDONLY);
-    if (fd == -1) {
-        set_last_error("failed to open dir '%s': %s", svdir, strerror(errno));
-        return NULL;
+    static char const *const suffixes[URING_REQS] = {
+        [REQ_STATUS]     = "/supervise/status",
+        [REQ_DOWN]       = "/down",
+        [REQ_LOG]        = "/log",
+        [REQ_LOG_STATUS] = "/log/supervise/status",
+        [REQ_LOG_DOWN]   = "/log/down",
+    };
+
+    int checks = round & ROUND_CHECKS;
+    int reads  = round & ROUND_READS;
+    int down   = (sc->fields & SVC_FIELD_DOWN) != 0;
+    int status = (sc->fields & SVC_FIELD_STATUS) != 0;
+
+    int need[URING_REQS] = {
+        [REQ_STATUS]     = reads && status && keep[0],
+        [REQ_DOWN]       = checks && down && keep[0],
+        [REQ_LOG]        = checks && (keep[1] || sc->filter->log != -1),
+        [REQ_LOG_STATUS] = reads && status && keep[1],
+        [REQ_LOG_DOWN]   = checks && down && keep[1],
+    };
+
+    for (int j = 0; j < URING_REQS; ++j) {
+        // a reads only round keeps the results of the checks
+        if (!checks && (j == REQ_DOWN || j == REQ_LOG || j == REQ_LOG_DOWN)) {
+            req[j].path = NULL;
+            continue;
+        }
+
+        req[j] = (uring_req){0};
+        if (need[j]) {
+            req[j].path = p;
+            p += sprintf(p, "%s%s", name, suffixes[j]) + 1;
+        }
     }
 
-    arr_of(svc *) list = (arr_of(svc *))arr_alloc(NULL, 8);
-    if (list == NULL) {
-        set_last_error("failed to allocate array: %s", strerror(errno));
-    } else {
-        for (size_t i = 0; i < arr_len(entries); ++i) {
-            if (create_svc(&list, fd, entries[i]) < 0) {
-            err:
-                arr_free_free((arr_ptr)list, free);
-                list = NULL;
-                break;
+    req[REQ_STATUS].buf     = (char *)rec[0];
+    req[REQ_STATUS].len     = SVC_STATUS_LEN;
+    req[REQ_LOG_STATUS].buf = (char *)rec[1];
+    req[REQ_LOG_STATUS].len = SVC_STATUS_LEN;
+    return p;
+}
+
+/**
+ * Run the requests of the entries b to e of sc for round, keep holds two flags
+ * per entry of the chunk.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+uring_round(scan const *sc,
+            uring *u,
+            uring_req *reqs,
+            unsigned char (*recs)[SVC_STATUS_LEN],
+            char *paths,
+            int (*keep)[2],
+            size_t b,
+            size_t e,
+            int round)
+{
+    char *p = paths;
+    for (size_t i = b; i < e; ++i) {
+        p = prepare(sc,
+                    sc->entries[i],
+                    &reqs[(i - b) * URING_REQS],
+                    &recs[(i - b) * 2],
+                    keep[i - b],
+                    round,
+                    p);
+    }
+
+    if (uring_batch(u, sc->fd, reqs, (e - b) * URING_REQS) == -1) {
+        wrap_last_error("io_uring batch failed");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Fill the slots of sc using io_uring: the records, down files and log dirs
+ * of a whole chunk of entries are submitted at once. With a down or log
+ * filter the down files and log dirs are checked first, and only the records
+ * of the services left are read. When a batch fails the ring can't be
+ * trusted anymore, sc->first is set to the first entry not scanned yet. An
+ * entry whose log dir couldn't be checked for lack of fds is read again
+ * synchronously.
+ *
+ * Returns 1 if io_uring isn't available or failed, or the fd limit is too
+ * low for a round, the entries from sc->first on are then left to scan, -1 on
+ * error and set last_error.
+ */
+static int
+scan_uring(scan *sc)
+{
+    size_t n         = arr_len(sc->entries);
+    size_t chunk     = n < URING_CHUNK ? n : URING_CHUNK;
+    struct rlimit rl = {0};
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY) {
+        size_t fit = rl.rlim_cur > URING_FDS_SPARE
+                         ? (rl.rlim_cur - URING_FDS_SPARE) / URING_REQS
+                         : 0;
+        chunk      = fit < chunk ? fit : chunk;
+    }
+    if (chunk == 0 && n > 0) {
+        return 1;
+    }
+
+    uring *u = uring_open();
+    if (u == NULL) {
+        return 1;
+    }
+
+    int r            = -1;
+    char *paths      = NULL;
+    size_t paths_cap = 0;
+    int two_rounds   = sc->filter->down != -1 || sc->filter->log != -1;
+
+    uring_req *reqs = calloc(chunk * URING_REQS + 1, sizeof(*reqs));
+    unsigned char (*recs)[SVC_STATUS_LEN] = calloc(chunk * 2 + 1,
+                                                   sizeof(*recs));
+    int (*keep)[2] = calloc(chunk + 1, sizeof(*keep));
+    if (reqs == NULL || recs == NULL || keep == NULL) {
+        set_last_error("calloc failed: %s", strerror(errno));
+        goto end;
+    }
+
+    for (size_t b = 0; b < n; b += chunk) {
+        size_t e = b + chunk < n ? b + chunk : n;
+
+        size_t len = 0;
+        for (size_t i = b; i < e; ++i) {
+            len += URING_REQS * strlen(sc->entries[i]) +
+                   sizeof("/supervise/status") + sizeof("/down") +
+                   sizeof("/log") + sizeof("/log/supervise/status") +
+                   sizeof("/log/down");
+        }
+
+        if (len > paths_cap) {
+            char *p = realloc(paths, len);
+            if (p == NULL) {
+                set_last_error("realloc failed: %s", strerror(errno));
+                goto end;
+            }
+            paths     = p;
+            paths_cap = len;
+        }
+
+        char log[512] = {0};
+        for (size_t i = b; i < e; ++i) {
+            if (keep_names(sc, sc->entries[i], log, keep[i - b]) == -1) {
+                goto end;
+            }
+        }
+
+        double t = stats_clock();
+        if (two_rounds) {
+            if (uring_round(
+                    sc, u, reqs, recs, paths, keep, b, e, ROUND_CHECKS) ==
+                -1) {
+                goto fallback;
+            }
+
+            for (size_t i = b; i < e; ++i) {
+                uring_req *req = &reqs[(i - b) * URING_REQS];
+                int *k         = keep[i - b];
+                if (req[REQ_LOG].res < 0) {
+                    continue; // reported below
+                }
+
+                keep_log(sc, req[REQ_LOG].res, k);
+                int down = sc->filter->down;
+                k[0]     = k[0] && (down == -1 || req[REQ_DOWN].res < 0 ||
+                                req[REQ_DOWN].res == down);
+                k[1]     = k[1] && (down == -1 || req[REQ_LOG_DOWN].res < 0 ||
+                                req[REQ_LOG_DOWN].res == down);
             }
+        }
+
+        if (uring_round(sc,
+                        u,
+                        reqs,
+                        recs,
+                        paths,
+                        keep,
+                        b,
+                        e,
+                        two_rounds ? ROUND_READS
+                                   : ROUND_CHECKS | ROUND_READS) == -1) {
+            goto fallback;
+        }
+
+        for (size_t i = b; i < e; ++i) {
+            char const *name = sc->entries[i];
+            uring_req *req   = &reqs[(i - b) * URING_REQS];
+            int *k           = keep[i - b];
+            double fallback  = stats_clock();
 
-            char path[512] = {0};
-            if (io_snprintf(path, 512, "%s/log", entries[i]) == -1) {
+            if (io_snprintf(log, 512, "%s/log", name) == -1) {
                 wrap_last_error("io_snprintf failed");
-                goto err;
+                goto end;
+            } else if (req[REQ_LOG].res == -EMFILE ||
+                       req[REQ_LOG].res == -ENFILE) {
+                // out of fds for now, the batch has closed its own since
+                if (scan_sync(sc, i) == -1) {
+                    goto end;
+                }
+                sc->done[i] = 1;
+                continue;
+            } else if (req[REQ_LOG].res < 0) {
+                set_last_error("failed to check if %s exists: %s",
+                               log,
+                               strerror(-req[REQ_LOG].res));
+                goto end;
+            }
+
+            // in a single round the log is kept until its dir is found
+            // missing
+            k[1] = k[1] && req[REQ_LOG].res == 1;
+
+            if (k[0] && svc_from_reqs(sc,
+                                      name,
+                                      &req[REQ_STATUS],
+                                      &req[REQ_DOWN],
+                                      &sc->slots[i * 2]) == -1) {
+                wrap_last_error("failed to create svc '%s'", name);
+                goto end;
+            } else if (k[1] && svc_from_reqs(sc,
+                                             log,
+                                             &req[REQ_LOG_STATUS],
+                                             &req[REQ_LOG_DOWN],
+                                             &sc->slots[i * 2 + 1]) == -1) {
+                wrap_last_error("failed to create svc '%s'", log);
+                goto end;
             }
+            sc->done[i] = 1;
 
-            int r = io_existsat(fd, path);
-            if (r == -1) {
-                wrap_last_error("failed to check if %s exists", path);
-                goto err;
-            } else if (r == 1 && create_svc(&list, fd, path) < 0) {
-                goto err;
+            if (stats_enabled) {
+                // from the submission of the chunk until its last request
+                // completed, plus the reads falling back to text files
+                double last = t;
+                for (int j = 0; j < URING_REQS; ++j) {
+                    last = req[j].done > last ? req[j].done : last;
+                }
+                stats_service(name, last - t + stats_clock() - fallback);
             }
         }
+
+        if (emit_ready(sc) == -1) {
+            goto end;
+        }
+    }
+
+    r = 0;
+    goto end;
+
+fallback:
+    clear_last_error();
+    sc->first = sc->next;
+    r         = 1;
+
+end:
+    free(paths);
+    free(keep);
+    free(recs);
+    free(reqs);
+    uring_close(u);
+    return r;
+}
+
+/**
+ * Read the services of entries kept by filter into a and hand them to fn in
+ * order.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+scan_services(cfg *config,
+              arr_of(char *) entries,
+              cfg_filter const *filter,
+              unsigned fields,
+              arena *a,
+              svc_fn fn,
+              void *ctx)
+{
+    int fd = open(config->svdir, O_RDONLY | O_RDONLY);
+    stats_io(fd == -1 ? 1 : 2, 0, 0);
+    if (fd == -1) {
+        set_last_error(
+            "failed to open dir '%s': %s", config->svdir, strerror(errno));
+        return -1;
+    }
+
+    // what the filter looks at is read too
+    if (filter->status != -1) {
+        fields |= SVC_FIELD_STATUS;
+    }
+    if (filter->down != -1) {
+        fields |= SVC_FIELD_DOWN;
+    }
+
+    int r    = -1;
+    size_t n = arr_len(entries) * 2;
+    scan sc  = {
+        .fd      = fd,
+        .entries = entries,
+        .filter  = filter,
+        .fields  = fields,
+        .root    = config->roots_len > 1 ? config->svdir : NULL,
+        .slots   = calloc(n == 0 ? 1 : n, sizeof(*sc.slots)),
+        .fn      = fn,
+        .ctx     = ctx,
+        .arena   = a,
+        .lock    = PTHREAD_MUTEX_INITIALIZER,
+        .done    = calloc(arr_len(entries) + 1, 1),
+    };
+
+    if (sc.slots == NULL || sc.done == NULL) {
+        set_last_error("calloc failed: %s", strerror(errno));
+        goto end;
+    }
+
+    // io_uring unless workers were asked for, the pool runs sequentially
+    // what io_uring didn't scan when it isn't available or failed
+    double t = stats_clock();
+    r        = config->jobs == 0 ? scan_uring(&sc) : 1;
+    if (r == 1) {
+        size_t left = arr_len(entries) - sc.first;
+        r           = pool_run(config->jobs, left, scan_entry, &sc);
     }
+    stats_phase_end(STATS_READ, t + sc.emitted, arr_len(entries));
 
+end:
+    free(sc.slots);
+    free(sc.done);
     close(fd);
-    return list;
+    return r < 0 ? -1 : 0;
 }
 
-arr_of(svc *) svc_list(cfg *config)
+/**
+ * List the services kept by filter, NULL for all, allocated in a, and hand
+ * them to fn.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+each_in(cfg *config,
+        cfg_filter const *filter,
+        unsigned fields,
+        arena *a,
+        svc_fn fn,
+        void *ctx)
 {
-    arr_of(char *) entries = io_list_dirs(config->svdir);
+    static cfg_filter const all = {.status = -1, .down = -1, .log = -1};
+
+    double t               = stats_clock();
+    arr_of(char *) entries = io_list_dirs(config->svdir, a);
     if (entries == NULL) {
         wrap_last_error("failed to list dirs in '%s'", config->svdir);
+        return -1;
+    }
+    stats_phase_end(STATS_LIST, t, arr_len(entries));
+
+    int r = scan_services(
+        config, entries, filter != NULL ? filter : &all, fields, a, fn, ctx);
+    arr_free((arr_ptr)entries);
+    return r;
+}
+
+int
+svc_each(cfg *config,
+         cfg_filter const *filter,
+         unsigned fields,
+         svc_fn fn,
+         void *ctx)
+{
+    arena a = {0};
+    int r   = each_in(config, filter, fields, &a, fn, ctx);
+    arena_free(&a);
+    return r;
+}
+
+static int
+collect(void *ctx, svc const *s)
+{
+    if (arr_append((arr_ptr *)ctx, (void *)s) < 0) {
+        set_last_error("append to array failed: %s", strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+arr_of(svc *) svc_select(cfg *config,
+                         cfg_filter const *filter,
+                         unsigned fields,
+                         arena *a)
+{
+    arr_of(svc *) list = (arr_of(svc *))arr_alloc(NULL, 8);
+    if (list == NULL) {
+        set_last_error("failed to allocate array: %s", strerror(errno));
+        return NULL;
+    }
+
+    if (each_in(config, filter, fields, a, collect, &list) == -1) {
+        arr_free((arr_ptr)list);
         return NULL;
     }
 
-    arr_of(svc *) list = list_services(config->svdir, entries);
-    arr_free_free((arr_ptr)entries, free);
     return list;
 }
 
+typedef struct {
+    cfg *config;
+    cfg_filter const *filter;
+    unsigned fields;
+
+    /**
+     * The services of each root and where they're allocated, a worker only
+     * touches the ones of its root.
+     */
+    arr_of(svc *) lists[CFG_ROOTS_MAX];
+    arena arenas[CFG_ROOTS_MAX];
+} roots_scan;
+
+static int
+select_root(void *ctx, size_t i)
+{
+    roots_scan *rs = ctx;
+
+    cfg c          = *rs->config;
+    c.svdir        = c.roots[i];
+    c.svdir_fd     = -1;
+    c.available_fd = -1;
+
+    // a root gone or unreadable doesn't hide the others
+    rs->lists[i] = svc_select(&c, rs->filter, rs->fields, &rs->arenas[i]);
+    if (rs->lists[i] == NULL) {
+        print_last_error("skipped root %s", c.svdir);
+        clear_last_error();
+    }
+
+    return 0;
+}
+
+arr_of(svc *) svc_select_roots(cfg *config,
+                               cfg_filter const *filter,
+                               unsigned fields,
+                               arena *a)
+{
+    if (config->roots_len == 1) {
+        return svc_select(config, filter, fields, a);
+    }
+
+    roots_scan *rs = calloc(1, sizeof(*rs));
+    if (rs == NULL) {
+        set_last_error("calloc failed: %s", strerror(errno));
+        return NULL;
+    }
+    rs->config = config;
+    rs->filter = filter;
+    rs->fields = fields;
+
+    // a worker per root, but no more than there are CPUs: the scans of
+    // roots sharing a CPU only get in each other's way
+    size_t n           = config->roots_len;
+    long jobs          = pool_cpus() < (long)n ? pool_cpus() : (long)n;
+    arr_of(svc *) list = NULL;
+    if (pool_run(jobs, n, select_root, rs) == 0) {
+        size_t len     = 0;
+        size_t scanned = 0;
+        for (size_t i = 0; i < n; ++i) {
+            if (rs->lists[i] != NULL) {
+                len += arr_len(rs->lists[i]);
+                ++scanned;
+            }
+        }
+
+        if (scanned == 0) {
+            set_last_error("no root could be scanned");
+        } else if ((list = (arr_of(svc *))arr_alloc(NULL, len + 1)) == NULL) {
+            set_last_error("failed to allocate array: %s", strerror(errno));
+        }
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        if (list != NULL && rs->lists[i] != NULL) {
+            memcpy(list + arr_len(list),
+                   rs->lists[i],
+                   sizeof(*list) * arr_len(rs->lists[i]));
+            arr_len(list) += arr_len(rs->lists[i]);
+        }
+        arr_free((arr_ptr)rs->lists[i]);
+        arena_move(a, &rs->arenas[i]);
+    }
+    free(rs);
+
+    return list;
+}
+
+arr_of(svc *) svc_list(cfg *config, arena *a)
+{
+    return svc_select(config, NULL, SVC_FIELDS_ALL, a);
+}
+
+struct svc_handle {
+    int fd;
+    char name[];
+};
+
+/**
+ * Open the dir name relative to the services dir fd as an O_PATH handle.
+ * openat2() keeps the lookup beneath fd, services linked elsewhere as runit
+ * does leave it with EXDEV and are then opened by plain openat(), name having
+ * been checked for empty, . and .. components already.
+ *
+ * Returns -1 on error and set errno.
+ */
+static int
+open_dir(int fd, char const *name)
+{
+    struct open_how how = {
+        .flags   = O_PATH | O_DIRECTORY | O_CLOEXEC,
+        .resolve = RESOLVE_BENEATH,
+    };
+
+    int d = syscall(SYS_openat2, fd, name, &how, sizeof(how));
+    if (d == -1 && (errno == EXDEV || errno == ENOSYS || errno == EPERM)) {
+        d = openat(fd, name, O_PATH | O_DIRECTORY | O_CLOEXEC);
+    }
+
+    return d;
+}
+
+/**
+ * Returns 1 if name doesn't lead beneath the dir it's relative to: empty,
+ * absolute, or with an empty, . or .. component, which all resolve to the dir
+ * itself or above. Otherwise 0.
+ */
+static int
+escapes(char const *name)
+{
+    if (name[0] == '\0' || name[0] == '/') {
+        return 1;
+    }
+
+    for (char const *p = name;;) {
+        size_t l = strcspn(p, "/");
+        if (l == 0 || (p[0] == '.' && (l == 1 || (l == 2 && p[1] == '.')))) {
+            return 1;
+        } else if (p[l] == '\0') {
+            return 0;
+        }
+        p += l + 1;
+    }
+}
+
+svc_handle *
+svc_open(cfg *config, char const *name)
+{
+    int fd = cfg_svdir_fd(config);
+    if (fd == -1) {
+        return NULL;
+    }
+
+    if (escapes(name)) {
+        set_last_error("invalid service name %s", name);
+        return NULL;
+    }
+
+    size_t l      = strlen(name) + 1;
+    svc_handle *h = malloc(sizeof(*h) + l);
+    if (h == NULL) {
+        set_last_error("malloc failed: %s", strerror(errno));
+        return NULL;
+    }
+    memcpy(h->name, name, l);
+
+    if ((h->fd = open_dir(fd, name)) == -1) {
+        int e = errno;
+        set_last_error("failed to open %s: %s", name, strerror(e));
+        free(h);
+        errno = e;
+        return NULL;
+    }
+
+    return h;
+}
+
+void
+svc_close(svc_handle *h)
+{
+    if (h != NULL) {
+        close(h->fd);
+        free(h);
+    }
+}
+
 int
 svc_linked(cfg *config, char const *name)
 {
-    char path[512] = {0};
-    if (io_snprintf(path, 512, "%s/%s", config->svdir, name) == -1) {
-        wrap_last_error("io_snprintf failed");
+    int fd = cfg_svdir_fd(config);
+    if (fd == -1) {
         return -1;
     }
 
-    return io_exists(path);
+    return io_existsat(fd, name);
 }
 
 int
 svc_link(cfg *config, char const *name)
 {
-    char from[512] = {0};
-    if (io_snprintf(from, 512, "%s/%s", config->available, name) == -1) {
-        wrap_last_error("io_snprintf failed");
+    int fd = cfg_svdir_fd(config);
+    if (fd == -1) {
         return -1;
     }
 
-    char to[512] = {0};
-    if (io_snprintf(to, 512, "%s/%s", config->svdir, name) == -1) {
-        wrap_last_error("io_snprintf failed");
+    char *from = NULL;
+    if (asprintf(&from, "%s/%s", config->available, name) == -1) {
+        set_last_error("asprintf failed: %s", strerror(errno));
         return -1;
     }
 
-    if (symlink(from, to) == -1) {
+    int r = symlinkat(from, fd, name);
+    free(from);
+    if (r == -1) {
         set_last_error("symlink failed: %s", strerror(errno));
         return -1;
     }
@@ -263,13 +1260,12 @@ svc_link(cfg *config, char const *name)
 int
 svc_unlink(cfg *config, char const *name)
 {
-    char path[512] = {0};
-    if (io_snprintf(path, 512, "%s/%s", config->svdir, name) == -1) {
-        wrap_last_error("io_snprintf failed");
+    int fd = cfg_svdir_fd(config);
+    if (fd == -1) {
         return -1;
     }
 
-    if (unlink(path) == -1) {
+    if (unlinkat(fd, name, 0) == -1) {
         set_last_error("unlink failed: %s", strerror(errno));
         return -1;
     }
@@ -278,17 +1274,25 @@ svc_unlink(cfg *config, char const *name)
 }
 
 int
-svc_control(cfg *config, char const *name, char command)
+svc_control(svc_handle *h, char command)
 {
-    char path[512] = {0};
-    if (io_snprintf(
-            path, 512, "%s/%s/supervise/control", config->svdir, name) == -1) {
-        set_last_error("io_snprintf failed");
+    // a blocking open would hang until a runsv shows up to read the fifo
+    int fd = openat(h->fd, "supervise/control", O_WRONLY | O_NONBLOCK);
+    if (fd == -1) {
+        if (errno == ENXIO) {
+            set_last_error("runsv not running for %s", h->name);
+        } else {
+            set_last_error("failed to open supervise/control of %s: %s",
+                           h->name,
+                           strerror(errno));
+        }
         return -1;
     }
 
-    if (io_writeat(-1, path, (char[]){command}, 1) == -1) {
-        wrap_last_error("failed to write supervise/control of %s", name);
+    int r = io_write_all(fd, (char[]){command}, 1);
+    close(fd);
+    if (r == -1) {
+        wrap_last_error("failed to write supervise/control of %s", h->name);
         return -1;
     }
 
@@ -296,18 +1300,11 @@ svc_control(cfg *config, char const *name, char command)
 }
 
 int
-svc_running(cfg *config, char const *name)
+svc_running(svc_handle *h)
 {
-    char path[512] = {0};
-    if (io_snprintf(path, 512, "%s/%s/supervise/stat", config->svdir, name) ==
-        -1) {
-        wrap_last_error("io_snprintf failed");
-        return -1;
-    }
-
     char buf[3 + 1] = {0}; // "run"
-    if (io_readat(-1, path, buf, 3) == -1) {
-        wrap_last_error("failed to read supervise/stat of %s", name);
+    if (io_readat(h->fd, "supervise/stat", buf, 3) == -1) {
+        wrap_last_error("failed to read supervise/stat of %s", h->name);
         return -1;
     };
 
@@ -315,46 +1312,28 @@ svc_running(cfg *config, char const *name)
 }
 
 int
-svc_is_down(cfg *config, char const *name)
+svc_is_down(svc_handle *h)
 {
-    char path[512] = {0};
-    if (io_snprintf(path, 512, "%s/%s/down", config->svdir, name) == -1) {
-        wrap_last_error("io_snprintf failed");
-        return -1;
-    }
-
-    return io_exists(path);
+    return io_existsat(h->fd, "down");
 }
 
 int
-svc_down(cfg *config, char const *name)
+svc_down(svc_handle *h)
 {
-    char path[512] = {0};
-    if (io_snprintf(path, 512, "%s/%s/down", config->svdir, name) == -1) {
-        wrap_last_error("io_snprintf failed");
-        return -1;
-    }
-
-    int fd = creat(path, 0644);
-    if (fd == -1) {
+    int f = openat(h->fd, "down", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (f == -1) {
         set_last_error("creat failed: %s", strerror(errno));
         return -1;
     }
 
-    close(fd);
+    close(f);
     return 0;
 }
 
 int
-svc_up(cfg *config, char const *name)
+svc_up(svc_handle *h)
 {
-    char path[512] = {0};
-    if (io_snprintf(path, 512, "%s/%s/down", config->svdir, name) == -1) {
-        wrap_last_error("io_snprintf failed");
-        return -1;
-    }
-
-    if (unlink(path) == -1) {
+    if (unlinkat(h->fd, "down", 0) == -1) {
         set_last_error("unlink failed: %s", strerror(errno));
         return -1;
     }
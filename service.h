@@ -5,9 +5,11 @@
 #ifndef SVC_SVC_H
 #define SVC_SVC_H
 
+#include "arena.h"
 #include "arr.h"
 #include "config.h"
 #include <sys/types.h>
+#include <time.h>
 
 /**
  * Represents the status of a service.
@@ -24,29 +26,171 @@ typedef enum {
  */
 char const *svc_status_str(svc_status status);
 
+/**
+ * Represents the state runsv has been asked to reach.
+ */
+typedef enum {
+    SVC_WANT_NONE,
+    SVC_WANT_UP,
+    SVC_WANT_DOWN,
+} svc_want;
+
+/**
+ * Returns a string representing the given enum value.
+ */
+char const *svc_want_str(svc_want want);
+
 /**
  * Represents the time since the last status of service changed.
  */
 typedef char svc_time[24 + 1];
 
+/**
+ * Format the time elapsed between since and now into t, "-" when since is
+ * unset as for a service runsv didn't start yet.
+ *
+ * Returns -1 on error and set last_error.
+ */
+int svc_time_fmt(svc_time *t,
+                 struct timespec const *since,
+                 struct timespec const *now);
+
 /**
  * Represents a runit service.
  */
 typedef struct {
     svc_status status;
+    svc_want want;
     int is_down;
+    int is_paused;
     pid_t pid;
-    svc_time time;
+
+    /**
+     * Time of the last status change, with sub-second precision when read
+     * from supervise/status.
+     */
+    struct timespec since;
+
+    /**
+     * Dir the service was found in when several of them are scanned by
+     * svc_select_roots(), otherwise NULL.
+     */
+    char const *root;
+
+    /**
+     * Starts seen during the last hour and whether they make the service
+     * flap, filled from the history by hist_observe(), restarts is -1 until
+     * then.
+     */
+    int restarts;
+    int flapping;
     char name[];
 } svc;
 
 /**
- * Returns a list of current services in $SVDIR, the list and its elements must
- * be freed upon usage with `arr_free_free(list, free)`.
+ * Fields of svc read from disk, the name is always known.
+ */
+typedef enum {
+    SVC_FIELD_STATUS = 1 << 0, // status, want, paused, pid and since
+    SVC_FIELD_DOWN   = 1 << 1, // is_down
+    SVC_FIELDS_ALL   = SVC_FIELD_STATUS | SVC_FIELD_DOWN,
+} svc_field;
+
+/**
+ * Returns 1 if filter keeps s, otherwise 0. has_log tells whether s, or the
+ * service s is the log of, has a log.
+ */
+int svc_filter_match(cfg_filter const *filter, svc const *s, int has_log);
+
+/**
+ * Returns a list of current services in $SVDIR, the services are allocated in
+ * a. The list must be freed upon usage with `arr_free(list)` and the services
+ * with `arena_free(a)`.
  *
  * Returns NULL on error and set last_error.
  */
-arr_of(svc *) svc_list(cfg *config);
+arr_of(svc *) svc_list(cfg *config, arena *a);
+
+/**
+ * Like svc_list(), but only the services filter keeps, NULL for all, are read
+ * and only their given fields, the others are left zeroed.
+ *
+ * Returns NULL on error and set last_error.
+ */
+arr_of(svc *) svc_select(cfg *config,
+                         cfg_filter const *filter,
+                         unsigned fields,
+                         arena *a);
+
+/**
+ * Like svc_select(), but over every root of config concurrently, one worker
+ * per root. The services of a root follow the ones of the roots before it, a
+ * root failing to scan is skipped with a warning.
+ *
+ * Returns NULL on error, or when no root could be scanned, and set
+ * last_error.
+ */
+arr_of(svc *) svc_select_roots(cfg *config,
+                               cfg_filter const *filter,
+                               unsigned fields,
+                               arena *a);
+
+/**
+ * Called by svc_each() for every service, s is only valid until svc_each()
+ * returns.
+ *
+ * Returns -1 on error and set last_error, which stops the scan.
+ */
+typedef int (*svc_fn)(void *ctx, svc const *s);
+
+/**
+ * Scan the services like svc_select(), but hand each of them to fn in the same
+ * order as soon as it and the ones before it are read. Calls to fn never
+ * overlap.
+ *
+ * Returns -1 on error and set last_error.
+ */
+int svc_each(cfg *config,
+             cfg_filter const *filter,
+             unsigned fields,
+             svc_fn fn,
+             void *ctx);
+
+/**
+ * Returns a zeroed svc named name allocated in a. When a is NULL it's
+ * allocated on its own and must be freed upon usage.
+ *
+ * Returns NULL on error and set last_error.
+ */
+svc *svc_new(arena *a, char const *name);
+
+/**
+ * Read the service name relative to the services dir fd, the returned svc must
+ * be freed upon usage.
+ *
+ * Returns NULL on error and set last_error.
+ */
+svc *svc_read(int fd, char const *name);
+
+/**
+ * A service dir opened once, see svc_open().
+ */
+typedef struct svc_handle svc_handle;
+
+/**
+ * Open the dir of the service name, the queries and mutations taking the
+ * handle are then all relative to it without resolving the name again. The
+ * handle must be closed upon usage with svc_close().
+ *
+ * Returns NULL on error and set last_error, errno is then ENOENT when the
+ * service isn't linked.
+ */
+svc_handle *svc_open(cfg *config, char const *name);
+
+/**
+ * Close a handle returned by svc_open(), NULL is ignored.
+ */
+void svc_close(svc_handle *h);
 
 /**
  * Returns 1 if the given service name is linked, otherwise 0.
@@ -70,38 +214,39 @@ int svc_link(cfg *config, char const *name);
 int svc_unlink(cfg *config, char const *name);
 
 /**
- * Send a control command to the given service name.
+ * Send a control command to the service, fails rather than blocks when no
+ * runsv reads its control.
  *
  * Returns -1 on error and set last_error.
  */
-int svc_control(cfg *config, char const *name, char command);
+int svc_control(svc_handle *h, char command);
 
 /**
- * Returns 1 if the given service name is currently running, otherwise 0.
+ * Returns 1 if the service is currently running, otherwise 0.
  *
  * Returns -1 on error and set last_error.
  */
-int svc_running(cfg *config, char const *name);
+int svc_running(svc_handle *h);
 
 /**
- * Returns 1 if the given service name is down, otherwise 0.
+ * Returns 1 if the service is down, otherwise 0.
  *
  * Returns -1 on error and set last_error.
  */
-int svc_is_down(cfg *config, char const *name);
+int svc_is_down(svc_handle *h);
 
 /**
- * Downs the given service name.
+ * Downs the service.
  *
  * Returns -1 on error and set last_error.
  */
-int svc_down(cfg *config, char const *name);
+int svc_down(svc_handle *h);
 
 /**
- * Ups the given service name.
+ * Ups the service.
  *
  * Returns -1 on error and set last_error.
  */
-int svc_up(cfg *config, char const *name);
+int svc_up(svc_handle *h);
 
 #endif
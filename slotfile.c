@@ -0,0 +1,181 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#include "slotfile.h"
+#include "err.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static size_t
+size_of(slotfile_layout const *l)
+{
+    return SLOTFILE_HEADER + l->slot_size * l->slots + l->tail;
+}
+
+/**
+ * Create the header of an empty file, or check the one found, with the file
+ * locked so that a file being created is never seen half done.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+prepare(slotfile *f, char const *path)
+{
+    if (slotfile_lock(f) == -1) {
+        return -1;
+    }
+
+    slotfile_layout const *l = f->layout;
+    size_t size              = size_of(l);
+    int r                    = -1;
+    struct stat st           = {0};
+    if (fstat(f->fd, &st) == -1) {
+        set_last_error("failed to stat '%s': %s", path, strerror(errno));
+        goto end;
+    }
+
+    if (st.st_size == 0 && f->writable) {
+        slotfile_header header = {.slots = l->slots, .param = l->param};
+        memcpy(header.magic, l->magic, sizeof(header.magic));
+        if (ftruncate(f->fd, size) == -1 ||
+            pwrite(f->fd, &header, sizeof(header), 0) != sizeof(header)) {
+            set_last_error(
+                "failed to create '%s': %s", path, strerror(errno));
+            goto end;
+        }
+        st.st_size = size;
+    }
+
+    slotfile_header header = {0};
+    if ((size_t)st.st_size != size ||
+        pread(f->fd, &header, sizeof(header), 0) != sizeof(header) ||
+        memcmp(header.magic, l->magic, sizeof(header.magic)) != 0 ||
+        header.slots != l->slots || header.param != l->param) {
+        set_last_error("'%s' isn't a %s file", path, l->what);
+        goto end;
+    }
+    r = 0;
+
+end:
+    slotfile_unlock(f);
+    return r;
+}
+
+int
+slotfile_open(slotfile *f,
+              char const *path,
+              slotfile_layout const *l,
+              int writable)
+{
+    *f = (slotfile){.layout = l, .writable = writable};
+
+    f->fd = writable ? open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644)
+                     : open(path, O_RDONLY | O_CLOEXEC);
+    if (f->fd == -1 && writable &&
+        (errno == EACCES || errno == EPERM || errno == EROFS)) {
+        // not ours to write, it can still be read
+        f->writable = 0;
+        f->fd       = open(path, O_RDONLY | O_CLOEXEC);
+    }
+    if (f->fd == -1) {
+        set_last_error("failed to open '%s': %s", path, strerror(errno));
+        return -1;
+    }
+
+    if (prepare(f, path) == -1) {
+        slotfile_close(f);
+        return -1;
+    }
+
+    size_t size = size_of(l);
+    int prot    = f->writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    void *map   = mmap(NULL, size, prot, MAP_SHARED, f->fd, 0);
+    if (map == MAP_FAILED) {
+        set_last_error("failed to map '%s': %s", path, strerror(errno));
+        slotfile_close(f);
+        return -1;
+    }
+
+    f->map   = map;
+    f->size  = size;
+    f->slots = f->map + SLOTFILE_HEADER;
+    return 0;
+}
+
+void
+slotfile_close(slotfile *f)
+{
+    if (f->map != NULL) {
+        munmap(f->map, f->size);
+    }
+    if (f->layout != NULL && f->fd != -1) {
+        close(f->fd);
+    }
+    *f = (slotfile){.fd = -1};
+}
+
+int
+slotfile_lock(slotfile *f)
+{
+    if (flock(f->fd, f->writable ? LOCK_EX : LOCK_SH) == -1) {
+        set_last_error(
+            "failed to lock %s: %s", f->layout->what, strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+void
+slotfile_unlock(slotfile *f)
+{
+    flock(f->fd, LOCK_UN);
+}
+
+uint64_t
+slotfile_key(char const *root, char const *name)
+{
+    uint64_t k = 14695981039346656037ULL;
+    if (root != NULL) {
+        for (char const *c = root; *c != '\0'; ++c) {
+            k = (k ^ (unsigned char)*c) * 1099511628211ULL;
+        }
+        k = (k ^ '/') * 1099511628211ULL;
+    }
+    for (char const *c = name; *c != '\0'; ++c) {
+        k = (k ^ (unsigned char)*c) * 1099511628211ULL;
+    }
+
+    // 0 marks the free slots
+    return k != 0 ? k : 1;
+}
+
+void *
+slotfile_find(slotfile *f, uint64_t key, int add, int *fresh)
+{
+    slotfile_layout const *l = f->layout;
+
+    *fresh = 0;
+    for (size_t i = 0; i < SLOTFILE_PROBES; ++i) {
+        size_t at    = (key + i) & (l->slots - 1);
+        uint64_t *sl = (uint64_t *)(f->slots + l->slot_size * at);
+        if (*sl == key) {
+            return sl;
+        } else if (*sl == 0) {
+            if (!add || !f->writable) {
+                return NULL;
+            }
+            *sl    = key;
+            *fresh = 1;
+            return sl;
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,131 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#ifndef SVC_SLOTFILE_H
+#define SVC_SLOTFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Size of the header, the slots follow it on their own cache line.
+ */
+#define SLOTFILE_HEADER 64
+
+/**
+ * Slots probed before giving up on a key, the table is then too full.
+ */
+#define SLOTFILE_PROBES 64
+
+/**
+ * Start of the header of every slot file, its owner may keep its own fields
+ * after it, up to SLOTFILE_HEADER bytes.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t slots;
+
+    /**
+     * Checked along with slots, the size of what the owner keeps per slot or
+     * after them.
+     */
+    uint32_t param;
+} slotfile_header;
+
+/**
+ * Layout of a slot file, every slot starts with its uint64_t key, 0 for a
+ * free slot.
+ */
+typedef struct {
+    char const *magic;
+
+    /**
+     * What the file holds, for the errors, as in "failed to lock <what>".
+     */
+    char const *what;
+
+    /**
+     * Number of slots, a power of 2, and the size of one.
+     */
+    uint32_t slots;
+    size_t slot_size;
+
+    /**
+     * Written to and checked against the param of the header.
+     */
+    uint32_t param;
+
+    /**
+     * Bytes kept after the slots.
+     */
+    size_t tail;
+} slotfile_layout;
+
+/**
+ * A file mapped in memory and shared by every svc process: a header, a hash
+ * table of slots keyed by service and what its owner keeps after them. The
+ * file is sparse, only the pages of the slots used are ever touched.
+ */
+typedef struct {
+    slotfile_layout const *layout;
+    int fd;
+    int writable;
+
+    unsigned char *map;
+    size_t size;
+    unsigned char *slots;
+} slotfile;
+
+/**
+ * Open the slot file path of the given layout into f. When writable is 1 it's
+ * created when missing, and opened read-only when it can't be written,
+ * f->writable is then 0. Otherwise it's only read and must exist. The file
+ * must be closed upon usage with slotfile_close().
+ *
+ * Returns -1 on error and set last_error.
+ */
+int slotfile_open(slotfile *f,
+                  char const *path,
+                  slotfile_layout const *l,
+                  int writable);
+
+/**
+ * Close f, a zeroed slotfile or one closed already is ignored.
+ */
+void slotfile_close(slotfile *f);
+
+/**
+ * Lock f exclusively when it's writable, shared otherwise.
+ *
+ * Returns -1 on error and set last_error.
+ */
+int slotfile_lock(slotfile *f);
+
+/**
+ * Unlock f, locked with slotfile_lock().
+ */
+void slotfile_unlock(slotfile *f);
+
+/**
+ * Returns the key of the service name under root, a FNV-1a hash of
+ * "root/name", or of name alone when root is NULL. Never 0.
+ */
+uint64_t slotfile_key(char const *root, char const *name);
+
+/**
+ * Returns the slot of key, taking a free one when add is 1, f is writable and
+ * key has none, *fresh is then set. Returns NULL if there's no slot for key.
+ */
+void *slotfile_find(slotfile *f, uint64_t key, int add, int *fresh);
+
+/**
+ * Returns the bytes kept after the slots of f.
+ */
+static inline void *
+slotfile_tail(slotfile const *f)
+{
+    return f->slots + f->layout->slot_size * f->layout->slots;
+}
+
+#endif
@@ -0,0 +1,133 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#include "stats.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STATS_SLOWEST 5
+
+typedef struct {
+    char *name;
+    double seconds;
+} sample;
+
+int stats_enabled;
+
+static double phases[STATS_PHASES_LEN];
+static size_t items[STATS_PHASES_LEN];
+
+static size_t syscalls;
+static size_t bytes;
+static size_t uring_ops;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static sample *samples;
+static size_t samples_len;
+static size_t samples_cap;
+
+void
+stats_phase_add(stats_phase p, double seconds, size_t n)
+{
+    // roots are scanned concurrently
+    pthread_mutex_lock(&lock);
+    phases[p] += seconds;
+    items[p] += n;
+    pthread_mutex_unlock(&lock);
+}
+
+void
+stats_io_add(size_t n, size_t b, size_t ops)
+{
+    __atomic_add_fetch(&syscalls, n, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&bytes, b, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&uring_ops, ops, __ATOMIC_RELAXED);
+}
+
+void
+stats_service(char const *name, double seconds)
+{
+    if (!stats_enabled) {
+        return;
+    }
+
+    pthread_mutex_lock(&lock);
+    if (samples_len == samples_cap) {
+        size_t cap = samples_cap == 0 ? 256 : samples_cap * 2;
+        sample *s  = realloc(samples, sizeof(*s) * cap);
+        if (s == NULL) {
+            // a partial report is better than none
+            pthread_mutex_unlock(&lock);
+            return;
+        }
+        samples     = s;
+        samples_cap = cap;
+    }
+
+    char *copy = strdup(name);
+    if (copy != NULL) {
+        samples[samples_len++] = (sample){.name = copy, .seconds = seconds};
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+static int
+slower(void const *a, void const *b)
+{
+    double x = ((sample const *)a)->seconds;
+    double y = ((sample const *)b)->seconds;
+    return (x < y) - (x > y);
+}
+
+void
+stats_print(FILE *f)
+{
+    if (!stats_enabled) {
+        return;
+    }
+
+    static char const *const names[] = {
+        [STATS_LIST]   = "list",
+        [STATS_READ]   = "read",
+        [STATS_DAEMON] = "daemon",
+        [STATS_RENDER] = "render",
+    };
+    for (int p = 0; p < STATS_PHASES_LEN; ++p) {
+        if (phases[p] > 0) {
+            fprintf(f,
+                    "stats: %-8s %10.3f ms %8zu items\n",
+                    names[p],
+                    phases[p] * 1e3,
+                    items[p]);
+        }
+    }
+
+    fprintf(f,
+            "stats: io       %10zu syscalls %zu bytes read %zu io_uring ops\n",
+            syscalls,
+            bytes,
+            uring_ops);
+
+    if (samples_len == 0) {
+        return;
+    }
+
+    // slowest first
+    qsort(samples, samples_len, sizeof(*samples), slower);
+    fprintf(f,
+            "stats: service  min %.3f ms median %.3f ms p99 %.3f ms max "
+            "%.3f ms\n",
+            samples[samples_len - 1].seconds * 1e3,
+            samples[samples_len / 2].seconds * 1e3,
+            samples[samples_len / 100].seconds * 1e3,
+            samples[0].seconds * 1e3);
+
+    for (size_t i = 0; i < samples_len && i < STATS_SLOWEST; ++i) {
+        fprintf(f,
+                "stats: slowest  %10.3f ms %s\n",
+                samples[i].seconds * 1e3,
+                samples[i].name);
+    }
+}
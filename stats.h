@@ -0,0 +1,80 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#ifndef SVC_STATS_H
+#define SVC_STATS_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <time.h>
+
+/**
+ * Set by --stats, nothing is measured nor kept while it's 0: every entry
+ * point below returns right away.
+ */
+extern int stats_enabled;
+
+typedef enum {
+    STATS_LIST,   // listing the services dir
+    STATS_READ,   // reading every service
+    STATS_DAEMON, // asking svcd instead
+    STATS_RENDER, // printing the services
+    STATS_PHASES_LEN,
+} stats_phase;
+
+/**
+ * Returns the monotonic time in seconds, 0 when stats are disabled.
+ */
+static inline double
+stats_clock(void)
+{
+    if (!stats_enabled) {
+        return 0;
+    }
+
+    struct timespec ts = {0};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void stats_phase_add(stats_phase p, double seconds, size_t items);
+
+/**
+ * Add the time elapsed since start, a stats_clock(), and items to phase p.
+ */
+static inline void
+stats_phase_end(stats_phase p, double start, size_t items)
+{
+    if (stats_enabled) {
+        stats_phase_add(p, stats_clock() - start, items);
+    }
+}
+
+void stats_io_add(size_t syscalls, size_t bytes, size_t uring_ops);
+
+/**
+ * Count syscalls made by the scan, the bytes they read and the io_uring
+ * operations, thread safe.
+ */
+static inline void
+stats_io(size_t syscalls, size_t bytes, size_t uring_ops)
+{
+    if (stats_enabled) {
+        stats_io_add(syscalls, bytes, uring_ops);
+    }
+}
+
+/**
+ * Record that reading the service name, its log included, took seconds. Thread
+ * safe, name is copied.
+ */
+void stats_service(char const *name, double seconds);
+
+/**
+ * Print the report, phases, distribution of the service times, I/O and the
+ * slowest services, to f.
+ */
+void stats_print(FILE *f);
+
+#endif
@@ -0,0 +1,405 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#include "svcd.h"
+#include "buf.h"
+#include "err.h"
+#include "io.h"
+#include "monitor.h"
+#include <errno.h>
+#include <fnmatch.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define SVCD_HEADER "svcd 1\n"
+
+// a stuck peer never blocks the other side for longer than this
+#define SVCD_TIMEOUT_SEC 1
+
+static volatile sig_atomic_t stopped;
+
+static void
+on_signal(int sig)
+{
+    (void)sig;
+    stopped = 1;
+}
+
+typedef struct {
+    monitor m;
+    int fd;
+
+    /**
+     * The serialized list of every service, rebuilt only when the monitor
+     * reported a change.
+     */
+    buf snapshot;
+    int stale;
+} svcd;
+
+static int
+socket_addr(cfg *config, struct sockaddr_un *addr)
+{
+    *addr = (struct sockaddr_un){.sun_family = AF_UNIX};
+
+    int r = 0;
+    if (config->socket != NULL) {
+        r = io_snprintf(
+            addr->sun_path, sizeof(addr->sun_path), "%s", config->socket);
+    } else {
+        r = io_snprintf(addr->sun_path,
+                        sizeof(addr->sun_path),
+                        "%s/.svcd.sock",
+                        config->svdir);
+    }
+
+    if (r == -1) {
+        wrap_last_error("socket path too long");
+        return -1;
+    }
+
+    return 0;
+}
+
+static void
+set_timeouts(int fd)
+{
+    struct timeval tv = {.tv_sec = SVCD_TIMEOUT_SEC};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+/**
+ * Append the services of list matching pattern, NULL for all, to b.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+serialize(buf *b, arr_of(svc *) list, char const *pattern)
+{
+    if (buf_append(b, SVCD_HEADER, sizeof(SVCD_HEADER) - 1) < 0) {
+        goto err;
+    }
+
+    for (size_t i = 0; i < arr_len(list); ++i) {
+        svc const *s = list[i];
+        if (pattern != NULL && fnmatch(pattern, s->name, 0) != 0) {
+            continue;
+        }
+
+        // the name goes last, it's the only field that isn't a number
+        if (buf_printf(b,
+                       "%d\t%d\t%d\t%d\t%d\t%lld\t%ld\t%s\n",
+                       (int)s->status,
+                       (int)s->want,
+                       s->is_down,
+                       s->is_paused,
+                       (int)s->pid,
+                       (long long)s->since.tv_sec,
+                       s->since.tv_nsec,
+                       s->name) < 0) {
+            goto err;
+        }
+    }
+
+    return 0;
+
+err:
+    set_last_error("failed to serialize services: %s", strerror(errno));
+    return -1;
+}
+
+/**
+ * Answer a single request, either "list" or "list PATTERN".
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+serve(svcd *d, int c)
+{
+    set_timeouts(c);
+
+    char req[512] = {0};
+    size_t len    = 0;
+    while (len < sizeof(req) - 1 && memchr(req, '\n', len) == NULL) {
+        ssize_t n = recv(c, req + len, sizeof(req) - 1 - len, 0);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            break;
+        }
+        len += n;
+    }
+
+    char *nl = memchr(req, '\n', len);
+    if (len == 0) {
+        // probed by a daemon checking whether the socket is alive
+        return 0;
+    } else if (nl == NULL) {
+        set_last_error("incomplete request");
+        return -1;
+    }
+    *nl = '\0';
+
+    char const *pattern = NULL;
+    if (strncmp(req, "list ", 5) == 0) {
+        pattern = req + 5;
+    } else if (strcmp(req, "list") != 0) {
+        set_last_error("unknown request '%s'", req);
+        return -1;
+    }
+
+    if (pattern != NULL) {
+        buf b = {0};
+        int r = serialize(&b, d->m.list, pattern);
+        if (r == 0) {
+            r = io_write_all(c, b.data, b.len);
+        }
+        buf_free(&b);
+        return r;
+    }
+
+    if (d->stale) {
+        d->snapshot.len = 0;
+        if (serialize(&d->snapshot, d->m.list, NULL) == -1) {
+            return -1;
+        }
+        d->stale = 0;
+    }
+
+    return io_write_all(c, d->snapshot.data, d->snapshot.len);
+}
+
+static int
+loop(svcd *d)
+{
+    while (!stopped) {
+        struct pollfd pfds[2] = {
+            {.fd = d->m.inotify_fd, .events = POLLIN},
+            {.fd = d->fd, .events = POLLIN},
+        };
+
+        if (poll(pfds, 2, -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            set_last_error("poll failed: %s", strerror(errno));
+            return -1;
+        }
+
+        // changes first, so a query never sees a state older than its own
+        // connection
+        if (pfds[0].revents & POLLIN) {
+            int r = monitor_read(&d->m);
+            if (r == -1) {
+                return -1;
+            }
+
+            for (size_t i = 0; r == 0 && i < arr_len(d->m.list); ++i) {
+                r = d->m.dirty[i];
+            }
+            d->stale |= r;
+        }
+
+        if (pfds[1].revents & POLLIN) {
+            int c = accept4(d->fd, NULL, NULL, SOCK_CLOEXEC);
+            if (c == -1) {
+                continue;
+            }
+
+            // a bad client only costs its own connection
+            if (serve(d, c) == -1) {
+                print_last_error("failed to serve a query");
+                clear_last_error();
+            }
+            close(c);
+        }
+    }
+
+    return 0;
+}
+
+int
+svcd_run(cfg *config)
+{
+    struct sockaddr_un addr = {0};
+    if (socket_addr(config, &addr) == -1) {
+        return -1;
+    }
+
+    struct sigaction sa = {.sa_handler = on_signal};
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    svcd d = {.fd = -1, .stale = 1};
+    if (monitor_init(&d.m, config) == -1) {
+        return -1;
+    }
+
+    int r = -1;
+
+    d.fd = io_listen(addr.sun_path);
+    if (d.fd == -1) {
+        goto end;
+    }
+
+    r = loop(&d);
+    unlink(addr.sun_path);
+
+end:
+    if (d.fd != -1) {
+        close(d.fd);
+    }
+    buf_free(&d.snapshot);
+    monitor_free(&d.m);
+    return r;
+}
+
+/**
+ * Parse a serialized list.
+ *
+ * Returns 1 if data isn't a valid answer, returns -1 on error and set
+ * last_error.
+ */
+static int
+parse(char *data, size_t len, arena *a, arr_of(svc *) * list)
+{
+    size_t hlen = sizeof(SVCD_HEADER) - 1;
+    if (len < hlen || memcmp(data, SVCD_HEADER, hlen) != 0) {
+        return 1;
+    }
+
+    *list = (arr_of(svc *))arr_alloc(NULL, 8);
+    if (*list == NULL) {
+        set_last_error("failed to allocate array: %s", strerror(errno));
+        return -1;
+    }
+
+    char *end = data + len;
+    for (char *p = data + hlen; p < end;) {
+        char *nl = memchr(p, '\n', end - p);
+        if (nl == NULL) {
+            goto invalid;
+        }
+        *nl = '\0';
+
+        int status = 0, want = 0, is_down = 0, is_paused = 0, pid = 0, n = 0;
+        long long sec = 0;
+        long nsec     = 0;
+        if (sscanf(p,
+                   "%d\t%d\t%d\t%d\t%d\t%lld\t%ld\t%n",
+                   &status,
+                   &want,
+                   &is_down,
+                   &is_paused,
+                   &pid,
+                   &sec,
+                   &nsec,
+                   &n) != 7 ||
+            n == 0) {
+            goto invalid;
+        }
+
+        svc *s = svc_new(a, p + n);
+        if (s == NULL) {
+            goto err;
+        }
+
+        s->status    = status;
+        s->want      = want;
+        s->is_down   = is_down;
+        s->is_paused = is_paused;
+        s->pid       = pid;
+        s->since     = (struct timespec){.tv_sec = sec, .tv_nsec = nsec};
+
+        if (arr_append((arr_ptr *)list, s) < 0) {
+            set_last_error("append to array failed: %s", strerror(errno));
+            goto err;
+        }
+
+        p = nl + 1;
+    }
+
+    return 0;
+
+invalid:
+    arr_free((arr_ptr)*list);
+    *list = NULL;
+    return 1;
+
+err:
+    arr_free((arr_ptr)*list);
+    *list = NULL;
+    return -1;
+}
+
+int
+svcd_query(cfg *config,
+           char const *pattern,
+           arena *a,
+           arr_of(svc *) * list)
+{
+    // no socket, a stale socket or a daemon we can't talk to all mean the
+    // caller scans by itself
+    int r                   = 1;
+    int fd                  = -1;
+    buf b                   = {0};
+    struct sockaddr_un addr = {0};
+
+    if (socket_addr(config, &addr) == -1 ||
+        (fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1 ||
+        connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+        goto end;
+    }
+    set_timeouts(fd);
+
+    char req[512] = {0};
+    if (io_snprintf(req,
+                    sizeof(req),
+                    "list%s%s\n",
+                    pattern != NULL ? " " : "",
+                    pattern != NULL ? pattern : "") == -1 ||
+        io_write_all(fd, req, strlen(req)) == -1) {
+        goto end;
+    }
+    shutdown(fd, SHUT_WR);
+
+    while (1) {
+        if (buf_reserve(&b, 64 * 1024) < 0) {
+            set_last_error("realloc failed: %s", strerror(errno));
+            r = -1;
+            goto end;
+        }
+
+        ssize_t n = recv(fd, b.data + b.len, b.cap - b.len, 0);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        } else if (n == -1) {
+            goto end;
+        } else if (n == 0) {
+            break;
+        }
+        b.len += n;
+    }
+
+    r = parse(b.data, b.len, a, list);
+
+end:
+    // the scan falling back starts clean, an error is the caller's to report
+    if (r == 1) {
+        clear_last_error();
+    }
+    buf_free(&b);
+    if (fd != -1) {
+        close(fd);
+    }
+    return r;
+}
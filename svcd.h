@@ -0,0 +1,36 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#ifndef SVC_SVCD_H
+#define SVC_SVCD_H
+
+#include "arena.h"
+#include "arr.h"
+#include "config.h"
+#include "service.h"
+
+/**
+ * Serve the services' statuses on the daemon socket until interrupted. The
+ * services are scanned once and then kept current with inotify, so queries
+ * are answered from memory.
+ *
+ * Returns -1 on error and set last_error.
+ */
+int svcd_run(cfg *config);
+
+/**
+ * Ask the daemon for the services whose name matches the shell-style
+ * pattern, NULL for every service. The services are allocated in a, the list
+ * must be freed upon usage with `arr_free(list)` and the services with
+ * `arena_free(a)`.
+ *
+ * Returns 1 if no daemon answered, the caller is expected to scan the
+ * services itself, returns -1 on error and set last_error.
+ */
+int svcd_query(cfg *config,
+               char const *pattern,
+               arena *a,
+               arr_of(svc *) * list);
+
+#endif
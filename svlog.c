@@ -0,0 +1,323 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#include "svlog.h"
+#include "err.h"
+#include "io.h"
+#include "tai.h"
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+
+// a log/run longer than this is no script svc understands
+#define RUN_LEN 4096
+
+/**
+ * Returns 1 if the svlogd option opt takes the next word as its argument.
+ */
+static int
+takes_arg(char const *opt)
+{
+    return strcmp(opt, "-r") == 0 || strcmp(opt, "-R") == 0 ||
+           strcmp(opt, "-l") == 0 || strcmp(opt, "-b") == 0;
+}
+
+/**
+ * Returns the first dir given to svlogd in the script run, NUL terminated in
+ * place, or NULL if there's none.
+ */
+static char *
+parse_run(char *run)
+{
+    char *line = NULL;
+    while ((line = strsep(&run, "\n")) != NULL) {
+        char *word   = NULL;
+        int svlogd   = 0;
+        int skip_arg = 0;
+        while ((word = strsep(&line, " \t;")) != NULL) {
+            // quotes only get in the way of the words svc looks for
+            size_t l = strlen(word);
+            if (l >= 2 && (word[0] == '"' || word[0] == '\'') &&
+                word[l - 1] == word[0]) {
+                word[l - 1] = '\0';
+                ++word;
+            }
+
+            char const *base = strrchr(word, '/');
+            base             = base != NULL ? base + 1 : word;
+            if (*word == '\0') {
+                continue;
+            } else if (!svlogd) {
+                svlogd = strcmp(base, "svlogd") == 0;
+            } else if (skip_arg) {
+                skip_arg = 0;
+            } else if (word[0] == '-') {
+                skip_arg = takes_arg(word);
+            } else {
+                // a dir from the environment isn't known here
+                return strchr(word, '$') == NULL ? word : NULL;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Returns 1 if the dir holds a current log, otherwise 0.
+ */
+static int
+has_current(char const *dir)
+{
+    char path[4096] = {0};
+    if (io_snprintf(path, sizeof(path), "%s/" SVLOG_CURRENT, dir) == -1) {
+        clear_last_error();
+        return 0;
+    }
+
+    int r = io_exists(path);
+    clear_last_error();
+    return r == 1;
+}
+
+int
+svlog_dir(cfg const *config, char const *name, char *dir, size_t len)
+{
+    char base[4096] = {0};
+    char path[4096] = {0};
+    if (io_snprintf(base, sizeof(base), "%s/%s/log", config->svdir, name) ==
+            -1 ||
+        io_snprintf(path, sizeof(path), "%s/run", base) == -1) {
+        wrap_last_error("io_snprintf failed");
+        return -1;
+    }
+
+    char run[RUN_LEN + 1] = {0};
+    int n                 = io_readat(AT_FDCWD, path, run, RUN_LEN);
+    clear_last_error();
+
+    char const *found = NULL;
+    if (n > 0 && memchr(run, '\0', n) == NULL) {
+        run[n] = '\0';
+        found  = parse_run(run);
+    }
+
+    int r = -1;
+    if (found != NULL) {
+        r = found[0] == '/' ? io_snprintf(dir, len, "%s", found)
+                            : io_snprintf(dir, len, "%s/%s", base, found);
+    } else if (io_snprintf(dir, len, "%s/main", base) != -1 &&
+               has_current(dir)) {
+        r = 0;
+    } else if (io_snprintf(dir, len, "/var/log/%s", name) != -1 &&
+               has_current(dir)) {
+        r = 0;
+    } else {
+        set_last_error("no log dir found for %s", name);
+        errno = ENOENT;
+        return -1;
+    }
+
+    if (r == -1) {
+        wrap_last_error("io_snprintf failed");
+    }
+    return r;
+}
+
+/**
+ * Returns 1 if name is a log rotated by svlogd, @<tai64n>.s or .u for the
+ * current one of a svlogd that didn't stop cleanly.
+ */
+static int
+is_rotated(char const *name)
+{
+    size_t l = strlen(name);
+    return l == TAI_HEX_LEN + 2 && name[0] == '@' && name[l - 2] == '.' &&
+           (name[l - 1] == 's' || name[l - 1] == 'u');
+}
+
+static int
+cmp_names(void const *a, void const *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+arr_of(char *) svlog_files(char const *dir, arena *a)
+{
+    DIR *d = opendir(dir);
+    if (d == NULL) {
+        set_last_error("failed to open dir '%s': %s", dir, strerror(errno));
+        return NULL;
+    }
+
+    arr_of(char *) files = (arr_of(char *))arr_alloc(NULL, 8);
+    int current          = 0;
+    if (files == NULL) {
+        set_last_error("failed to allocate array: %s", strerror(errno));
+        goto err;
+    }
+
+    struct dirent *e = NULL;
+    while ((errno = 0, e = readdir(d)) != NULL) {
+        if (strcmp(e->d_name, SVLOG_CURRENT) == 0) {
+            current = 1;
+            continue;
+        } else if (!is_rotated(e->d_name)) {
+            continue;
+        }
+
+        char *name = arena_strdup(a, e->d_name);
+        if (name == NULL || arr_append((arr_ptr *)&files, name) == -1) {
+            set_last_error("failed to add log: %s", strerror(errno));
+            goto err;
+        }
+    }
+    if (errno != 0) {
+        set_last_error("failed to read dir '%s': %s", dir, strerror(errno));
+        goto err;
+    }
+
+    // the labels of the names are fixed width, their order is their time's
+    qsort(files, arr_len(files), sizeof(*files), cmp_names);
+    if (current && arr_append((arr_ptr *)&files, SVLOG_CURRENT) == -1) {
+        set_last_error("failed to add log: %s", strerror(errno));
+        goto err;
+    }
+
+    closedir(d);
+    return files;
+
+err:
+    arr_free((arr_ptr)files);
+    closedir(d);
+    return NULL;
+}
+
+int
+svlog_file_time(char const *name, struct timespec *ts)
+{
+    return is_rotated(name) ? tai_parse(name, TAI_HEX_LEN, ts) : -1;
+}
+
+/**
+ * Read the n digits at p into *v.
+ *
+ * Returns -1 if they aren't all digits.
+ */
+static int
+digits(char const *p, int n, int *v)
+{
+    *v = 0;
+    for (int i = 0; i < n; ++i) {
+        if (p[i] < '0' || p[i] > '9') {
+            return -1;
+        }
+        *v = *v * 10 + p[i] - '0';
+    }
+
+    return 0;
+}
+
+/**
+ * Returns the days between 1970-01-01 and the date y-m-d of the proleptic
+ * Gregorian calendar, without going through the time zone like timegm().
+ */
+static long
+days_from_civil(long y, int m, int d)
+{
+    y -= m <= 2;
+    long era = (y >= 0 ? y : y - 399) / 400;
+    long yoe = y - era * 400;
+    long doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+int
+svlog_stamp(char const *p, size_t len, struct timespec *ts)
+{
+    if (len > 0 && p[0] == '@') {
+        return tai_parse(p, len, ts) == 0 ? TAI_HEX_LEN : -1;
+    }
+
+    // 2026-10-17_03:05:19.39712, T instead of _ for -ttt
+    int y = 0, mo = 0, d = 0, h = 0, mi = 0, sec = 0;
+    if (len < 19 || p[4] != '-' || p[7] != '-' ||
+        (p[10] != '_' && p[10] != 'T') || p[13] != ':' || p[16] != ':' ||
+        digits(p, 4, &y) == -1 || digits(p + 5, 2, &mo) == -1 ||
+        digits(p + 8, 2, &d) == -1 || digits(p + 11, 2, &h) == -1 ||
+        digits(p + 14, 2, &mi) == -1 || digits(p + 17, 2, &sec) == -1) {
+        return -1;
+    }
+
+    long nsec = 0;
+    size_t l  = 19;
+    if (len > 19 && p[19] == '.') {
+        long scale = 100000000;
+        for (l = 20; l < len && scale > 0 && isdigit(p[l]); ++l) {
+            nsec += (p[l] - '0') * scale;
+            scale /= 10;
+        }
+    }
+
+    ts->tv_sec  = days_from_civil(y, mo, d) * 86400 + h * 3600 + mi * 60 + sec;
+    ts->tv_nsec = nsec;
+    return l;
+}
+
+int
+svlog_parse_time(char const *s, struct timespec *ts)
+{
+    size_t l  = strlen(s);
+    char *end = NULL;
+    *ts       = (struct timespec){0};
+
+    if (s[0] == '@') {
+        if (l == TAI_HEX_LEN && tai_parse(s, l, ts) == 0) {
+            return 0;
+        }
+    } else if (s[0] == '-' && l >= 3) {
+        long n    = strtol(s + 1, &end, 10);
+        long unit = *end == 's' ? 1
+                    : *end == 'm' ? 60
+                    : *end == 'h' ? 3600
+                    : *end == 'd' ? 86400
+                                  : 0;
+        if (unit > 0 && end[1] == '\0' && n >= 0 && end != s + 1) {
+            clock_gettime(CLOCK_REALTIME, ts);
+            ts->tv_sec -= n * unit;
+            return 0;
+        }
+    } else if (l > 0 && strspn(s, "0123456789") == l) {
+        ts->tv_sec = strtoll(s, NULL, 10);
+        return 0;
+    } else if (l >= 10 && l < 32) {
+        // the date and time may be separated like svlogd does
+        char copy[32] = {0};
+        memcpy(copy, s, l);
+        if (l > 10 && (copy[10] == '_' || copy[10] == 'T')) {
+            copy[10] = ' ';
+        }
+
+        static char const *const formats[] = {
+            "%Y-%m-%d %H:%M:%S",
+            "%Y-%m-%d %H:%M",
+            "%Y-%m-%d",
+        };
+        for (size_t i = 0; i < sizeof(formats) / sizeof(*formats); ++i) {
+            struct tm tm = {.tm_isdst = -1};
+            end          = strptime(copy, formats[i], &tm);
+            if (end != NULL && *end == '\0') {
+                ts->tv_sec = mktime(&tm);
+                return 0;
+            }
+        }
+    }
+
+    set_last_error("invalid time %s", s);
+    return -1;
+}
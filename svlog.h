@@ -0,0 +1,65 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#ifndef SVC_SVLOG_H
+#define SVC_SVLOG_H
+
+#include "arena.h"
+#include "arr.h"
+#include "config.h"
+#include <stddef.h>
+#include <time.h>
+
+/**
+ * Name of the file svlogd writes to inside its log dir, the rotated ones are
+ * named after their tai64n time, @<tai64n>.s or .u.
+ */
+#define SVLOG_CURRENT "current"
+
+/**
+ * Write into dir the log dir of the service name: the first dir given to
+ * svlogd by its log/run, relative to the log service like runsv runs it.
+ * Without one, e.g. when log/run isn't a script, log/main and then
+ * /var/log/<name> are used if they hold a current file.
+ *
+ * Returns -1 on error and set last_error, errno is then ENOENT when no log
+ * dir is found.
+ */
+int svlog_dir(cfg const *config, char const *name, char *dir, size_t len);
+
+/**
+ * Returns the logs of dir, the rotated ones oldest first and then current
+ * when there's one, allocated in a. The list must be freed upon usage with
+ * `arr_free(list)`.
+ *
+ * Returns NULL on error and set last_error.
+ */
+arr_of(char *) svlog_files(char const *dir, arena *a);
+
+/**
+ * Read into ts the time the rotated log named name was rotated at, the time
+ * of its last line.
+ *
+ * Returns -1 if name isn't a rotated log.
+ */
+int svlog_file_time(char const *name, struct timespec *ts);
+
+/**
+ * Read into ts the time svlogd stamped the line at p with, of at most len
+ * bytes: a tai64n label from -t, or a UTC date from -tt or -ttt.
+ *
+ * Returns the length of the stamp, or -1 if the line isn't stamped.
+ */
+int svlog_stamp(char const *p, size_t len, struct timespec *ts);
+
+/**
+ * Parse the time s given by a user into ts: a tai64n label, unix seconds, a
+ * local date as YYYY-MM-DD[ HH:MM[:SS]], or a time before now such as -30m,
+ * -2h or -1d.
+ *
+ * Returns -1 on error and set last_error.
+ */
+int svlog_parse_time(char const *s, struct timespec *ts);
+
+#endif
@@ -0,0 +1,148 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#include "tai.h"
+#include <stdint.h>
+#include <string.h>
+
+// runit and svlogd label a unix time u with 2^62 + 10 + u
+#define TAI_UNIX_OFFSET 4611686018427387914ULL
+
+void
+tai_unpack(unsigned char const *buf, struct timespec *ts)
+{
+    uint64_t sec = 0;
+    for (int i = 0; i < 8; ++i) {
+        sec = (sec << 8) | buf[i];
+    }
+
+    uint32_t nsec = 0;
+    for (int i = 8; i < 12; ++i) {
+        nsec = (nsec << 8) | buf[i];
+    }
+
+    ts->tv_sec  = (time_t)(sec - TAI_UNIX_OFFSET);
+    ts->tv_nsec = nsec;
+}
+
+void
+tai_pack(struct timespec const *ts, unsigned char *buf)
+{
+    uint64_t sec = (uint64_t)ts->tv_sec + TAI_UNIX_OFFSET;
+    for (int i = 7; i >= 0; --i, sec >>= 8) {
+        buf[i] = sec & 0xff;
+    }
+
+    uint32_t nsec = ts->tv_nsec;
+    for (int i = 11; i >= 8; --i, nsec >>= 8) {
+        buf[i] = nsec & 0xff;
+    }
+}
+
+// every byte of a word set to b
+#define TAI_BYTES(b) (0x0101010101010101ULL * (b))
+
+/**
+ * Returns the 8 bytes at p as a little endian word, which compilers turn into
+ * a single load.
+ */
+static uint64_t
+load8(char const *p)
+{
+    unsigned char const *u = (unsigned char const *)p;
+    return (uint64_t)u[0] | (uint64_t)u[1] << 8 | (uint64_t)u[2] << 16 |
+           (uint64_t)u[3] << 24 | (uint64_t)u[4] << 32 |
+           (uint64_t)u[5] << 40 | (uint64_t)u[6] << 48 | (uint64_t)u[7] << 56;
+}
+
+/**
+ * Returns a word with the high bit of each byte of x set when the byte is
+ * between m and n excluded, the bytes above 127 never are.
+ */
+static uint64_t
+between(uint64_t x, unsigned m, unsigned n)
+{
+    uint64_t low = x & TAI_BYTES(127);
+    return (TAI_BYTES(127 + n) - low) & ~x & (low + TAI_BYTES(127 - m)) &
+           TAI_BYTES(128);
+}
+
+/**
+ * Decode the 8 hex digits at p into *v, all of them at once in a word rather
+ * than one after the other.
+ *
+ * Returns -1 if they aren't all hex digits.
+ */
+static int
+hex8(char const *p, uint32_t *v)
+{
+    uint64_t x  = load8(p);
+    uint64_t ok = between(x, '0' - 1, '9' + 1) |
+                  between(x | TAI_BYTES(0x20), 'a' - 1, 'f' + 1);
+    if (ok != TAI_BYTES(128)) {
+        return -1;
+    }
+
+    // a digit is worth its low nibble, a letter 9 more
+    uint64_t d = (x & TAI_BYTES(0x0f)) + (x >> 6 & TAI_BYTES(1)) * 9;
+
+    // the first digit is in the lowest byte, the nibbles are paired into
+    // bytes and the bytes gathered in the low half, first one lowest
+    d = (d & 0x000f000f000f000fULL) << 4 | (d >> 8 & 0x000f000f000f000fULL);
+    d = (d | d >> 8) & 0x0000ffff0000ffffULL;
+    d = (d | d >> 16) & 0xffffffffULL;
+
+    *v = __builtin_bswap32((uint32_t)d);
+    return 0;
+}
+
+int
+tai_parse(char const *s, size_t len, struct timespec *ts)
+{
+    uint32_t w[3] = {0};
+    if (len < TAI_HEX_LEN || s[0] != '@' || hex8(s + 1, &w[0]) == -1 ||
+        hex8(s + 9, &w[1]) == -1 || hex8(s + 17, &w[2]) == -1) {
+        return -1;
+    }
+
+    ts->tv_sec  = (time_t)(((uint64_t)w[0] << 32 | w[1]) - TAI_UNIX_OFFSET);
+    ts->tv_nsec = w[2];
+    return 0;
+}
+
+/**
+ * Write the n last decimal digits of v at p.
+ */
+static void
+put_digits(char *p, int n, long v)
+{
+    for (int i = n - 1; i >= 0; --i, v /= 10) {
+        p[i] = '0' + v % 10;
+    }
+}
+
+void
+tai_local_format(tai_local *c, struct timespec const *ts, char *out)
+{
+    if (!c->valid || ts->tv_sec < c->base || ts->tv_sec >= c->base + 60) {
+        // the offset to UTC only changes on a minute, the seconds of the
+        // same minute are then written without asking the time zone again
+        struct tm tm = {0};
+        localtime_r(&ts->tv_sec, &tm);
+        memcpy(c->minute, "0000-00-00 00:00:", TAI_LOCAL_MIN_LEN);
+        put_digits(c->minute, 4, tm.tm_year + 1900L);
+        put_digits(c->minute + 5, 2, tm.tm_mon + 1);
+        put_digits(c->minute + 8, 2, tm.tm_mday);
+        put_digits(c->minute + 11, 2, tm.tm_hour);
+        put_digits(c->minute + 14, 2, tm.tm_min);
+        c->base  = ts->tv_sec - tm.tm_sec;
+        c->valid = 1;
+    }
+
+    // 2026-10-17 03:05:, then 19.397120000
+    memcpy(out, c->minute, TAI_LOCAL_MIN_LEN);
+    put_digits(out + TAI_LOCAL_MIN_LEN, 2, ts->tv_sec - c->base);
+    out[TAI_LOCAL_MIN_LEN + 2] = '.';
+    put_digits(out + TAI_LOCAL_MIN_LEN + 3, 9, ts->tv_nsec);
+}
@@ -0,0 +1,66 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#ifndef SVC_TAI_H
+#define SVC_TAI_H
+
+#include <stddef.h>
+#include <time.h>
+
+/**
+ * Length of a packed tai64n label (8 bytes of seconds + 4 bytes of nano).
+ */
+#define TAI_PACK_LEN 12
+
+/**
+ * Decode a packed big-endian tai64n label, as found in runit's
+ * supervise/status, into a unix timespec.
+ */
+void tai_unpack(unsigned char const *buf, struct timespec *ts);
+
+/**
+ * Encode the unix timespec ts into a packed big-endian tai64n label, the
+ * reverse of tai_unpack().
+ */
+void tai_pack(struct timespec const *ts, unsigned char *buf);
+
+/**
+ * Length of a tai64n label in text, an @ followed by 24 hex digits, as
+ * svlogd -t prefixes its lines with.
+ */
+#define TAI_HEX_LEN 25
+
+/**
+ * Decode the tai64n label in text at s, of len bytes at least TAI_HEX_LEN,
+ * into a unix timespec.
+ *
+ * Returns -1 if s doesn't start with a label.
+ */
+int tai_parse(char const *s, size_t len, struct timespec *ts);
+
+/**
+ * Length of a time in local time as tai64nlocal prints it,
+ * 2026-10-17 03:05:19.397120000, and of its part up to the minute.
+ */
+#define TAI_LOCAL_LEN     29
+#define TAI_LOCAL_MIN_LEN 17
+
+/**
+ * The local time of the minute formatted last, which tai_local_format() looks
+ * up the time zone for once, zero initialize it before use.
+ */
+typedef struct {
+    int valid;
+    time_t base;
+    char minute[TAI_LOCAL_MIN_LEN];
+} tai_local;
+
+/**
+ * Write the unix timespec ts in local time into out, TAI_LOCAL_LEN bytes
+ * without a NUL byte. Only the first time of each minute goes through
+ * localtime_r(), c keeps it for the next ones.
+ */
+void tai_local_format(tai_local *c, struct timespec const *ts, char *out);
+
+#endif
@@ -0,0 +1,182 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#include "tai64n.h"
+#include "err.h"
+#include "io.h"
+#include "tai.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// logs are read and written by blocks of this size, a few syscalls a GB
+#define TAI64N_BUF (1024 * 1024)
+
+typedef struct {
+    tai_local local;
+
+    char *in;
+    char *out;
+    size_t out_len;
+
+    /**
+     * 1 when the next byte read starts a line.
+     */
+    int bol;
+} filter;
+
+/**
+ * Write the output of f to stdout.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+flush(filter *f)
+{
+    if (f->out_len > 0 &&
+        io_write_all(STDOUT_FILENO, f->out, f->out_len) == -1) {
+        wrap_last_error("failed to print the logs");
+        return -1;
+    }
+
+    f->out_len = 0;
+    return 0;
+}
+
+/**
+ * Append the len bytes of p, at most TAI64N_BUF, to the output of f.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+put(filter *f, char const *p, size_t len)
+{
+    if (f->out_len + len > TAI64N_BUF && flush(f) == -1) {
+        return -1;
+    }
+
+    memcpy(f->out + f->out_len, p, len);
+    f->out_len += len;
+    return 0;
+}
+
+/**
+ * Convert the len bytes at p to the output of f, up to the last line when
+ * more are to come since a label may be cut.
+ *
+ * Returns the bytes converted, -1 on error and set last_error.
+ */
+static long
+convert(filter *f, char const *p, size_t len, int eof)
+{
+    size_t i = 0;
+    while (i < len) {
+        if (f->bol) {
+            struct timespec ts = {0};
+            if (len - i < TAI_HEX_LEN && !eof &&
+                memchr(p + i, '\n', len - i) == NULL) {
+                // the label may end in the next read
+                break;
+            } else if (tai_parse(p + i, len - i, &ts) == 0) {
+                if (f->out_len + TAI_LOCAL_LEN > TAI64N_BUF &&
+                    flush(f) == -1) {
+                    return -1;
+                }
+                tai_local_format(&f->local, &ts, f->out + f->out_len);
+                f->out_len += TAI_LOCAL_LEN;
+                i += TAI_HEX_LEN;
+            }
+        }
+
+        char const *nl = memchr(p + i, '\n', len - i);
+        size_t end     = nl != NULL ? (size_t)(nl - p) + 1 : len;
+        if (put(f, p + i, end - i) == -1) {
+            return -1;
+        }
+        f->bol = nl != NULL;
+        i      = end;
+    }
+
+    return i;
+}
+
+/**
+ * Convert the log read from fd, named name, to the output of f.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+filter_fd(filter *f, int fd, char const *name)
+{
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    size_t len = 0;
+    f->bol     = 1;
+    for (;;) {
+        ssize_t r = read(fd, f->in + len, TAI64N_BUF - len);
+        if (r == -1 && errno == EINTR) {
+            continue;
+        } else if (r == -1) {
+            set_last_error("failed to read %s: %s", name, strerror(errno));
+            return -1;
+        }
+
+        len += r;
+        long done = convert(f, f->in, len, r == 0);
+        if (done == -1) {
+            return -1;
+        } else if (r == 0) {
+            return 0;
+        }
+
+        // the start of a line cut by the read is read again with the rest
+        memmove(f->in, f->in + done, len - done);
+        len -= done;
+    }
+}
+
+int
+tai64n_run(char *const *names, size_t n)
+{
+    int r    = -1;
+    filter f = {0};
+    f.in     = malloc(TAI64N_BUF);
+    f.out    = malloc(TAI64N_BUF);
+    if (f.in == NULL || f.out == NULL) {
+        set_last_error("malloc failed: %s", strerror(errno));
+        goto end;
+    }
+
+    if (n == 0 && filter_fd(&f, STDIN_FILENO, "stdin") == -1) {
+        goto end;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        if (strcmp(names[i], "-") == 0) {
+            if (filter_fd(&f, STDIN_FILENO, "stdin") == -1) {
+                goto end;
+            }
+            continue;
+        }
+
+        int fd = open(names[i], O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            set_last_error(
+                "failed to open '%s': %s", names[i], strerror(errno));
+            goto end;
+        }
+        int e = filter_fd(&f, fd, names[i]);
+        close(fd);
+        if (e == -1) {
+            goto end;
+        }
+    }
+    r = flush(&f);
+
+end:
+    free(f.in);
+    free(f.out);
+    return r;
+}
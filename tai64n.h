@@ -0,0 +1,19 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#ifndef SVC_TAI64N_H
+#define SVC_TAI64N_H
+
+#include <stddef.h>
+
+/**
+ * Copy the n files of names to stdout, stdin when n is 0 or for a name of -,
+ * with the tai64n label starting their lines in local time, the way
+ * tai64nlocal prints it. The other lines are copied as they are.
+ *
+ * Returns -1 on error and set last_error.
+ */
+int tai64n_run(char *const *names, size_t n);
+
+#endif
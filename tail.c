@@ -0,0 +1,379 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#include "tail.h"
+#include "err.h"
+#include "io.h"
+#include "svlog.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// svlogd appends to current, then renames it and creates a new one to rotate
+#define TAIL_MASK (IN_MODIFY | IN_CREATE | IN_MOVED_TO | IN_MOVED_FROM)
+
+// copied through when stdout refuses sendfile, e.g. a terminal
+#define TAIL_BUF (64 * 1024)
+
+static volatile sig_atomic_t stopped;
+
+static void
+on_signal(int sig)
+{
+    (void)sig;
+    stopped = 1;
+}
+
+typedef struct {
+    char const *name;
+    char dir[PATH_MAX];
+
+    /**
+     * The current log and how much of it was copied, fd is -1 while there's
+     * none.
+     */
+    int fd;
+    off_t off;
+    int wd;
+} tail_log;
+
+typedef struct {
+    tail_log *logs;
+    size_t n;
+
+    /**
+     * Index of the log printed last, -1 until one is.
+     */
+    long last;
+
+    /**
+     * 0 once stdout refused sendfile, buf is then used.
+     */
+    int sendfile;
+    char *buf;
+} tail;
+
+/**
+ * Open the current log of l, it's fine for it to be missing.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+open_current(tail_log *l)
+{
+    char path[PATH_MAX + sizeof(SVLOG_CURRENT)] = {0};
+    if (io_snprintf(path, sizeof(path), "%s/" SVLOG_CURRENT, l->dir) == -1) {
+        wrap_last_error("io_snprintf failed");
+        return -1;
+    }
+
+    l->off = 0;
+    l->fd  = open(path, O_RDONLY | O_CLOEXEC);
+    if (l->fd == -1 && errno != ENOENT) {
+        set_last_error("failed to open '%s': %s", path, strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Returns the offset of the last n lines of the size bytes of fd, found
+ * backwards from its end so that only the pages they span are read.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static off_t
+last_lines(int fd, off_t size, long n)
+{
+    if (size == 0 || n == 0) {
+        return size;
+    }
+
+    char const *p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+        set_last_error("failed to map the log: %s", strerror(errno));
+        return -1;
+    }
+
+    // the newline ending the last line doesn't start another one
+    off_t end = p[size - 1] == '\n' ? size - 1 : size;
+    for (long k = 0; k < n && end >= 0; ++k) {
+        char const *nl = memrchr(p, '\n', end);
+        end            = nl != NULL ? nl - p : -1;
+    }
+
+    munmap((void *)p, size);
+    return end + 1;
+}
+
+/**
+ * Announce the log i unless it's the one printed last or the only one.
+ */
+static void
+header(tail *t, size_t i)
+{
+    if (t->n > 1 && t->last != (long)i) {
+        dprintf(STDOUT_FILENO,
+                "%s==> %s <==\n",
+                t->last == -1 ? "" : "\n",
+                t->logs[i].name);
+    }
+    t->last = i;
+}
+
+/**
+ * Copy the log i to stdout from its offset up to end.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+copy(tail *t, size_t i, off_t end)
+{
+    tail_log *l = &t->logs[i];
+    if (end <= l->off) {
+        return 0;
+    }
+    header(t, i);
+
+    while (l->off < end) {
+        ssize_t r = -1;
+        if (t->sendfile) {
+            r = sendfile(STDOUT_FILENO, l->fd, &l->off, end - l->off);
+            if (r == -1 && (errno == EINVAL || errno == ENOSYS)) {
+                t->sendfile = 0;
+                continue;
+            }
+        } else {
+            size_t len = end - l->off < TAIL_BUF ? end - l->off : TAIL_BUF;
+            r          = pread(l->fd, t->buf, len, l->off);
+            if (r > 0 && io_write_all(STDOUT_FILENO, t->buf, r) == -1) {
+                wrap_last_error("failed to write the log of %s", l->name);
+                return -1;
+            }
+            l->off += r > 0 ? r : 0;
+        }
+
+        if (r == -1 && errno != EINTR) {
+            set_last_error(
+                "failed to copy the log of %s: %s", l->name, strerror(errno));
+            return -1;
+        } else if (r == 0) {
+            // truncated under us
+            break;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Copy whatever was appended to the log i, opening its current log first if
+ * needed. A log truncated under us is copied again from its start.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+drain(tail *t, size_t i)
+{
+    tail_log *l = &t->logs[i];
+    if (l->fd == -1 && open_current(l) == -1) {
+        return -1;
+    } else if (l->fd == -1) {
+        return 0;
+    }
+
+    struct stat st = {0};
+    if (fstat(l->fd, &st) == -1) {
+        set_last_error(
+            "failed to stat the log of %s: %s", l->name, strerror(errno));
+        return -1;
+    }
+
+    if (st.st_size < l->off) {
+        l->off = 0;
+    }
+
+    return copy(t, i, st.st_size);
+}
+
+/**
+ * Returns 1 if the current log of l isn't the file l has open anymore.
+ */
+static int
+rotated(tail_log const *l)
+{
+    char path[PATH_MAX + sizeof(SVLOG_CURRENT)] = {0};
+    struct stat cur                             = {0};
+    struct stat st                              = {0};
+    if (l->fd == -1 ||
+        io_snprintf(path, sizeof(path), "%s/" SVLOG_CURRENT, l->dir) == -1 ||
+        stat(path, &cur) == -1 || fstat(l->fd, &st) == -1) {
+        clear_last_error();
+        return 1;
+    }
+
+    return cur.st_ino != st.st_ino || cur.st_dev != st.st_dev;
+}
+
+/**
+ * Follow the event mask on the current log of i, IN_Q_OVERFLOW when events
+ * were lost.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+on_event(tail *t, size_t i, uint32_t mask)
+{
+    tail_log *l = &t->logs[i];
+    int moved   = (mask & (IN_MOVED_FROM | IN_CREATE | IN_MOVED_TO)) != 0 ||
+                ((mask & IN_Q_OVERFLOW) && rotated(l));
+    if (moved && l->fd != -1) {
+        // the file left behind is copied to its end first
+        if (drain(t, i) == -1) {
+            return -1;
+        }
+        close(l->fd);
+        l->fd = -1;
+    }
+
+    return mask & IN_MOVED_FROM ? 0 : drain(t, i);
+}
+
+/**
+ * Copy what's appended to the logs of t as it comes, until stopped.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+follow(tail *t, int ifd)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    while (!stopped) {
+        // no SA_RESTART, a signal interrupts the read
+        ssize_t len = read(ifd, buf, sizeof(buf));
+        if (len == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            set_last_error("failed to read inotify: %s", strerror(errno));
+            return -1;
+        }
+
+        struct inotify_event const *e = NULL;
+        for (char *p = buf; p < buf + len; p += sizeof(*e) + e->len) {
+            e = (struct inotify_event const *)p;
+
+            for (size_t i = 0; i < t->n; ++i) {
+                tail_log *l = &t->logs[i];
+                int mine    = e->wd == l->wd && e->len > 0 &&
+                           strcmp(e->name, SVLOG_CURRENT) == 0;
+                if ((e->mask & IN_Q_OVERFLOW) && l->wd != -1) {
+                    // events were lost, the logs are looked at again
+                    mine = 1;
+                }
+
+                if (mine && on_event(t, i, e->mask) == -1) {
+                    return -1;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+int
+tail_run(cfg const *config, char *const *names, size_t n)
+{
+    struct sigaction sa = {.sa_handler = on_signal};
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    int r    = -1;
+    int ifd  = -1;
+    tail t   = {.n = n, .last = -1, .sendfile = 1};
+    t.logs   = calloc(n + 1, sizeof(*t.logs));
+    t.buf    = malloc(TAIL_BUF);
+    if (t.logs == NULL || t.buf == NULL) {
+        set_last_error("malloc failed: %s", strerror(errno));
+        goto end;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        t.logs[i] = (tail_log){.name = names[i], .fd = -1, .wd = -1};
+    }
+
+    if (config->follow &&
+        (ifd = inotify_init1(IN_CLOEXEC)) == -1) {
+        set_last_error("inotify_init1 failed: %s", strerror(errno));
+        goto end;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        tail_log *l = &t.logs[i];
+        if (svlog_dir(config, l->name, l->dir, sizeof(l->dir)) == -1) {
+            // the services matched by a pattern may not all have a log
+            if (errno != ENOENT || n == 1) {
+                goto end;
+            }
+            print_last_error("skipped %s", l->name);
+            continue;
+        }
+
+        // watch first, a line written meanwhile is then seen rather than
+        // lost
+        if (ifd != -1 &&
+            (l->wd = inotify_add_watch(ifd, l->dir, TAIL_MASK)) == -1) {
+            set_last_error("cannot watch %s: %s", l->dir, strerror(errno));
+            goto end;
+        }
+
+        struct stat st = {0};
+        if (open_current(l) == -1) {
+            goto end;
+        } else if (l->fd == -1) {
+            continue;
+        } else if (fstat(l->fd, &st) == -1) {
+            set_last_error("failed to stat the log of %s: %s",
+                           l->name,
+                           strerror(errno));
+            goto end;
+        }
+
+        off_t off = last_lines(l->fd, st.st_size, config->lines);
+        if (off == -1) {
+            goto end;
+        }
+        l->off = off;
+        if (copy(&t, i, st.st_size) == -1) {
+            goto end;
+        }
+    }
+
+    r = ifd != -1 ? follow(&t, ifd) : 0;
+
+end:
+    for (size_t i = 0; t.logs != NULL && i < n; ++i) {
+        if (t.logs[i].fd != -1) {
+            close(t.logs[i].fd);
+        }
+    }
+    if (ifd != -1) {
+        close(ifd);
+    }
+    free(t.logs);
+    free(t.buf);
+    return r;
+}
@@ -0,0 +1,23 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#ifndef SVC_TAIL_H
+#define SVC_TAIL_H
+
+#include "config.h"
+#include <stddef.h>
+
+/**
+ * Print the last config->lines lines of the current log of each of the n
+ * services of names, then their new lines until SIGINT or SIGTERM when
+ * config->follow is 1, rotations included. Logs are copied to stdout by the
+ * kernel whenever it can, a header names the service whenever the output
+ * switches to another one. Among several services, the ones without a log are
+ * skipped.
+ *
+ * Returns -1 on error and set last_error.
+ */
+int tail_run(cfg const *config, char *const *names, size_t n);
+
+#endif
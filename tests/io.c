@@ -0,0 +1,194 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+
+/**
+ * The radix sort of the dir listings against strcmp, on names sharing short
+ * and long prefixes, then io_list_dirs() on a dir of such names.
+ */
+#include "../io.c"
+#include "test.h"
+#include <stdlib.h>
+
+#define NAMES_MAX 40000
+
+static uint64_t seed = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t
+next_rand(void)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed;
+}
+
+static int
+cmp_strs(void const *a, void const *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/**
+ * Fill names with n unique names of the given kind, allocated in a, in a
+ * random order.
+ *
+ * Returns the number of names, the duplicates drawn are dropped.
+ */
+static size_t
+draw(char **names, size_t n, int kind, arena *a)
+{
+    static char const *const prefixes[] = {
+        "",
+        "svc-",
+        "service-",
+        "org.example.daemon.",
+        "org.example.daemon.worker.pool-",
+        "\xc3\xa9t\xc3\xa9-",
+    };
+
+    char name[128] = {0};
+    for (size_t i = 0; i < n; ++i) {
+        char const *p = prefixes[next_rand() % (kind + 1)];
+        if (kind == 0) {
+            // short names over a tiny alphabet share most of their bytes
+            size_t len = 1 + next_rand() % 12;
+            for (size_t j = 0; j < len; ++j) {
+                name[j] = "ab"[next_rand() % 2];
+            }
+            name[len] = '\0';
+        } else {
+            unsigned long long k = next_rand() % n;
+            snprintf(name, sizeof(name), "%s%llu", p, k);
+        }
+        names[i] = arena_strdup(a, name);
+    }
+
+    qsort(names, n, sizeof(*names), cmp_strs);
+    size_t len = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (len == 0 || strcmp(names[len - 1], names[i]) != 0) {
+            names[len++] = names[i];
+        }
+    }
+
+    for (size_t i = len; i > 1; --i) {
+        size_t j     = next_rand() % i;
+        char *swap   = names[i - 1];
+        names[i - 1] = names[j];
+        names[j]     = swap;
+    }
+
+    return len;
+}
+
+static void
+test_sort(char **names, entry *es, entry *tmp, arena *a)
+{
+    static size_t const sizes[] = {0, 1, 2, 15, 16, 17, 100, 5000, NAMES_MAX};
+
+    for (int kind = 0; kind < 6; ++kind) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(*sizes); ++s) {
+            size_t n = draw(names, sizes[s], kind, a);
+            for (size_t i = 0; i < n; ++i) {
+                es[i] = (entry){.key = prefix(names[i]), .name = names[i]};
+            }
+
+            sort(es, tmp, n, 0);
+            qsort(names, n, sizeof(*names), cmp_strs);
+            for (size_t i = 0; i < n; ++i) {
+                if (es[i].name != names[i]) {
+                    CHECK(es[i].name == names[i],
+                          "kind %d of %zu names, %s at %zu instead of %s",
+                          kind,
+                          n,
+                          es[i].name,
+                          i,
+                          names[i]);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+static void
+test_list(char **names, arena *a)
+{
+    char dir[] = "/tmp/svc-test-io-XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        CHECK(0, "mkdtemp failed: %s", strerror(errno));
+        return;
+    }
+
+    int fd   = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    size_t n = draw(names, 3000, 5, a);
+    for (size_t i = 0; fd != -1 && i < n; ++i) {
+        // a dir, a link or a file, only the latter isn't listed
+        if (i % 3 == 0) {
+            mkdirat(fd, names[i], 0755);
+        } else if (i % 3 == 1) {
+            symlinkat("/nonexistent", fd, names[i]);
+        } else {
+            close(openat(fd, names[i], O_CREAT | O_WRONLY | O_CLOEXEC, 0644));
+        }
+    }
+    mkdirat(fd, ".hidden", 0755);
+
+    // the names past n are kept to clean up
+    char **all = names + n;
+    memcpy(all, names, sizeof(*names) * n);
+
+    size_t want = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (i % 3 != 2) {
+            names[want++] = names[i];
+        }
+    }
+    qsort(names, want, sizeof(*names), cmp_strs);
+
+    arr_of(char *) got = io_list_dirs(dir, a);
+    CHECK(got != NULL && arr_len(got) == want,
+          "listed %zu dirs of %zu",
+          got != NULL ? arr_len(got) : 0,
+          want);
+    for (size_t i = 0; got != NULL && i < arr_len(got) && i < want; ++i) {
+        if (strcmp(got[i], names[i]) != 0) {
+            CHECK(strcmp(got[i], names[i]) == 0, "%s at %zu", got[i], i);
+            break;
+        }
+    }
+    arr_free((arr_ptr)got);
+
+    for (size_t i = 0; i < n; ++i) {
+        unlinkat(fd, all[i], i % 3 == 0 ? AT_REMOVEDIR : 0);
+    }
+    unlinkat(fd, ".hidden", AT_REMOVEDIR);
+    if (fd != -1) {
+        close(fd);
+    }
+    rmdir(dir);
+}
+
+int
+main(void)
+{
+    arena a      = {0};
+    char **names = malloc(sizeof(*names) * NAMES_MAX);
+    entry *es    = malloc(sizeof(*es) * NAMES_MAX);
+    entry *tmp   = malloc(sizeof(*tmp) * NAMES_MAX);
+    if (names == NULL || es == NULL || tmp == NULL) {
+        perror("malloc");
+        return 1;
+    }
+
+    test_sort(names, es, tmp, &a);
+    test_list(names, &a);
+
+    free(tmp);
+    free(es);
+    free(names);
+    arena_free(&a);
+    return test_failed > 0;
+}
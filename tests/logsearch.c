@@ -0,0 +1,168 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+
+/**
+ * The search windows of --since and --until: seek() against a line by line
+ * scan for every time around the lines of logs bigger and smaller than its
+ * linear threshold, with unstamped lines at the edges and in between.
+ */
+#include "../logsearch.c"
+#include "test.h"
+
+#define LOG_CAP (1024 * 1024)
+
+// 2^62 + 10, what svlogd adds to the unix time of its labels
+#define LABEL_OFFSET 4611686018427387914ULL
+
+typedef struct {
+    /**
+     * Lines, stamped one second apart from second 1000 on, each second
+     * shared by dups lines with increasing fractions.
+     */
+    size_t lines;
+    size_t dups;
+
+    /**
+     * An unstamped line every that many lines, 0 for none, and at both ends
+     * when edges is set.
+     */
+    size_t unstamped;
+    int edges;
+
+    /**
+     * Stamps as -tt dates rather than tai64n labels.
+     */
+    int dates;
+    int last_newline;
+} log_shape;
+
+static size_t
+build(char *p, log_shape const *shape)
+{
+    size_t len = 0;
+    if (shape->edges) {
+        len += sprintf(p + len, "unstamped first line\n");
+    }
+
+    for (size_t i = 0; i < shape->lines; ++i) {
+        if (shape->unstamped > 0 && i > 0 && i % shape->unstamped == 0) {
+            len += sprintf(p + len, "  continued line %zu\n", i);
+        }
+
+        long sec = 1000 + i / shape->dups;
+        if (shape->dates) {
+            struct tm tm = {0};
+            time_t t     = sec;
+            gmtime_r(&t, &tm);
+            len += strftime(p + len, 32, "%Y-%m-%d_%H:%M:%S", &tm);
+            len += sprintf(p + len, ".%05zu", i % shape->dups);
+        } else {
+            len += sprintf(p + len,
+                           "@%016llx%08zx",
+                           (unsigned long long)sec + LABEL_OFFSET,
+                           i % shape->dups);
+        }
+        len += sprintf(p + len, " line %zu\n", i);
+    }
+
+    if (shape->edges) {
+        len += sprintf(p + len, "unstamped last line\n");
+    }
+    if (!shape->last_newline && len > 0) {
+        --len;
+    }
+
+    return len;
+}
+
+/**
+ * Returns what seek() should: the offset of the first stamped line at t or
+ * later, size if there's none, looking from the line at from on.
+ */
+static size_t
+scan_lines(char const *p, size_t size, size_t from, struct timespec const *t)
+{
+    for (size_t s = from; s < size; s = next_line(p, s, size)) {
+        struct timespec ts = {0};
+        if (svlog_stamp(p + s, size - s, &ts) != -1 &&
+            cmp_time(&ts, t) >= 0) {
+            return s;
+        }
+    }
+
+    return size;
+}
+
+static void
+test_seek(char *p, log_shape const *shape)
+{
+    // on the second, between the fractions of its lines and past them all
+    static long const nsecs[] = {0, 1, 15000, 999999999};
+
+    size_t size = build(p, shape);
+    size_t head = shape->edges ? strlen("unstamped first line\n") : 0;
+
+    // the edges of the file
+    struct timespec edge = {0};
+    CHECK(seek(p, size, &edge) == (shape->lines > 0 ? head : size),
+          "%zu lines, the first stamped line not found",
+          shape->lines);
+    edge.tv_sec = 1L << 40;
+    CHECK(seek(p, size, &edge) == size,
+          "%zu lines, a line found past the last one",
+          shape->lines);
+
+    // the times only grow, the line found before is where to look from
+    size_t want = 0;
+    long last   = 1000 + (long)(shape->lines / shape->dups) + 1;
+    for (long sec = 998; sec <= last + 1; ++sec) {
+        for (size_t n = 0; n < sizeof(nsecs) / sizeof(*nsecs); ++n) {
+            long nsec         = nsecs[n];
+            struct timespec t = {.tv_sec = sec, .tv_nsec = nsec};
+            size_t got        = seek(p, size, &t);
+            want              = scan_lines(p, size, want, &t);
+            if (got != want) {
+                CHECK(got == want,
+                      "%zu lines of %zu bytes, %ld.%09ld gave %zu",
+                      shape->lines,
+                      size,
+                      sec,
+                      nsec,
+                      got);
+                return;
+            }
+        }
+    }
+}
+
+int
+main(void)
+{
+    static log_shape const shapes[] = {
+        {.lines = 0, .dups = 1, .last_newline = 1},
+        {.lines = 0, .dups = 1, .edges = 1, .last_newline = 1},
+        {.lines = 1, .dups = 1, .last_newline = 1},
+        {.lines = 1, .dups = 1, .last_newline = 0},
+        {.lines = 50, .dups = 1, .edges = 1, .last_newline = 1},
+        {.lines = 5000, .dups = 1, .last_newline = 1},
+        {.lines = 5000, .dups = 1, .last_newline = 0},
+        {.lines = 5000, .dups = 7, .unstamped = 3, .last_newline = 1},
+        {.lines = 5000, .dups = 1, .unstamped = 1, .edges = 1},
+        {.lines = 5000, .dups = 2, .dates = 1, .edges = 1},
+    };
+
+    char *p = malloc(LOG_CAP);
+    if (p == NULL) {
+        perror("malloc");
+        return 1;
+    }
+
+    for (size_t i = 0; i < sizeof(shapes) / sizeof(*shapes); ++i) {
+        test_seek(p, &shapes[i]);
+    }
+
+    free(p);
+    return test_failed > 0;
+}
@@ -0,0 +1,259 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+
+/**
+ * The textfile of metrics file against the rules of the Prometheus text
+ * format node_exporter parses it with, and the OpenMetrics of the other sinks
+ * against the types only OpenMetrics has.
+ */
+#include "../metrics.c"
+#include "test.h"
+#include <ctype.h>
+
+#define NAMES_MAX 64
+
+/**
+ * Names seen by parse(), the families typed and the series sampled.
+ */
+typedef struct {
+    char typed[NAMES_MAX][64];
+    int types;
+    char sampled[NAMES_MAX * 8][256];
+    int samples;
+} seen;
+
+static int
+is_name(char const *s, size_t len, int colon)
+{
+    if (len == 0 || isdigit((unsigned char)*s)) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < len; ++i) {
+        unsigned char c = s[i];
+        if (!isalnum(c) && c != '_' && !(colon && c == ':')) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static int
+find(char const (*names)[64], int n, char const *name, size_t len)
+{
+    for (int i = 0; i < n; ++i) {
+        if (strlen(names[i]) == len && strncmp(names[i], name, len) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Check a HELP or TYPE line, after its "# ".
+ *
+ * Returns NULL if it holds, otherwise what's wrong with it.
+ */
+static char const *
+parse_meta(seen *sn, char const *line)
+{
+    int type = strncmp(line, "TYPE ", 5) == 0;
+    if (!type && strncmp(line, "HELP ", 5) != 0) {
+        return NULL; // any other comment is ignored
+    }
+
+    char const *name = line + 5;
+    size_t len       = strcspn(name, " ");
+    if (!is_name(name, len, 1)) {
+        return "invalid metric name";
+    } else if (!type) {
+        return NULL;
+    }
+
+    static char const *const types[] = {
+        "counter", "gauge", "histogram", "summary", "untyped"};
+    char const *t = name + len + (name[len] == ' ');
+    int known     = 0;
+    for (size_t i = 0; i < sizeof(types) / sizeof(*types); ++i) {
+        known |= strcmp(t, types[i]) == 0;
+    }
+
+    if (!known) {
+        return "unknown type";
+    } else if (find(sn->typed, sn->types, name, len) != -1) {
+        return "second TYPE line";
+    }
+
+    for (int i = 0; i < sn->samples; ++i) {
+        char const *s = sn->sampled[i];
+        if (strncmp(s, name, len) == 0 && (s[len] == '{' || s[len] == ' ')) {
+            return "TYPE after samples";
+        }
+    }
+
+    snprintf(sn->typed[sn->types++], 64, "%.*s", (int)len, name);
+    return NULL;
+}
+
+/**
+ * Check a sample line.
+ *
+ * Returns NULL if it holds, otherwise what's wrong with it.
+ */
+static char const *
+parse_sample(seen *sn, char const *line)
+{
+    size_t len = strcspn(line, "{ ");
+    if (!is_name(line, len, 1)) {
+        return "invalid metric name";
+    } else if (find(sn->typed, sn->types, line, len) == -1) {
+        return "sample of an untyped family";
+    }
+
+    char const *p = line + len;
+    if (*p == '{') {
+        for (++p; *p != '}';) {
+            size_t l = strcspn(p, "=");
+            if (!is_name(p, l, 0) || strncmp(p, "__", 2) == 0) {
+                return "invalid label name";
+            } else if (p[l] != '=' || p[l + 1] != '"') {
+                return "label without a quoted value";
+            }
+
+            for (p += l + 2; *p != '"'; ++p) {
+                if (*p == '\0') {
+                    return "unterminated label value";
+                } else if (*p == '\\' && strchr("\\\"n", *++p) == NULL) {
+                    return "invalid escape";
+                }
+            }
+
+            ++p;
+            p += *p == ',';
+        }
+        ++p;
+    }
+
+    if (*p++ != ' ') {
+        return "no value";
+    }
+
+    char *end = NULL;
+    strtod(p, &end);
+    if (end == p || (*end != '\0' && *end != ' ')) {
+        return "invalid value";
+    }
+
+    size_t series = end - line;
+    for (int i = 0; i < sn->samples; ++i) {
+        if (strlen(sn->sampled[i]) == series &&
+            strncmp(sn->sampled[i], line, series) == 0) {
+            return "duplicate series";
+        }
+    }
+    snprintf(sn->sampled[sn->samples++], 256, "%.*s", (int)series, line);
+    return NULL;
+}
+
+/**
+ * Parse text with the rules of the Prometheus text format.
+ *
+ * Returns the number of samples, -1 when a line breaks a rule.
+ */
+static int
+parse(char *text, int report)
+{
+    static seen sn;
+    memset(&sn, 0, sizeof(sn));
+
+    int n = 1;
+    for (char *line = strtok(text, "\n"); line != NULL;
+         line = strtok(NULL, "\n"), ++n) {
+        char const *err = line[0] == '#'
+                              ? (line[1] == ' ' ? parse_meta(&sn, line + 2)
+                                                : NULL)
+                              : parse_sample(&sn, line);
+        if (err != NULL) {
+            if (report) {
+                CHECK(err == NULL, "line %d, %s: %s", n, err, line);
+            }
+            return -1;
+        }
+    }
+
+    return sn.samples;
+}
+
+static void
+test_formats(void)
+{
+    static struct {
+        char const *name;
+        svc_status status;
+        svc_want want;
+    } const svcs[] = {
+        {"api", SVC_RUNNING, SVC_WANT_UP},
+        {"api/log", SVC_STOPPED, SVC_WANT_DOWN},
+        {"we\"ird\\name", SVC_FINISHING, SVC_WANT_NONE},
+        {"two\nlines", SVC_UNKNOWN, SVC_WANT_UP},
+    };
+    size_t const n = sizeof(svcs) / sizeof(*svcs);
+
+    arena a            = {0};
+    arr_of(svc *) list = (arr_of(svc *))arr_alloc(NULL, n);
+    for (size_t i = 0; list != NULL && i < n; ++i) {
+        svc *s = svc_new(&a, svcs[i].name);
+        if (s == NULL) {
+            break;
+        }
+        s->status       = svcs[i].status;
+        s->want         = svcs[i].want;
+        s->pid          = 100 + i;
+        s->since.tv_sec = 1;
+        arr_append((arr_ptr *)&list, s);
+    }
+    if (list == NULL || arr_len(list) != n) {
+        CHECK(0, "failed to build the services");
+        goto end;
+    }
+
+    for (format fmt = FORMAT_OPENMETRICS; fmt <= FORMAT_PROMETHEUS; ++fmt) {
+        buf out    = {0};
+        series *ss = series_new(list, NULL, 0, fmt);
+        if (ss == NULL || export(ss, list, fmt, &out) == -1 ||
+            buf_append(&out, "", 1) < 0) {
+            CHECK(0, "format %d: %s", fmt, get_last_error());
+        } else if (fmt == FORMAT_PROMETHEUS) {
+            // up, want up and down, pid, uptime and transitions
+            int samples = parse(out.data, 1);
+            CHECK(samples == (int)n * 6, "%d samples", samples);
+        } else {
+            CHECK(strstr(out.data, "# TYPE svc_want stateset\n") != NULL &&
+                      strcmp(out.data + out.len - 7, "# EOF\n") == 0,
+                  "no stateset or EOF:\n%s",
+                  out.data);
+            CHECK(parse(out.data, 0) == -1,
+                  "OpenMetrics taken as Prometheus");
+        }
+
+        if (ss != NULL) {
+            series_free(ss, n);
+        }
+        buf_free(&out);
+    }
+
+end:
+    arr_free((arr_ptr)list);
+    arena_free(&a);
+}
+
+int
+main(void)
+{
+    test_formats();
+    return test_failed > 0;
+}
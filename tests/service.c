@@ -0,0 +1,213 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+
+/**
+ * The names of the services that lead out of their dir, then the scan of view
+ * under a low fd limit: io_uring rounds kept under RLIMIT_NOFILE, and the
+ * services redone synchronously when the fds run out anyway, against the
+ * records written for each service and its log.
+ */
+#include "../service.c"
+#include "test.h"
+#include <sys/resource.h>
+
+#define SERVICES 600
+#define FDS_MAX  256
+
+/**
+ * Write a running record of pid at path relative to fd.
+ */
+static void
+write_record(int fd, char const *path, pid_t pid)
+{
+    unsigned char rec[SVC_STATUS_LEN] = {0};
+    rec[12] = pid & 0xff;
+    rec[13] = pid >> 8 & 0xff;
+    rec[17] = 'u';
+    rec[19] = 1;
+
+    int f = openat(fd, path, O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC, 0644);
+    if (f != -1) {
+        CHECK(write(f, rec, sizeof(rec)) == sizeof(rec), "%s", path);
+        close(f);
+    }
+}
+
+/**
+ * Create SERVICES services with a log in the dir fd, the service i has the
+ * pid 2 * i + 1 and its log 2 * i + 2.
+ */
+static void
+build(int fd)
+{
+    static char const *const dirs[] = {
+        "",
+        "/supervise",
+        "/log",
+        "/log/supervise",
+    };
+
+    char path[128] = {0};
+    for (int i = 0; i < SERVICES; ++i) {
+        for (size_t j = 0; j < sizeof(dirs) / sizeof(*dirs); ++j) {
+            snprintf(path, sizeof(path), "svc-%04d%s", i, dirs[j]);
+            mkdirat(fd, path, 0755);
+        }
+        snprintf(path, sizeof(path), "svc-%04d/supervise/status", i);
+        write_record(fd, path, 2 * i + 1);
+        snprintf(path, sizeof(path), "svc-%04d/log/supervise/status", i);
+        write_record(fd, path, 2 * i + 2);
+    }
+}
+
+static void
+clean(int fd)
+{
+    static char const *const files[] = {
+        "/log/supervise/status",
+        "/log/supervise",
+        "/log",
+        "/supervise/status",
+        "/supervise",
+        "",
+    };
+
+    char path[128] = {0};
+    for (int i = 0; i < SERVICES; ++i) {
+        for (size_t j = 0; j < sizeof(files) / sizeof(*files); ++j) {
+            snprintf(path, sizeof(path), "svc-%04d%s", i, files[j]);
+            int dir = j != 0 && j != 3;
+            unlinkat(fd, path, dir ? AT_REMOVEDIR : 0);
+        }
+    }
+}
+
+/**
+ * Select the services of config and check each of them and their log was
+ * read, as the services of a view.
+ */
+static void
+check_view(cfg *config, char const *what)
+{
+    arena a            = {0};
+    arr_of(svc *) list = svc_select(config, NULL, SVC_FIELDS_ALL, &a);
+    if (list == NULL) {
+        CHECK(list != NULL, "%s: %s", what, get_last_error());
+        clear_last_error();
+        arena_free(&a);
+        return;
+    }
+
+    CHECK(arr_len(list) == 2 * SERVICES,
+          "%s: %zu services listed",
+          what,
+          arr_len(list));
+    for (size_t i = 0; i < arr_len(list) && i < 2 * SERVICES; ++i) {
+        svc const *s = list[i];
+        if (s->pid != (pid_t)i + 1 || s->status != SVC_RUNNING) {
+            CHECK(s->pid == (pid_t)i + 1 && s->status == SVC_RUNNING,
+                  "%s: %s has pid %d",
+                  what,
+                  s->name,
+                  (int)s->pid);
+            break;
+        }
+    }
+
+    arr_free((arr_ptr)list);
+    arena_free(&a);
+}
+
+static void
+test_escapes(void)
+{
+    static struct {
+        char const *name;
+        int escapes;
+    } const known[] = {
+        {"api", 0},
+        {"api/log", 0},
+        {".api", 0},
+        {"api..", 0},
+        {"a/.b/..c", 0},
+        {"", 1},
+        {".", 1},
+        {"..", 1},
+        {"/api", 1},
+        {"api/", 1},
+        {"api//log", 1},
+        {"api/.", 1},
+        {"./api", 1},
+        {"api/./log", 1},
+        {"api/..", 1},
+        {"../api", 1},
+    };
+
+    for (size_t i = 0; i < sizeof(known) / sizeof(*known); ++i) {
+        CHECK(escapes(known[i].name) == known[i].escapes,
+              "'%s' gave %d",
+              known[i].name,
+              !known[i].escapes);
+    }
+}
+
+int
+main(void)
+{
+    test_escapes();
+
+    char dir[] = "/tmp/svc-test-service-XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1) {
+        perror("open");
+        rmdir(dir);
+        return 1;
+    }
+    build(fd);
+
+    cfg config = {
+        .svdir     = dir,
+        .roots     = {dir},
+        .roots_len = 1,
+        .jobs      = 0,
+        .svdir_fd  = -1,
+    };
+
+    struct rlimit rl = {0};
+    getrlimit(RLIMIT_NOFILE, &rl);
+    rl.rlim_cur = FDS_MAX;
+    if (setrlimit(RLIMIT_NOFILE, &rl) == -1) {
+        perror("setrlimit");
+        return 1;
+    }
+    check_view(&config, "low limit");
+
+    // the fds left are too few for a round, its services are redone
+    int held[FDS_MAX] = {0};
+    int len           = 0;
+    while (len < FDS_MAX && (held[len] = dup(fd)) != -1) {
+        ++len;
+    }
+    for (int i = 0; i < 8 && len > 0; ++i) {
+        close(held[--len]);
+    }
+    check_view(&config, "out of fds");
+    while (len > 0) {
+        close(held[--len]);
+    }
+
+    config.jobs = 1;
+    check_view(&config, "sequential");
+
+    clean(fd);
+    close(fd);
+    rmdir(dir);
+    return test_failed > 0;
+}
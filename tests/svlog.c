@@ -0,0 +1,142 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+
+/**
+ * The stamps of svlogd lines: days_from_civil() walked day after day across
+ * several 400 years eras, and svlog_stamp() on the -t, -tt and -ttt stamps.
+ */
+#include "../svlog.c"
+#include "test.h"
+
+static int
+is_leap(long y)
+{
+    return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+}
+
+static int
+month_days(long y, int m)
+{
+    static int const days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    return days[m - 1] + (m == 2 && is_leap(y));
+}
+
+static void
+test_days(void)
+{
+    // from -1000-01-01, the days to 1970 counted a year at a time
+    long const first = -1000;
+    long want        = 0;
+    for (long y = first; y < 1970; ++y) {
+        want -= 365 + is_leap(y);
+    }
+
+    for (long y = first; y <= 3000; ++y) {
+        for (int m = 1; m <= 12; ++m) {
+            for (int d = 1; d <= month_days(y, m); ++d, ++want) {
+                long got = days_from_civil(y, m, d);
+                if (got != want) {
+                    CHECK(got == want, "%ld-%02d-%02d gave %ld", y, m, d, got);
+                    return;
+                }
+            }
+        }
+    }
+}
+
+static void
+test_stamp(void)
+{
+    static struct {
+        char const *s;
+        int len;
+        char const *utc;
+        long nsec;
+    } const known[] = {
+        {"2026-10-17_03:05:19.39712 served",
+         25,
+         "2026-10-17 03:05:19",
+         397120000},
+        {"2026-10-17T03:05:19.397124 ttt",
+         26,
+         "2026-10-17 03:05:19",
+         397124000},
+        {"1970-01-01_00:00:00.00000",
+         25,
+         "1970-01-01 00:00:00",
+         0},
+        {"1969-12-31_23:59:59.99999",
+         25,
+         "1969-12-31 23:59:59",
+         999990000},
+        {"2000-02-29_12:00:00 leap",
+         19,
+         "2000-02-29 12:00:00",
+         0},
+        {"2100-03-01_00:00:00",
+         19,
+         "2100-03-01 00:00:00",
+         0},
+        {"1600-02-29_23:59:59.1234567890",
+         29,
+         "1600-02-29 23:59:59",
+         123456789},
+    };
+
+    for (size_t i = 0; i < sizeof(known) / sizeof(*known); ++i) {
+        struct tm tm = {0};
+        strptime(known[i].utc, "%Y-%m-%d %H:%M:%S", &tm);
+        time_t sec = timegm(&tm);
+
+        struct timespec ts = {0};
+        int len = svlog_stamp(known[i].s, strlen(known[i].s), &ts);
+        CHECK(len == known[i].len && ts.tv_sec == sec &&
+                  ts.tv_nsec == known[i].nsec,
+              "%s gave %d, %lld.%09ld",
+              known[i].s,
+              len,
+              (long long)ts.tv_sec,
+              ts.tv_nsec);
+    }
+
+    struct timespec ts = {0};
+    char const *label  = "@4000000068e7974935b43772 api[0]: served";
+    CHECK(svlog_stamp(label, strlen(label), &ts) == TAI_HEX_LEN &&
+              ts.tv_sec == 0x68e79749 - 10 && ts.tv_nsec == 0x35b43772,
+          "%s",
+          label);
+
+    static char const *const invalid[] = {
+        "",
+        "served",
+        "2026-10-17_03:05:1",
+        "2026-10-17 03:05:19.39712",
+        "2026/10/17_03:05:19.39712",
+        "2026-10-17_03.05.19.39712",
+        "2026-1O-17_03:05:19.39712",
+        "@4000000068e7974935b4377",
+        "@4000000068e7974935b4377x",
+    };
+
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(*invalid); ++i) {
+        CHECK(svlog_stamp(invalid[i], strlen(invalid[i]), &ts) == -1,
+              "%s taken",
+              invalid[i]);
+    }
+
+    // the stamp is read within len only
+    char const *line = "2026-10-17_03:05:19.39712";
+    CHECK(svlog_stamp(line, 18, &ts) == -1, "short len taken");
+    CHECK(svlog_stamp(line, 21, &ts) == 21 && ts.tv_nsec == 300000000,
+          "fraction past len read");
+}
+
+int
+main(void)
+{
+    test_days();
+    test_stamp();
+    return test_failed > 0;
+}
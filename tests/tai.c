@@ -0,0 +1,152 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+
+/**
+ * The word-at-a-time tai64n decoding: between() and hex8() against every
+ * byte in every lane, and tai_parse() on known labels.
+ */
+#include "../tai.c"
+#include "test.h"
+#include <ctype.h>
+#include <stdlib.h>
+
+static void
+test_between(void)
+{
+    static unsigned const ranges[][2] = {
+        {'0' - 1, '9' + 1},
+        {'a' - 1, 'f' + 1},
+        {0, 127},
+        {126, 128},
+    };
+
+    for (size_t r = 0; r < sizeof(ranges) / sizeof(*ranges); ++r) {
+        unsigned m = ranges[r][0];
+        unsigned n = ranges[r][1];
+        for (unsigned lane = 0; lane < 8; ++lane) {
+            for (unsigned b = 0; b < 256; ++b) {
+                // the other lanes hold bytes around the bounds, a carry out
+                // of one lane mustn't change the next
+                uint64_t x = TAI_BYTES(m + 1) ^ (uint64_t)(m + 1) << lane * 8;
+                x |= (uint64_t)b << lane * 8;
+
+                uint64_t got  = between(x, m, n) >> lane * 8 & 0x80;
+                int in        = b > m && b < n && b < 128;
+                uint64_t want = in ? 0x80 : 0;
+                CHECK(got == want,
+                      "byte %u in lane %u, (%u, %u)",
+                      b,
+                      lane,
+                      m,
+                      n);
+            }
+        }
+    }
+}
+
+static void
+test_hex8(void)
+{
+    static struct {
+        char const *s;
+        uint32_t v;
+    } const known[] = {
+        {"00000000", 0x00000000},
+        {"ffffffff", 0xffffffff},
+        {"FFFFFFFF", 0xffffffff},
+        {"0123abcd", 0x0123abcd},
+        {"0123ABCD", 0x0123abcd},
+        {"aBcDeF09", 0xabcdef09},
+        {"89abcdef", 0x89abcdef},
+        {"4000000a", 0x4000000a},
+    };
+
+    for (size_t i = 0; i < sizeof(known) / sizeof(*known); ++i) {
+        uint32_t v = 0;
+        CHECK(hex8(known[i].s, &v) == 0 && v == known[i].v,
+              "%s gave %08x",
+              known[i].s,
+              v);
+    }
+
+    // every byte at every digit, only hex digits are taken
+    for (int at = 0; at < 8; ++at) {
+        for (int b = 0; b < 256; ++b) {
+            char s[9] = "13579bdf";
+            s[at]     = (char)b;
+
+            uint32_t v = 0;
+            int r      = hex8(s, &v);
+            if (isxdigit(b)) {
+                uint32_t want = strtoul(s, NULL, 16);
+                CHECK(r == 0 && v == want,
+                      "byte %d at %d gave %08x",
+                      b,
+                      at,
+                      v);
+            } else {
+                CHECK(r == -1, "byte %d at %d taken", b, at);
+            }
+        }
+    }
+}
+
+static void
+test_parse(void)
+{
+    static struct {
+        char const *s;
+        time_t sec;
+        long nsec;
+    } const known[] = {
+        // svlogd stamps unix time + 2^62 + 10
+        {"@400000000000000a00000000", 0, 0},
+        {"@4000000068e7974935b43772", 0x68e79749 - 10, 0x35b43772},
+        {"@4000000068E7974935B43772", 0x68e79749 - 10, 0x35b43772},
+        {"@4000000037c219bf2ef02e94", 935467445, 787492500},
+        {"@40000000800000093b9ac9ff", 0x7fffffff, 999999999},
+        {"@3fffffffffffffff00000000", -11, 0},
+    };
+
+    for (size_t i = 0; i < sizeof(known) / sizeof(*known); ++i) {
+        struct timespec ts = {0};
+        CHECK(tai_parse(known[i].s, strlen(known[i].s), &ts) == 0 &&
+                  ts.tv_sec == known[i].sec && ts.tv_nsec == known[i].nsec,
+              "%s gave %lld.%09ld",
+              known[i].s,
+              (long long)ts.tv_sec,
+              ts.tv_nsec);
+    }
+
+    static char const *const invalid[] = {
+        "4000000068e7974935b43772 ",
+        "@4000000068e7974935b4377",
+        "@g000000068e7974935b43772",
+        "@4000000068e7974:35b43772",
+        "@4000000068e7974935b4377G",
+        "@4000000068e79749 5b43772",
+    };
+
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(*invalid); ++i) {
+        struct timespec ts = {0};
+        CHECK(tai_parse(invalid[i], strlen(invalid[i]), &ts) == -1,
+              "%s taken",
+              invalid[i]);
+    }
+
+    // the label is read within len only
+    struct timespec ts = {0};
+    CHECK(tai_parse("@400000000000000a00000000", TAI_HEX_LEN - 1, &ts) == -1,
+          "short len taken");
+}
+
+int
+main(void)
+{
+    test_between();
+    test_hex8();
+    test_parse();
+    return test_failed > 0;
+}
@@ -0,0 +1,29 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#ifndef SVC_TEST_H
+#define SVC_TEST_H
+
+#include <stdio.h>
+
+/**
+ * Checks failed so far, a test exits with 1 when there's any.
+ */
+static int test_failed;
+
+/**
+ * Report cond when it doesn't hold, with the printf arguments telling the
+ * case it was checked on, and go on with the next checks.
+ */
+#define CHECK(cond, ...)                                                      \
+    do {                                                                      \
+        if (!(cond)) {                                                        \
+            fprintf(stderr, "%s:%d: %s failed: ", __FILE__, __LINE__, #cond); \
+            fprintf(stderr, __VA_ARGS__);                                     \
+            fputc('\n', stderr);                                              \
+            ++test_failed;                                                    \
+        }                                                                     \
+    } while (0)
+
+#endif
@@ -0,0 +1,383 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#include "top.h"
+#include "err.h"
+#include "monitor.h"
+#include "proc.h"
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TOP_INTERVAL_MS 1000
+
+// the header and its underline
+#define HEADER_ROWS 2
+
+static volatile sig_atomic_t stopped;
+static volatile sig_atomic_t resized;
+
+static void
+on_signal(int sig)
+{
+    if (sig == SIGWINCH) {
+        resized = 1;
+    } else {
+        stopped = 1;
+    }
+}
+
+typedef struct {
+    svc const *s;
+    proc_usage usage;
+
+    /**
+     * Percent of a CPU used during the last interval.
+     */
+    double cpu;
+} top_row;
+
+typedef struct {
+    monitor m;
+    proc_table procs;
+    top_sort sort;
+
+    /**
+     * Per service of m.list: the root of its tree, its usage, and the pid and
+     * ticks of the previous sample, a pid of -1 when there's none.
+     */
+    pid_t *pids;
+    proc_usage *usage;
+    pid_t *prev_pids;
+    unsigned long long *prev_ticks;
+    size_t cap;
+
+    top_row *rows;
+    size_t rows_len;
+    struct timespec last;
+} top;
+
+static size_t
+term_rows(void)
+{
+    struct winsize ws = {0};
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == -1 || ws.ws_row == 0) {
+        return SIZE_MAX;
+    }
+
+    return ws.ws_row;
+}
+
+/**
+ * Make room for n services, the previous samples of the new ones are unknown.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+reserve(top *t, size_t n)
+{
+    if (n <= t->cap) {
+        return 0;
+    }
+
+    pid_t *pids               = realloc(t->pids, sizeof(*pids) * n);
+    proc_usage *usage         = realloc(t->usage, sizeof(*usage) * n);
+    pid_t *prev_pids          = realloc(t->prev_pids, sizeof(*prev_pids) * n);
+    unsigned long long *ticks = realloc(t->prev_ticks, sizeof(*ticks) * n);
+    top_row *rows             = realloc(t->rows, sizeof(*rows) * n);
+
+    // whatever was moved must be kept for free
+    t->pids       = pids != NULL ? pids : t->pids;
+    t->usage      = usage != NULL ? usage : t->usage;
+    t->prev_pids  = prev_pids != NULL ? prev_pids : t->prev_pids;
+    t->prev_ticks = ticks != NULL ? ticks : t->prev_ticks;
+    t->rows       = rows != NULL ? rows : t->rows;
+    if (pids == NULL || usage == NULL || prev_pids == NULL || ticks == NULL ||
+        rows == NULL) {
+        set_last_error("realloc failed: %s", strerror(errno));
+        return -1;
+    }
+
+    for (size_t i = t->cap; i < n; ++i) {
+        t->prev_pids[i] = -1;
+    }
+    t->cap = n;
+    return 0;
+}
+
+/**
+ * Forget the previous samples, the services moved in m.list.
+ */
+static void
+forget(top *t)
+{
+    for (size_t i = 0; i < t->cap; ++i) {
+        t->prev_pids[i] = -1;
+    }
+}
+
+static int
+cmp_rows(void const *x, void const *y, void *ctx)
+{
+    top_row const *a = x;
+    top_row const *b = y;
+    top_sort sort    = *(top_sort *)ctx;
+
+    int r = 0;
+    if (sort == TOP_SORT_CPU) {
+        r = (a->cpu < b->cpu) - (a->cpu > b->cpu);
+    }
+    if (r == 0) {
+        r = (a->usage.rss < b->usage.rss) - (a->usage.rss > b->usage.rss);
+    }
+
+    return r != 0 ? r : strcmp(a->s->name, b->s->name);
+}
+
+/**
+ * Sample the process trees of the services and compute the rows from the CPU
+ * time they used since the previous sample.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+sample(top *t)
+{
+    size_t n = arr_len(t->m.list);
+    if (reserve(t, n) == -1) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        svc const *s = t->m.list[i];
+        t->pids[i]   = s->status != SVC_STOPPED ? s->pid : 0;
+    }
+
+    struct timespec now = {0};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (proc_sample(&t->procs, t->pids, n, t->usage) == -1) {
+        return -1;
+    }
+
+    double elapsed = (now.tv_sec - t->last.tv_sec) +
+                     (now.tv_nsec - t->last.tv_nsec) / 1e9;
+    double tick    = 1.0 / sysconf(_SC_CLK_TCK);
+    t->last        = now;
+
+    for (size_t i = 0; i < n; ++i) {
+        top_row *r = &t->rows[i];
+        *r         = (top_row){.s = t->m.list[i], .usage = t->usage[i]};
+
+        // a restarted service is a new tree, its CPU time starts over
+        unsigned long long ticks = t->usage[i].ticks;
+        if (t->prev_pids[i] == t->pids[i] && ticks > t->prev_ticks[i] &&
+            elapsed > 0) {
+            r->cpu = (ticks - t->prev_ticks[i]) * tick / elapsed * 100;
+        }
+        t->prev_pids[i]  = t->pids[i];
+        t->prev_ticks[i] = ticks;
+    }
+    t->rows_len = n;
+
+    qsort_r(t->rows, n, sizeof(*t->rows), cmp_rows, &t->sort);
+    return 0;
+}
+
+/**
+ * Format bytes into buf with a binary unit, e.g. 12.5M.
+ */
+static void
+fmt_bytes(char *buf, size_t len, unsigned long long bytes)
+{
+    static char const units[] = "KMGTP";
+
+    double v = bytes / 1024.0;
+    int u    = 0;
+    for (; v >= 1024 && units[u + 1] != '\0'; ++u) {
+        v /= 1024;
+    }
+
+    snprintf(buf, len, "%.1f%c", v, units[u]);
+}
+
+/**
+ * Print the rows, only the first ones fitting in the terminal when tty is 1.
+ */
+static void
+draw(top const *t, int tty)
+{
+    int width = 4;
+    for (size_t i = 0; i < t->rows_len; ++i) {
+        int l = strlen(t->rows[i].s->name);
+        width = l > width ? l : width;
+    }
+
+    size_t rows = tty ? term_rows() : SIZE_MAX;
+    size_t n    = rows > HEADER_ROWS ? rows - HEADER_ROWS : 0;
+    if (n > t->rows_len) {
+        n = t->rows_len;
+    }
+
+    if (tty) {
+        fputs("\033[H\033[2J", stdout);
+    }
+
+    printf("%-*s  %7s  %5s  %7s  %6s  %8s\n",
+           width,
+           "NAME",
+           "PID",
+           "PROCS",
+           "THREADS",
+           "CPU%",
+           "RSS");
+    for (int i = 0; i < width; ++i) {
+        putchar('-');
+    }
+    puts("  -------  -----  -------  ------  --------");
+
+    for (size_t i = 0; i < n; ++i) {
+        top_row const *r = &t->rows[i];
+        char rss[16]     = {0};
+        fmt_bytes(rss, sizeof(rss), r->usage.rss);
+
+        printf("%-*s  %7d  %5ld  %7ld  %6.1f  %8s",
+               width,
+               r->s->name,
+               r->usage.procs > 0 ? (int)r->s->pid : 0,
+               r->usage.procs,
+               r->usage.threads,
+               r->cpu,
+               rss);
+        // the last row of a terminal can't end with a newline
+        if (!tty || i + 1 < n) {
+            putchar('\n');
+        }
+    }
+    fflush(stdout);
+}
+
+static int
+loop(top *t)
+{
+    if (sample(t) == -1) {
+        return -1;
+    }
+    draw(t, 1);
+
+    while (!stopped) {
+        struct timespec next = t->last;
+        next.tv_sec += TOP_INTERVAL_MS / 1000;
+
+        // the services changing status are followed until the next sample,
+        // which is taken right away when the list itself changed
+        int r = 0;
+        while (!stopped && !resized && r != 1) {
+            struct timespec now = {0};
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            long timeout = (next.tv_sec - now.tv_sec) * 1000 +
+                           (next.tv_nsec - now.tv_nsec) / 1000000;
+            if (timeout <= 0) {
+                break;
+            }
+
+            struct pollfd pfd = {.fd = t->m.inotify_fd, .events = POLLIN};
+            r                 = poll(&pfd, 1, timeout);
+            if (r == -1 && errno != EINTR) {
+                set_last_error("poll failed: %s", strerror(errno));
+                return -1;
+            } else if (r > 0 && (r = monitor_read(&t->m)) == -1) {
+                return -1;
+            } else if (r == 1) {
+                forget(t);
+            }
+        }
+
+        if (stopped) {
+            break;
+        } else if (resized && r != 1) {
+            resized = 0;
+            draw(t, 1);
+            continue;
+        }
+
+        resized = 0;
+        if (sample(t) == -1) {
+            return -1;
+        }
+        draw(t, 1);
+    }
+
+    return 0;
+}
+
+/**
+ * Print a single sample taken over an interval.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+once(top *t)
+{
+    if (sample(t) == -1) {
+        return -1;
+    }
+
+    struct timespec ts = {
+        .tv_sec  = TOP_INTERVAL_MS / 1000,
+        .tv_nsec = TOP_INTERVAL_MS % 1000 * 1000000L,
+    };
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR && !stopped) {
+    }
+
+    if (sample(t) == -1) {
+        return -1;
+    }
+    draw(t, 0);
+    return 0;
+}
+
+int
+top_run(cfg *config, top_sort sort)
+{
+    struct sigaction sa = {.sa_handler = on_signal};
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGWINCH, &sa, NULL);
+
+    top t = {.sort = sort};
+    if (proc_table_init(&t.procs) == -1) {
+        return -1;
+    } else if (monitor_init(&t.m, config) == -1) {
+        proc_table_free(&t.procs);
+        return -1;
+    }
+
+    int r = 0;
+    if (!isatty(STDOUT_FILENO)) {
+        r = once(&t);
+    } else {
+        // alternate screen and hidden cursor, both restored on exit
+        fputs("\033[?1049h\033[?25l", stdout);
+        r = loop(&t);
+        fputs("\033[?25h\033[?1049l", stdout);
+        fflush(stdout);
+    }
+
+    monitor_free(&t.m);
+    proc_table_free(&t.procs);
+    free(t.pids);
+    free(t.usage);
+    free(t.prev_pids);
+    free(t.prev_ticks);
+    free(t.rows);
+    return r;
+}
@@ -0,0 +1,27 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#ifndef SVC_TOP_H
+#define SVC_TOP_H
+
+#include "config.h"
+
+/**
+ * What top sorts the services by, the most consuming first.
+ */
+typedef enum {
+    TOP_SORT_CPU,
+    TOP_SORT_MEM,
+} top_sort;
+
+/**
+ * Show the CPU, memory and threads used by the process tree of every service,
+ * sampled every second until interrupted. When stdout isn't a terminal a
+ * single sample taken over a second is printed.
+ *
+ * Returns -1 on error and set last_error.
+ */
+int top_run(cfg *config, top_sort sort);
+
+#endif
@@ -0,0 +1,352 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#include "uring.h"
+#include "err.h"
+#include "stats.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define URING_ENTRIES 1024
+
+// the kind of operation is stored in the low bits of user_data
+#define OP_OPEN  0
+#define OP_READ  1
+#define OP_CLOSE 2
+#define OP_BITS  2
+#define OP_MASK  ((1 << OP_BITS) - 1)
+
+struct uring {
+    int fd;
+
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned sq_entries;
+    struct io_uring_sqe *sqes;
+
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq;
+    size_t sq_len;
+    void *cq;
+    size_t cq_len;
+    size_t sqes_len;
+
+    /**
+     * Number of sqes prepared since the last flush.
+     */
+    unsigned queued;
+};
+
+uring *
+uring_open(void)
+{
+    uring *u = calloc(1, sizeof(*u));
+    if (u == NULL) {
+        return NULL;
+    }
+
+    struct io_uring_params p = {0};
+    if ((u->fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &p)) == -1) {
+        // ENOSYS, EPERM (seccomp, io_uring_disabled) and friends, the caller
+        // falls back to synchronous I/O
+        free(u);
+        return NULL;
+    }
+
+    u->sq_len   = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    u->cq_len   = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    u->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    int single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single && u->cq_len > u->sq_len) {
+        u->sq_len = u->cq_len;
+    }
+
+    u->sq = mmap(NULL,
+                 u->sq_len,
+                 PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE,
+                 u->fd,
+                 IORING_OFF_SQ_RING);
+    if (u->sq == MAP_FAILED) {
+        goto err_sq;
+    }
+
+    if (single) {
+        u->cq = u->sq;
+    } else {
+        u->cq = mmap(NULL,
+                     u->cq_len,
+                     PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE,
+                     u->fd,
+                     IORING_OFF_CQ_RING);
+        if (u->cq == MAP_FAILED) {
+            goto err_cq;
+        }
+    }
+
+    u->sqes = mmap(NULL,
+                   u->sqes_len,
+                   PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE,
+                   u->fd,
+                   IORING_OFF_SQES);
+    if (u->sqes == MAP_FAILED) {
+        goto err_sqes;
+    }
+
+    char *sq      = u->sq;
+    u->sq_head    = (unsigned *)(sq + p.sq_off.head);
+    u->sq_tail    = (unsigned *)(sq + p.sq_off.tail);
+    u->sq_mask    = (unsigned *)(sq + p.sq_off.ring_mask);
+    u->sq_array   = (unsigned *)(sq + p.sq_off.array);
+    u->sq_entries = p.sq_entries;
+
+    char *cq   = u->cq;
+    u->cq_head = (unsigned *)(cq + p.cq_off.head);
+    u->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    u->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    u->cqes    = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    // the setup and the mmaps
+    stats_io(single ? 3 : 4, 0, 0);
+    return u;
+
+err_sqes:
+    if (!single) {
+        munmap(u->cq, u->cq_len);
+    }
+err_cq:
+    munmap(u->sq, u->sq_len);
+err_sq:
+    close(u->fd);
+    free(u);
+    return NULL;
+}
+
+void
+uring_close(uring *u)
+{
+    if (u == NULL) {
+        return;
+    }
+
+    munmap(u->sqes, u->sqes_len);
+    if (u->cq != u->sq) {
+        munmap(u->cq, u->cq_len);
+    }
+    munmap(u->sq, u->sq_len);
+    close(u->fd);
+    stats_io(u->cq != u->sq ? 4 : 3, 0, 0);
+    free(u);
+}
+
+/**
+ * Apply cqe to its request, returns the amount of data it read.
+ */
+static size_t
+complete(uring_req *reqs, struct io_uring_cqe const *cqe)
+{
+    uring_req *r = &reqs[cqe->user_data >> OP_BITS];
+    r->done      = stats_clock();
+
+    switch (cqe->user_data & OP_MASK) {
+    case OP_OPEN:
+        if (cqe->res >= 0) {
+            r->fd  = cqe->res;
+            r->res = r->buf == NULL ? 1 : 0;
+        } else if (r->buf == NULL && cqe->res == -ENOENT) {
+            r->res = 0;
+        } else {
+            r->res = cqe->res;
+        }
+        break;
+    case OP_READ:
+        r->res = cqe->res;
+        return cqe->res > 0 ? cqe->res : 0;
+    case OP_CLOSE:
+        // the close is cancelled when the read it is linked to failed, on
+        // kernels without hard links
+        if (cqe->res == -ECANCELED) {
+            close(r->fd);
+        }
+        r->fd = -1;
+        break;
+    }
+
+    return 0;
+}
+
+/**
+ * Submit every queued sqe and reap all of their completions.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+flush(uring *u, uring_req *reqs)
+{
+    unsigned left   = u->queued;
+    unsigned submit = u->queued;
+
+    __atomic_store_n(u->sq_tail, *u->sq_tail, __ATOMIC_RELEASE);
+    u->queued = 0;
+
+    while (left > 0) {
+        int r = syscall(__NR_io_uring_enter,
+                        u->fd,
+                        submit,
+                        left,
+                        IORING_ENTER_GETEVENTS,
+                        NULL,
+                        0);
+        if (r == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            set_last_error("io_uring_enter failed: %s", strerror(errno));
+            return -1;
+        }
+        submit -= (unsigned)r < submit ? (unsigned)r : submit;
+
+        size_t nread  = 0;
+        unsigned ops  = left;
+        unsigned head = *u->cq_head;
+        unsigned tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head, --left) {
+            nread += complete(reqs, &u->cqes[head & *u->cq_mask]);
+        }
+        __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+        stats_io(1, nread, ops - left);
+    }
+
+    return 0;
+}
+
+/**
+ * Returns a zeroed sqe, flushing the ring first when fewer than n sqes are
+ * left so linked sqes always land in the same submission.
+ *
+ * Returns NULL on error and set last_error.
+ */
+static struct io_uring_sqe *
+sqe_get(uring *u, uring_req *reqs, unsigned n)
+{
+    if (u->queued + n > u->sq_entries && flush(u, reqs) == -1) {
+        return NULL;
+    }
+
+    unsigned tail = *u->sq_tail;
+    unsigned i    = tail & *u->sq_mask;
+
+    struct io_uring_sqe *sqe = &u->sqes[i];
+    memset(sqe, 0, sizeof(*sqe));
+
+    u->sq_array[i] = i;
+    *u->sq_tail    = tail + 1;
+    ++u->queued;
+    return sqe;
+}
+
+static int
+batch(uring *u, int dirfd, uring_req *reqs, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        reqs[i].fd = -1;
+        if (reqs[i].path != NULL) {
+            reqs[i].res = 0;
+        }
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        uring_req *r = &reqs[i];
+        if (r->path == NULL) {
+            continue;
+        }
+
+        struct io_uring_sqe *sqe = sqe_get(u, reqs, 1);
+        if (sqe == NULL) {
+            return -1;
+        }
+
+        // existence checks are O_PATH opens rather than statx, statx is
+        // always punted to an io-wq worker while a cached lookup completes
+        // inline
+        sqe->opcode     = IORING_OP_OPENAT;
+        sqe->fd         = dirfd;
+        sqe->addr       = (unsigned long)r->path;
+        sqe->open_flags = (r->buf != NULL ? O_RDONLY : O_PATH) | O_CLOEXEC;
+        sqe->user_data  = i << OP_BITS | OP_OPEN;
+    }
+
+    if (flush(u, reqs) == -1) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        uring_req *r = &reqs[i];
+        if (r->fd == -1) {
+            continue;
+        }
+
+        struct io_uring_sqe *sqe = sqe_get(u, reqs, 2);
+        if (sqe == NULL) {
+            return -1;
+        }
+
+        if (r->buf == NULL) {
+            sqe->opcode    = IORING_OP_CLOSE;
+            sqe->fd        = r->fd;
+            sqe->user_data = i << OP_BITS | OP_CLOSE;
+            continue;
+        }
+
+        sqe->opcode    = IORING_OP_READ;
+        sqe->fd        = r->fd;
+        sqe->addr      = (unsigned long)r->buf;
+        sqe->len       = r->len;
+        // a hard link: a short read, the usual case for text files, would
+        // otherwise cancel the close
+        sqe->flags     = IOSQE_IO_HARDLINK;
+        sqe->user_data = i << OP_BITS | OP_READ;
+
+        // can't fail, sqe_get made room for both
+        sqe            = sqe_get(u, reqs, 1);
+        sqe->opcode    = IORING_OP_CLOSE;
+        sqe->fd        = r->fd;
+        sqe->user_data = i << OP_BITS | OP_CLOSE;
+    }
+
+    return flush(u, reqs);
+}
+
+int
+uring_batch(uring *u, int dirfd, uring_req *reqs, size_t n)
+{
+    if (batch(u, dirfd, reqs, n) == 0) {
+        return 0;
+    }
+
+    // the ring is in an unknown state, don't leak what was opened
+    for (size_t i = 0; i < n; ++i) {
+        if (reqs[i].fd != -1) {
+            close(reqs[i].fd);
+            reqs[i].fd = -1;
+        }
+    }
+
+    return -1;
+}
@@ -0,0 +1,71 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#ifndef SVC_URING_H
+#define SVC_URING_H
+
+#include <stddef.h>
+
+/**
+ * An io_uring instance, opaque.
+ */
+typedef struct uring uring;
+
+/**
+ * A request of a batch, either reads the head of a file or only checks that a
+ * path exists.
+ */
+typedef struct {
+    /**
+     * Path relative to the dir fd of the batch, NULL to skip the request and
+     * leave its res as is.
+     */
+    char const *path;
+
+    /**
+     * Where to read the head of the file, NULL to check existence only.
+     */
+    char *buf;
+    size_t len;
+
+    /**
+     * Set by the batch: the amount of data read, 1 or 0 for existence, or a
+     * negative errno.
+     */
+    int res;
+
+    /**
+     * Internal, the file opened for reading.
+     */
+    int fd;
+
+    /**
+     * Set by the batch with --stats: when the last operation of the request
+     * completed, see stats_clock().
+     */
+    double done;
+} uring_req;
+
+/**
+ * Setup an io_uring instance.
+ *
+ * Returns NULL if io_uring is not available, the caller is expected to fall
+ * back to synchronous I/O.
+ */
+uring *uring_open(void);
+
+/**
+ * Run the given requests in a few large batches: every open is submitted at
+ * once, then every read linked to its close.
+ *
+ * Returns -1 on error and set last_error.
+ */
+int uring_batch(uring *u, int dirfd, uring_req *reqs, size_t n);
+
+/**
+ * Release the given io_uring instance.
+ */
+void uring_close(uring *u);
+
+#endif
@@ -0,0 +1,387 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#include "view.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static char const *cols[VIEW_COLS] = {
+    "PID",
+    "NAME",
+    "STATUS",
+    "DOWN",
+    "TIME",
+    "ROOT",
+    "RESTARTS",
+};
+
+#define FLAPPING " flapping"
+
+static int
+nofdigits(int n)
+{
+    int r = 1;
+
+    if (n >= 10000) {
+        r += 4;
+        n /= 10000;
+    }
+
+    if (n >= 100) {
+        r += 2;
+        n /= 100;
+    }
+
+    if (n >= 10) {
+        ++r;
+    }
+
+    return r;
+}
+
+void
+view_layout_init(view_layout *l)
+{
+    *l = (view_layout){
+        .widths = {3, 4, 6, 4, 4, 4, 8},
+        .order  = {CFG_COL_PID,
+                   CFG_COL_NAME,
+                   CFG_COL_STATUS,
+                   CFG_COL_DOWN,
+                   CFG_COL_TIME},
+        .len    = CFG_COL_ROOT,
+    };
+}
+
+void
+view_layout_columns(view_layout *l, cfg_col const *order, int n)
+{
+    memcpy(l->order, order, sizeof(*order) * n);
+    l->len = n;
+}
+
+int
+view_column(char const *name)
+{
+    for (int i = 0; i < VIEW_COLS; ++i) {
+        if (strcasecmp(name, cols[i]) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Returns the svc_field mask the column c needs.
+ */
+static unsigned
+col_fields(cfg_col c)
+{
+    switch (c) {
+    case CFG_COL_NAME: return 0;
+    case CFG_COL_ROOT: return 0;
+    case CFG_COL_DOWN: return SVC_FIELD_DOWN;
+    default:           return SVC_FIELD_STATUS;
+    }
+}
+
+unsigned
+view_fields(cfg const *config)
+{
+    if (config->format != CFG_FORMAT_TABLE) {
+        return SVC_FIELDS_ALL;
+    }
+
+    unsigned fields = 0;
+    for (int i = 0; i < config->columns_len; ++i) {
+        fields |= col_fields(config->columns[i]);
+    }
+    if (config->sort != -1) {
+        fields |= col_fields(config->sort);
+    }
+
+    return fields;
+}
+
+typedef struct {
+    cfg_col col;
+    int desc;
+} sort_by;
+
+static int
+cmp_svc(void const *x, void const *y, void *ctx)
+{
+    sort_by const *by = ctx;
+    svc const *a      = *(svc *const *)x;
+    svc const *b      = *(svc *const *)y;
+
+    int r = 0;
+    switch (by->col) {
+    case CFG_COL_PID:
+        r = (a->pid > b->pid) - (a->pid < b->pid);
+        break;
+    case CFG_COL_NAME:
+        r = strcmp(a->name, b->name);
+        break;
+    case CFG_COL_STATUS:
+        r = strcmp(svc_status_str(a->status), svc_status_str(b->status));
+        break;
+    case CFG_COL_DOWN:
+        r = (a->is_down > b->is_down) - (a->is_down < b->is_down);
+        break;
+    case CFG_COL_TIME:
+        // the shortest time is the latest change
+        r = (b->since.tv_sec > a->since.tv_sec) -
+            (b->since.tv_sec < a->since.tv_sec);
+        if (r == 0) {
+            r = (b->since.tv_nsec > a->since.tv_nsec) -
+                (b->since.tv_nsec < a->since.tv_nsec);
+        }
+        break;
+    case CFG_COL_ROOT:
+        r = strcmp(a->root != NULL ? a->root : "",
+                   b->root != NULL ? b->root : "");
+        break;
+    case CFG_COL_RESTARTS:
+        r = (a->restarts > b->restarts) - (a->restarts < b->restarts);
+        break;
+    default:
+        break;
+    }
+
+    if (by->desc) {
+        r = -r;
+    }
+
+    return r != 0 ? r : strcmp(a->name, b->name);
+}
+
+void
+view_sort(svc **list, size_t n, cfg_col col, int desc)
+{
+    sort_by by = {.col = col, .desc = desc};
+    qsort_r(list, n, sizeof(*list), cmp_svc, &by);
+}
+
+int
+view_layout_fit(view_layout *l, svc const *s, struct timespec const *now)
+{
+    svc_time time = {0};
+    if (svc_time_fmt(&time, &s->since, now) == -1) {
+        return -1;
+    }
+
+    int n[VIEW_COLS] = {
+        nofdigits(s->pid),
+        strlen(s->name),
+        strlen(svc_status_str(s->status)),
+        0,
+        strlen(time),
+        s->root != NULL ? strlen(s->root) : 0,
+        s->restarts != -1 ? nofdigits(s->restarts) : 1,
+    };
+    if (s->flapping) {
+        n[CFG_COL_RESTARTS] += strlen(FLAPPING);
+    }
+
+    int grew = 0;
+    for (int i = 0; i < VIEW_COLS; ++i) {
+        if (n[i] > l->widths[i]) {
+            l->widths[i] = n[i];
+            grew         = 1;
+        }
+    }
+
+    return grew;
+}
+
+void
+view_print_header(FILE *f, view_layout const *l)
+{
+    for (int i = 0; i < l->len; ++i) {
+        cfg_col c = l->order[i];
+        fprintf(f, "%s%-*s", i > 0 ? "  " : "", l->widths[c], cols[c]);
+    }
+    fputc('\n', f);
+
+    for (int i = 0; i < l->len; ++i) {
+        if (i > 0) {
+            fputs("  ", f);
+        }
+        for (int j = 0; j < l->widths[l->order[i]]; ++j) {
+            putc('-', f);
+        }
+    }
+    fputc('\n', f);
+}
+
+void
+view_print_row(FILE *f,
+               view_layout const *l,
+               svc const *s,
+               struct timespec const *now)
+{
+    for (int i = 0; i < l->len; ++i) {
+        cfg_col c = l->order[i];
+        int w     = l->widths[c];
+        if (i > 0) {
+            fputs("  ", f);
+        }
+
+        switch (c) {
+        case CFG_COL_PID:
+            fprintf(f, "%-*d", w, s->pid);
+            break;
+        case CFG_COL_NAME:
+            fprintf(f, "%-*s", w, s->name);
+            break;
+        case CFG_COL_STATUS:
+            fprintf(f, "%-*s", w, svc_status_str(s->status));
+            break;
+        case CFG_COL_DOWN:
+            fprintf(f, "%-*s", w, s->is_down == 1 ? "yes" : "no");
+            break;
+        case CFG_COL_ROOT:
+            fprintf(f, "%-*s", w, s->root != NULL ? s->root : "");
+            break;
+        case CFG_COL_RESTARTS:
+            if (s->restarts == -1) {
+                fprintf(f, "%-*s", w, "-");
+            } else {
+                w -= fprintf(f, "%d", s->restarts);
+                fprintf(f, "%-*s", w, s->flapping ? FLAPPING : "");
+            }
+            break;
+        default:
+            view_print_time(f, l, s, now);
+            break;
+        }
+    }
+}
+
+int
+view_time_offset(view_layout const *l)
+{
+    int off = 0;
+    for (int i = 0; i < l->len && l->order[i] != CFG_COL_TIME; ++i) {
+        off += l->widths[l->order[i]] + 2;
+    }
+
+    return off;
+}
+
+void
+view_print_time(FILE *f,
+                view_layout const *l,
+                svc const *s,
+                struct timespec const *now)
+{
+    // can't fail for a time that view_layout_fit already accepted
+    svc_time time = {0};
+    svc_time_fmt(&time, &s->since, now);
+
+    fprintf(f, "%-*s", l->widths[CFG_COL_TIME], time);
+}
+
+void
+view_print_records_header(FILE *f, cfg_format format)
+{
+    if (format == CFG_FORMAT_TSV) {
+        fputs("status\twant\tdown\tpaused\tpid\tsince\tseconds\tname\n", f);
+    }
+}
+
+/**
+ * Print name as a JSON string.
+ */
+static void
+print_json_string(FILE *f, char const *name)
+{
+    fputc('"', f);
+    for (unsigned char const *c = (unsigned char const *)name; *c != '\0';
+         ++c) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', f);
+            fputc(*c, f);
+        } else if (*c < 0x20) {
+            fprintf(f, "\\u%04x", *c);
+        } else {
+            fputc(*c, f);
+        }
+    }
+    fputc('"', f);
+}
+
+/**
+ * Print name as a TSV field, tabs, newlines and backslashes are escaped.
+ */
+static void
+print_tsv_field(FILE *f, char const *name)
+{
+    for (char const *c = name; *c != '\0'; ++c) {
+        switch (*c) {
+        case '\t': fputs("\\t", f); break;
+        case '\n': fputs("\\n", f); break;
+        case '\r': fputs("\\r", f); break;
+        case '\\': fputs("\\\\", f); break;
+        default:   fputc(*c, f); break;
+        }
+    }
+}
+
+void
+view_print_record(FILE *f,
+                  cfg_format format,
+                  svc const *s,
+                  struct timespec const *now)
+{
+    long long seconds = 0;
+    if (now->tv_sec > s->since.tv_sec) {
+        seconds = now->tv_sec - s->since.tv_sec;
+    }
+
+    if (format == CFG_FORMAT_JSON) {
+        fputs("{\"name\":", f);
+        print_json_string(f, s->name);
+        if (s->root != NULL) {
+            fputs(",\"root\":", f);
+            print_json_string(f, s->root);
+        }
+        fprintf(f,
+                ",\"status\":\"%s\",\"want\":\"%s\",\"down\":%s,"
+                "\"paused\":%s,\"pid\":%d,\"since\":%lld.%09ld,"
+                "\"seconds\":%lld}\n",
+                svc_status_str(s->status),
+                svc_want_str(s->want),
+                s->is_down == 1 ? "true" : "false",
+                s->is_paused ? "true" : "false",
+                (int)s->pid,
+                (long long)s->since.tv_sec,
+                s->since.tv_nsec,
+                seconds);
+        return;
+    }
+
+    // the name goes last, NUL separated records can hold any name
+    fprintf(f,
+            "%s\t%s\t%d\t%d\t%d\t%lld.%09ld\t%lld\t",
+            svc_status_str(s->status),
+            svc_want_str(s->want),
+            s->is_down == 1,
+            s->is_paused != 0,
+            (int)s->pid,
+            (long long)s->since.tv_sec,
+            s->since.tv_nsec,
+            seconds);
+
+    if (format == CFG_FORMAT_NUL) {
+        fputs(s->name, f);
+        fputc('\0', f);
+    } else {
+        print_tsv_field(f, s->name);
+        fputc('\n', f);
+    }
+}
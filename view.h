@@ -0,0 +1,101 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#ifndef SVC_VIEW_H
+#define SVC_VIEW_H
+
+#include "config.h"
+#include "service.h"
+#include <stdio.h>
+#include <time.h>
+
+#define VIEW_COLS CFG_COLS_LEN
+
+/**
+ * Column widths of the services table, indexed by cfg_col, and the columns
+ * shown in order.
+ */
+typedef struct {
+    int widths[VIEW_COLS];
+    cfg_col order[VIEW_COLS];
+    int len;
+} view_layout;
+
+/**
+ * Reset the given layout to its minimal widths and the columns before ROOT.
+ */
+void view_layout_init(view_layout *l);
+
+/**
+ * Show only the n columns of order in l, in that order.
+ */
+void view_layout_columns(view_layout *l, cfg_col const *order, int n);
+
+/**
+ * Returns the column named name, case insensitive, or -1 if there's none.
+ */
+int view_column(char const *name);
+
+/**
+ * Returns the svc_field mask view needs to read for config, its columns and
+ * sort in a table, every field for records.
+ */
+unsigned view_fields(cfg const *config);
+
+/**
+ * Sort the n services of list by the column col, descending when desc is 1,
+ * ties are sorted by name.
+ */
+void view_sort(svc **list, size_t n, cfg_col col, int desc);
+
+/**
+ * Grow the given layout so that s fits in it at now.
+ *
+ * Returns 1 if a column grew, otherwise 0, returns -1 on error and set
+ * last_error.
+ */
+int view_layout_fit(view_layout *l, svc const *s, struct timespec const *now);
+
+/**
+ * Print the header and its underline, that's two lines.
+ */
+void view_print_header(FILE *f, view_layout const *l);
+
+/**
+ * Print the row of s, without a trailing newline.
+ */
+void view_print_row(FILE *f,
+                    view_layout const *l,
+                    svc const *s,
+                    struct timespec const *now);
+
+/**
+ * Returns the offset of the TIME column in a row, which must be shown.
+ */
+int view_time_offset(view_layout const *l);
+
+/**
+ * Print the TIME cell of s, without a trailing newline.
+ */
+void view_print_time(FILE *f,
+                     view_layout const *l,
+                     svc const *s,
+                     struct timespec const *now);
+
+/**
+ * Print what precedes the records of format, the column names of TSV.
+ */
+void view_print_records_header(FILE *f, cfg_format format);
+
+/**
+ * Print the record of s in format, which isn't CFG_FORMAT_TABLE. Records are
+ * self-contained, no width is computed. JSON records have a root when s has
+ * one.
+ */
+void view_print_record(FILE *f,
+                       cfg_format format,
+                       svc const *s,
+                       struct timespec const *now);
+
+#endif
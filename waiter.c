@@ -0,0 +1,188 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#include "waiter.h"
+#include "err.h"
+#include "io.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+static double
+diff(struct timespec const *a, struct timespec const *b)
+{
+    return (double)(a->tv_sec - b->tv_sec) +
+           (double)(a->tv_nsec - b->tv_nsec) / 1e9;
+}
+
+int
+waiter_init(void)
+{
+    int ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (ifd == -1) {
+        set_last_error("inotify_init1 failed: %s", strerror(errno));
+    }
+
+    return ifd;
+}
+
+int
+waiter_prepare(cfg *config, int ifd, waiter *w)
+{
+    int fd = cfg_svdir_fd(config);
+    if (fd == -1) {
+        return -1;
+    }
+
+    // armed before the status is read, a change right after is then queued
+    w->wd = -1;
+    if (ifd != -1) {
+        char path[512] = {0};
+        if (io_snprintf(
+                path, 512, "%s/%s/supervise", config->svdir, w->name) == -1) {
+            wrap_last_error("io_snprintf failed");
+            return -1;
+        }
+
+        if ((w->wd = inotify_add_watch(
+                 ifd, path, IN_MOVED_TO | IN_CLOSE_WRITE)) == -1) {
+            set_last_error("cannot watch %s: %s", path, strerror(errno));
+            return -1;
+        }
+    }
+
+    svc *s = svc_read(fd, w->name);
+    if (s == NULL) {
+        return -1;
+    }
+
+    w->was     = s->status;
+    w->before  = s->since;
+    w->reached = 0;
+    free(s);
+    return 0;
+}
+
+/**
+ * Read the service of w again and check whether it reached its status.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+check(int fd, waiter *w)
+{
+    svc *s = svc_read(fd, w->name);
+    if (s == NULL) {
+        return -1;
+    }
+
+    if (s->status == w->status && (s->since.tv_sec != w->before.tv_sec ||
+                                   s->since.tv_nsec != w->before.tv_nsec)) {
+        w->reached = 1;
+        w->latency = diff(&s->since, &w->written);
+
+        // the text fallback only has the coarse mtime of supervise/stat,
+        // which can predate the write by a tick
+        if (w->latency < 0) {
+            struct timespec now = {0};
+            clock_gettime(CLOCK_REALTIME, &now);
+            w->latency = diff(&now, &w->written);
+        }
+    }
+
+    free(s);
+    return 0;
+}
+
+static int
+run(cfg *config, int ifd, waiter *ws, size_t n, double timeout)
+{
+    int fd = cfg_svdir_fd(config);
+    if (fd == -1) {
+        return -1;
+    }
+
+    // the changes since the watches were armed are queued on ifd, the ones
+    // already there are caught here without waiting for their events
+    size_t pending = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (!ws[i].reached && check(fd, &ws[i]) == -1) {
+            return -1;
+        }
+        pending += !ws[i].reached;
+    }
+
+    struct timespec start = {0};
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while (pending > 0) {
+        struct timespec now = {0};
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        double left = timeout - diff(&now, &start);
+        if (left <= 0) {
+            break;
+        }
+
+        struct pollfd pfd = {.fd = ifd, .events = POLLIN};
+        int r             = poll(&pfd, 1, (int)(left * 1000) + 1);
+        if (r == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            set_last_error("poll failed: %s", strerror(errno));
+            return -1;
+        } else if (r == 0) {
+            continue;
+        }
+
+        ssize_t len = 0;
+        while ((len = read(ifd, buf, sizeof(buf))) > 0) {
+            struct inotify_event const *e = NULL;
+            for (char *p = buf; p < buf + len; p += sizeof(*e) + e->len) {
+                e = (struct inotify_event const *)p;
+                if (e->len == 0 || (strcmp(e->name, "status") != 0 &&
+                                    strcmp(e->name, "stat") != 0)) {
+                    continue;
+                }
+
+                for (size_t i = 0; i < n; ++i) {
+                    if (ws[i].wd != e->wd || ws[i].reached) {
+                        continue;
+                    }
+                    if (check(fd, &ws[i]) == -1) {
+                        return -1;
+                    }
+                    pending -= ws[i].reached;
+                }
+            }
+        }
+
+        if (len == -1 && errno != EAGAIN && errno != EINTR) {
+            set_last_error("failed to read inotify: %s", strerror(errno));
+            return -1;
+        }
+    }
+
+    return pending;
+}
+
+int
+waiter_run(cfg *config, int ifd, waiter *ws, size_t n, double timeout)
+{
+    int r = run(config, ifd, ws, n, timeout);
+
+    for (size_t i = 0; i < n; ++i) {
+        if (ws[i].wd != -1) {
+            inotify_rm_watch(ifd, ws[i].wd);
+            ws[i].wd = -1;
+        }
+    }
+
+    return r;
+}
@@ -0,0 +1,77 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#ifndef SVC_WAITER_H
+#define SVC_WAITER_H
+
+#include "config.h"
+#include "service.h"
+#include <stddef.h>
+#include <time.h>
+
+/**
+ * A service expected to reach a status after a control command.
+ */
+typedef struct {
+    char const *name;
+
+    /**
+     * The status to reach.
+     */
+    svc_status status;
+
+    /**
+     * Status and change time of the service before the control was written,
+     * the status only counts once the change time moved.
+     */
+    svc_status was;
+    struct timespec before;
+
+    /**
+     * When the control was written, taken right before since runsv may act
+     * on it before the write returns.
+     */
+    struct timespec written;
+
+    /**
+     * Set once the status is reached, with the seconds it took since the
+     * control was written.
+     */
+    int reached;
+    double latency;
+
+    /**
+     * Watch of the supervise dir of the service, -1 when not watched.
+     */
+    int wd;
+} waiter;
+
+/**
+ * Returns an inotify instance to watch the services on. Closing it waits for
+ * an RCU grace period, 8 ms and more, so it's closed once the results are
+ * reported.
+ *
+ * Returns -1 on error and set last_error.
+ */
+int waiter_init(void);
+
+/**
+ * Watch the supervise dir of the service on ifd, -1 to not watch it, then
+ * fill w->was and w->before with its current status, to be called right
+ * before writing its control so that no change is missed.
+ *
+ * Returns -1 on error and set last_error.
+ */
+int waiter_prepare(cfg *config, int ifd, waiter *w);
+
+/**
+ * Block on ifd until every waiter, prepared on it, reached its status, or
+ * until timeout seconds elapsed. The watches of ws are then removed.
+ *
+ * Returns the number of waiters that didn't reach their status, returns -1 on
+ * error and set last_error.
+ */
+int waiter_run(cfg *config, int ifd, waiter *ws, size_t n, double timeout);
+
+#endif
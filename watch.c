@@ -0,0 +1,226 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#include "watch.h"
+#include "err.h"
+#include "monitor.h"
+#include "view.h"
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+// the header and its underline
+#define HEADER_ROWS 2
+
+static volatile sig_atomic_t stopped;
+static volatile sig_atomic_t resized;
+
+static void
+on_signal(int sig)
+{
+    if (sig == SIGWINCH) {
+        resized = 1;
+    } else {
+        stopped = 1;
+    }
+}
+
+typedef struct {
+    monitor m;
+    view_layout layout;
+
+    /**
+     * Number of services fitting in the terminal.
+     */
+    size_t visible;
+} watch;
+
+static size_t
+term_rows(void)
+{
+    struct winsize ws = {0};
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == -1 || ws.ws_row == 0) {
+        return SIZE_MAX;
+    }
+
+    return ws.ws_row;
+}
+
+static void
+draw_row(watch *w, size_t i, struct timespec const *now)
+{
+    printf("\033[%zu;1H", i + HEADER_ROWS + 1);
+    view_print_row(stdout, &w->layout, w->m.list[i], now);
+    fputs("\033[K", stdout);
+}
+
+static void
+draw_time(watch *w, size_t i, struct timespec const *now)
+{
+    printf("\033[%zu;%dH",
+           i + HEADER_ROWS + 1,
+           view_time_offset(&w->layout) + 1);
+    view_print_time(stdout, &w->layout, w->m.list[i], now);
+}
+
+/**
+ * Compute the layout again and draw everything.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+draw(watch *w, struct timespec const *now)
+{
+    size_t n = arr_len(w->m.list);
+
+    view_layout_init(&w->layout);
+    for (size_t i = 0; i < n; ++i) {
+        if (view_layout_fit(&w->layout, w->m.list[i], now) == -1) {
+            return -1;
+        }
+    }
+
+    size_t rows = term_rows();
+    w->visible  = rows > HEADER_ROWS ? rows - HEADER_ROWS : 0;
+    if (w->visible > n) {
+        w->visible = n;
+    }
+
+    fputs("\033[H\033[2J", stdout);
+    view_print_header(stdout, &w->layout);
+    for (size_t i = 0; i < w->visible; ++i) {
+        draw_row(w, i, now);
+    }
+
+    return 0;
+}
+
+/**
+ * Draw the rows flagged as dirty by the monitor, everything is drawn again
+ * when one of them doesn't fit the current layout.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+draw_dirty(watch *w, struct timespec const *now)
+{
+    for (size_t i = 0; i < w->visible; ++i) {
+        if (!w->m.dirty[i]) {
+            continue;
+        }
+
+        int r = view_layout_fit(&w->layout, w->m.list[i], now);
+        if (r == -1) {
+            return -1;
+        } else if (r == 1) {
+            return draw(w, now);
+        }
+
+        draw_row(w, i, now);
+    }
+
+    return 0;
+}
+
+/**
+ * Only the TIME column changes by itself, draw its cells.
+ *
+ * Returns -1 on error and set last_error.
+ */
+static int
+draw_times(watch *w, struct timespec const *now)
+{
+    for (size_t i = 0; i < w->visible; ++i) {
+        int r = view_layout_fit(&w->layout, w->m.list[i], now);
+        if (r == -1) {
+            return -1;
+        } else if (r == 1) {
+            return draw(w, now);
+        }
+
+        draw_time(w, i, now);
+    }
+
+    return 0;
+}
+
+static int
+loop(watch *w)
+{
+    struct timespec now = {0};
+    clock_gettime(CLOCK_REALTIME, &now);
+    if (draw(w, &now) == -1) {
+        return -1;
+    }
+
+    while (!stopped) {
+        fflush(stdout);
+
+        // sleep until the next second flips, that's when the TIME cells
+        // change, everything else is driven by inotify
+        clock_gettime(CLOCK_REALTIME, &now);
+        int timeout = 1000 - now.tv_nsec / 1000000;
+
+        struct pollfd pfd = {.fd = w->m.inotify_fd, .events = POLLIN};
+        int r             = poll(&pfd, 1, timeout);
+        if (r == -1) {
+            if (errno != EINTR) {
+                set_last_error("poll failed: %s", strerror(errno));
+                return -1;
+            } else if (!resized) {
+                continue;
+            }
+        }
+
+        clock_gettime(CLOCK_REALTIME, &now);
+
+        if (resized) {
+            resized = 0;
+            r       = draw(w, &now);
+        } else if (r == 0) {
+            r = draw_times(w, &now);
+        } else if (r > 0) {
+            if ((r = monitor_read(&w->m)) == 1) {
+                r = draw(w, &now);
+            } else if (r == 0) {
+                r = draw_dirty(w, &now);
+            }
+        }
+
+        if (r == -1) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int
+watch_run(cfg *config)
+{
+    struct sigaction sa = {.sa_handler = on_signal};
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGWINCH, &sa, NULL);
+
+    watch w = {0};
+    if (monitor_init(&w.m, config) == -1) {
+        return -1;
+    }
+
+    // alternate screen and hidden cursor, both restored on exit
+    fputs("\033[?1049h\033[?25l", stdout);
+    int r = loop(&w);
+    fputs("\033[?25h\033[?1049l", stdout);
+    fflush(stdout);
+
+    monitor_free(&w.m);
+    return r;
+}
@@ -0,0 +1,18 @@
+/**
+ * SPDX-License-Identifier: AGPL-3.0-only
+ * Copyright (C) 2025 Wladimir Bec
+ */
+#ifndef SVC_WATCH_H
+#define SVC_WATCH_H
+
+#include "config.h"
+
+/**
+ * Show the services table and keep it current until interrupted, only the
+ * rows of the services that changed are drawn again.
+ *
+ * Returns -1 on error and set last_error.
+ */
+int watch_run(cfg *config);
+
+#endif